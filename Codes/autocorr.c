@@ -0,0 +1,43 @@
+/*
+ * autocorr.c
+ *
+ * Autocorrelation time estimates (see autocorr.h).
+ */
+
+#include "autocorr.h"
+
+int autocorr_rho(const double *x, int n, int maxlag, double *rho){
+    for(int t=0;t<=maxlag;t++) rho[t] = t == 0 ? 1.0 : 0.0;
+    if(n < 2 || maxlag >= n) return 1;
+    double mean = 0.0;
+    for(int i=0;i<n;i++) mean += x[i];
+    mean /= n;
+    double c0 = 0.0;
+    for(int i=0;i<n;i++) c0 += (x[i] - mean) * (x[i] - mean);
+    if(!(c0 > 0.0)) return 1;
+    for(int t=1;t<=maxlag;t++){
+        double c = 0.0;
+        for(int i=0;i+t<n;i++) c += (x[i] - mean) * (x[i+t] - mean);
+        rho[t] = c / c0;
+    }
+    return 0;
+}
+
+double autocorr_tau_int(const double *rho, int maxlag, int *window){
+    double tau = 0.5;
+    for(int W=1;W<=maxlag;W++){
+        tau += rho[W];
+        if(W >= AUTOCORR_SOKAL_C * tau){
+            if(window) *window = W;
+            return tau;
+        }
+    }
+    if(window) *window = -1;
+    return tau;
+}
+
+double autocorr_tau_strided(const double *rho, int window, int stride){
+    double tau = 0.5;
+    for(int t=stride;t<=window;t+=stride) tau += rho[t];
+    return tau < 0.5 ? 0.5 : tau;
+}
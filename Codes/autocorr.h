@@ -0,0 +1,30 @@
+#ifndef AUTOCORR_H
+#define AUTOCORR_H
+
+/*
+ * autocorr
+ *
+ * Integrated autocorrelation time of a time series, for choosing how many
+ * consecutive snapshots to skip (--subsample=auto). tau_int is
+ * 1/2 + sum_{t=1..W} rho(t), with the window W chosen by Sokal's rule: the
+ * smallest W with W >= AUTOCORR_SOKAL_C * tau_int(W). Uncorrelated samples
+ * have tau_int = 1/2; n samples carry about n / (2 tau_int) independent ones.
+ */
+
+/* Window factor of Sokal's rule */
+#define AUTOCORR_SOKAL_C 5.0
+
+/* Normalized autocorrelation rho[0..maxlag] of x[0..n-1] (rho[0] = 1), with
+   the usual 1/n estimator. Returns 0 on success, 1 if x is constant or
+   maxlag >= n (rho left as for an uncorrelated series). */
+int autocorr_rho(const double *x, int n, int maxlag, double *rho);
+
+/* tau_int from rho[0..maxlag]. *window (may be NULL) gets W, or -1 when the
+   rule was not met within maxlag (the series is too short: the value is then
+   a lower bound). */
+double autocorr_tau_int(const double *rho, int maxlag, int *window);
+
+/* tau_int of every stride-th sample: 1/2 + sum_{j>=1, j*stride<=window} rho(j*stride) */
+double autocorr_tau_strided(const double *rho, int window, int stride);
+
+#endif /* AUTOCORR_H */
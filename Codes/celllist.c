@@ -0,0 +1,170 @@
+/*
+ * celllist.c
+ *
+ * Uniform cell list (CSR layout) for 2D points with optional PBC.
+ * Used by the cell-list neighbor engines (cellnbr.c).
+ */
+
+#include "celllist.h"
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+int celllist_build(CellList *cl, const Vec2Array *pos, double cell_size,
+                   bool use_pbc, double box_x, double box_y)
+{
+    if(!cl || !pos){
+        fprintf(stderr, "celllist_build: invalid arguments\n");
+        return 1;
+    }
+    memset(cl, 0, sizeof(*cl));
+    const int N = (int)pos->n;
+    if(use_pbc && (box_x <= 0.0 || box_y <= 0.0)){
+        fprintf(stderr, "celllist_build: use_pbc true but box_x/box_y not positive\n");
+        return 1;
+    }
+
+    double Lx, Ly;
+    if(use_pbc){
+        cl->x0 = 0.0;
+        cl->y0 = 0.0;
+        Lx = box_x;
+        Ly = box_y;
+    } else {
+        double xmin = 0.0, xmax = 0.0, ymin = 0.0, ymax = 0.0;
+        for(int i=0;i<N;i++){
+            double x = pos->data[i].x, y = pos->data[i].y;
+            if(i == 0 || x < xmin) xmin = x;
+            if(i == 0 || x > xmax) xmax = x;
+            if(i == 0 || y < ymin) ymin = y;
+            if(i == 0 || y > ymax) ymax = y;
+        }
+        cl->x0 = xmin;
+        cl->y0 = ymin;
+        Lx = xmax - xmin;
+        Ly = ymax - ymin;
+    }
+
+    if(cell_size <= 0.0){
+        double area = Lx * Ly;
+        cell_size = (area > 0.0 && N > 0) ? sqrt(2.0 * area / N) : 1.0;
+    }
+
+    long ncx = (Lx > 0.0) ? (long)(Lx / cell_size) : 1;
+    long ncy = (Ly > 0.0) ? (long)(Ly / cell_size) : 1;
+    if(ncx < 1) ncx = 1;
+    if(ncy < 1) ncy = 1;
+    const long max_cells = 4L * N + 16;
+    if(ncx * ncy > max_cells){
+        double f = sqrt((double)(ncx * ncy) / (double)max_cells);
+        ncx = (long)(ncx / f); if(ncx < 1) ncx = 1;
+        ncy = (long)(ncy / f); if(ncy < 1) ncy = 1;
+    }
+    cl->ncx = (int)ncx;
+    cl->ncy = (int)ncy;
+    cl->cw = (Lx > 0.0) ? Lx / ncx : cell_size;
+    cl->ch = (Ly > 0.0) ? Ly / ncy : cell_size;
+    cl->use_pbc = use_pbc;
+    cl->box_x = box_x;
+    cl->box_y = box_y;
+    cl->n = N;
+
+    const int ncell = cl->ncx * cl->ncy;
+    cl->start   = (int*)mem_calloc((size_t)ncell + 1, sizeof(int));
+    cl->items   = (int*)mem_malloc((size_t)(N > 0 ? N : 1) * sizeof(int));
+    cl->cell_of = (int*)mem_malloc((size_t)(N > 0 ? N : 1) * sizeof(int));
+    if(!cl->start || !cl->items || !cl->cell_of){
+        fprintf(stderr, "celllist_build: OOM\n");
+        celllist_free(cl);
+        return 2;
+    }
+
+    /* counting sort by cell */
+    for(int i=0;i<N;i++){
+        int cx, cy;
+        celllist_cell_coords(cl, pos->data[i].x, pos->data[i].y, &cx, &cy);
+        int c = cy * cl->ncx + cx;
+        cl->cell_of[i] = c;
+        cl->start[c + 1]++;
+    }
+    for(int c=0;c<ncell;c++) cl->start[c + 1] += cl->start[c];
+    int *fill = (int*)mem_malloc((size_t)ncell * sizeof(int));
+    if(!fill){
+        fprintf(stderr, "celllist_build: OOM\n");
+        celllist_free(cl);
+        return 2;
+    }
+    memcpy(fill, cl->start, (size_t)ncell * sizeof(int));
+    for(int i=0;i<N;i++) cl->items[fill[cl->cell_of[i]]++] = i;
+    mem_free(fill);
+    return 0;
+}
+
+void celllist_free(CellList *cl){
+    if(!cl) return;
+    mem_free(cl->start);
+    mem_free(cl->items);
+    mem_free(cl->cell_of);
+    cl->start = NULL;
+    cl->items = NULL;
+    cl->cell_of = NULL;
+    cl->n = 0;
+}
+
+void celllist_cell_coords(const CellList *cl, double x, double y, int *cx, int *cy){
+    if(cl->use_pbc){
+        x = wrap_pos(x, cl->box_x);
+        y = wrap_pos(y, cl->box_y);
+    }
+    int ix = (int)floor((x - cl->x0) / cl->cw);
+    int iy = (int)floor((y - cl->y0) / cl->ch);
+    if(ix < 0) ix = 0;
+    if(iy < 0) iy = 0;
+    if(ix >= cl->ncx) ix = cl->ncx - 1;
+    if(iy >= cl->ncy) iy = cl->ncy - 1;
+    *cx = ix;
+    *cy = iy;
+}
+
+/* Range of cell coordinates covered by a ring along one axis; *full if it spans the axis */
+static void ring_range(int c, int ring, int nc, bool use_pbc, int *lo, int *hi, int *full){
+    if(use_pbc){
+        if(2 * ring + 1 >= nc){ *lo = 0; *hi = nc - 1; *full = 1; }
+        else                  { *lo = c - ring; *hi = c + ring; *full = 0; }
+    } else {
+        *lo = c - ring < 0 ? 0 : c - ring;
+        *hi = c + ring > nc - 1 ? nc - 1 : c + ring;
+        *full = (*lo == 0 && *hi == nc - 1);
+    }
+}
+
+double celllist_gather(const CellList *cl, double x, double y, int ring, IntArray *out){
+    int cx, cy;
+    celllist_cell_coords(cl, x, y, &cx, &cy);
+
+    int xlo, xhi, ylo, yhi, fullx, fully;
+    ring_range(cx, ring, cl->ncx, cl->use_pbc, &xlo, &xhi, &fullx);
+    ring_range(cy, ring, cl->ncy, cl->use_pbc, &ylo, &yhi, &fully);
+
+    for(int gy = ylo; gy <= yhi; gy++){
+        int wy = gy;
+        if(wy < 0) wy += cl->ncy;
+        else if(wy >= cl->ncy) wy -= cl->ncy;
+        for(int gx = xlo; gx <= xhi; gx++){
+            int wx = gx;
+            if(wx < 0) wx += cl->ncx;
+            else if(wx >= cl->ncx) wx -= cl->ncx;
+            int c = wy * cl->ncx + wx;
+            for(int k = cl->start[c]; k < cl->start[c + 1]; k++){
+                ia_push(out, cl->items[k]);
+            }
+        }
+    }
+
+    double r = INFINITY;
+    if(!fullx && ring * cl->cw < r) r = ring * cl->cw;
+    if(!fully && ring * cl->ch < r) r = ring * cl->ch;
+    return r;
+}
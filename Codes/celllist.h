@@ -0,0 +1,57 @@
+#ifndef CELLLIST_H
+#define CELLLIST_H
+
+#include <stdbool.h>
+#include "utils.h"   /* Vec2Array, IntArray, mic_delta, wrap_pos */
+
+/*
+ * CellList
+ *
+ * Uniform grid binning of a 2D point set, stored CSR-style:
+ *   points of cell c are items[start[c] .. start[c+1]-1].
+ *
+ * With use_pbc the grid tiles the box [0,box_x) x [0,box_y) exactly and cell
+ * indices wrap; otherwise it covers the bounding box of the points.
+ */
+typedef struct {
+    int     ncx, ncy;     /* number of cells along x and y */
+    double  cw, ch;       /* cell width and height */
+    double  x0, y0;       /* lower-left corner of cell (0,0) */
+    bool    use_pbc;
+    double  box_x, box_y;
+    int     n;            /* number of points binned */
+    int    *start;        /* length ncx*ncy + 1 */
+    int    *items;        /* length n, point indices grouped by cell */
+    int    *cell_of;      /* length n, cell index of each point */
+} CellList;
+
+/*
+ * celllist_build
+ *
+ * Bins `pos` into cells of side >= cell_size (cell_size <= 0 picks ~2 points per cell).
+ * The number of cells is capped at a small multiple of the number of points.
+ *
+ * Returns 0 on success, non-zero on error. Caller must call celllist_free().
+ */
+int celllist_build(CellList *cl, const Vec2Array *pos, double cell_size,
+                   bool use_pbc, double box_x, double box_y);
+
+void celllist_free(CellList *cl);
+
+/* Cell coordinates of a position (wrapped with PBC, clamped otherwise) */
+void celllist_cell_coords(const CellList *cl, double x, double y, int *cx, int *cy);
+
+/*
+ * celllist_gather
+ *
+ * Appends to `out` the members of all cells within `ring` cells (Chebyshev
+ * distance) of the cell containing (x, y); with PBC each cell is visited once
+ * even when the ring wraps around the box.
+ *
+ * Returns the radius within which the gathered set is complete: every point
+ * closer than this (minimum-image distance with PBC) is in `out`.  Returns
+ * INFINITY once the ring covers the whole grid.
+ */
+double celllist_gather(const CellList *cl, double x, double y, int ring, IntArray *out);
+
+#endif /* CELLLIST_H */
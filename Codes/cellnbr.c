@@ -0,0 +1,155 @@
+/*
+ * cellnbr.c
+ *
+ * SANN and k-nearest-neighbor engines built on a PBC-aware cell list.
+ *
+ * For each point the candidate set grows ring by ring around its cell until
+ * the sorted candidate distances are complete up to the radius the criterion
+ * needs (celllist_gather reports that radius), so results are exact.
+ */
+
+#include "cellnbr.h"
+#include "memacct.h"
+#include "celllist.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct { double r; int j; } DistIdx;
+
+static int cmp_dist(const void *a, const void *b){
+    const DistIdx *da = (const DistIdx*)a, *db = (const DistIdx*)b;
+    if(da->r < db->r) return -1;
+    if(da->r > db->r) return 1;
+    return (da->j > db->j) - (da->j < db->j);
+}
+
+static void sort_dist(DistIdx *d, int n){
+    if(n > 32){
+        qsort(d, (size_t)n, sizeof(DistIdx), cmp_dist);
+        return;
+    }
+    for(int a = 1; a < n; a++){
+        DistIdx v = d[a];
+        int b = a - 1;
+        while(b >= 0 && cmp_dist(&d[b], &v) > 0){ d[b + 1] = d[b]; b--; }
+        d[b + 1] = v;
+    }
+}
+
+/* Number of leading entries of d[0..nc-1] selected by SANN, or -1 if the
+ * candidates (complete within rc) cannot decide yet. */
+static int sann_select(const DistIdx *d, int nc, double rc){
+    for(int m = 3; m < nc; m++){
+        double rnext = d[m].r;
+        if(rnext > rc) return -1;
+        if(rnext <= 0.0) continue;   /* coincident points */
+        double sum = 0.0;
+        for(int j = 0; j < m; j++) sum += acos(d[j].r / rnext);
+        if(sum > M_PI) return m;
+    }
+    return isinf(rc) ? nc : -1;
+}
+
+static int knn_select(const DistIdx *d, int nc, double rc, int k){
+    if(nc >= k && d[k - 1].r <= rc) return k;
+    return isinf(rc) ? (nc < k ? nc : k) : -1;
+}
+
+/* engine: 0 = SANN, 1 = kNN */
+static IntArray *cell_neighbors(const Vec2Array *points, int engine, int k,
+                                bool use_pbc, double box_x, double box_y, int *out_M)
+{
+    if(!points || !out_M){
+        fprintf(stderr, "cell_neighbors: invalid args\n");
+        return NULL;
+    }
+    const int M = (int)points->n;
+    *out_M = 0;
+    if(M <= 0) return NULL;
+
+    CellList cl;
+    if(celllist_build(&cl, points, 0.0, use_pbc, box_x, box_y) != 0) return NULL;
+
+    IntArray *neighbors = (IntArray*)mem_malloc(sizeof(IntArray) * (size_t)M);
+    IntArray cand;
+    ia_init(&cand);
+    DistIdx *d = NULL;
+    size_t dcap = 0;
+    if(!neighbors){
+        fprintf(stderr, "cell_neighbors: OOM\n");
+        celllist_free(&cl);
+        return NULL;
+    }
+    for(int i=0;i<M;i++) ia_init(&neighbors[i]);
+
+    for(int i=0;i<M;i++){
+        const double xi = points->data[i].x, yi = points->data[i].y;
+        for(int ring = 1; ; ring++){
+            cand.n = 0;
+            double rc = celllist_gather(&cl, xi, yi, ring, &cand);
+            if(cand.n > dcap){
+                size_t nc = cand.cap;
+                DistIdx *tmp = (DistIdx*)mem_realloc(d, nc * sizeof(DistIdx));
+                if(!tmp){
+                    fprintf(stderr, "cell_neighbors: OOM\n");
+                    mem_free(d); ia_free(&cand); celllist_free(&cl);
+                    for(int q=0;q<M;q++) ia_free(&neighbors[q]);
+                    mem_free(neighbors);
+                    return NULL;
+                }
+                d = tmp;
+                dcap = nc;
+            }
+            int nd = 0;
+            for(size_t c = 0; c < cand.n; c++){
+                int j = cand.data[c];
+                if(j == i) continue;
+                double dx = points->data[j].x - xi;
+                double dy = points->data[j].y - yi;
+                if(use_pbc){
+                    dx = mic_delta(dx, box_x);
+                    dy = mic_delta(dy, box_y);
+                }
+                d[nd].r = sqrt(dx*dx + dy*dy);
+                d[nd].j = j;
+                nd++;
+            }
+            sort_dist(d, nd);
+
+            int m = (engine == 0) ? sann_select(d, nd, rc) : knn_select(d, nd, rc, k);
+            if(m < 0) continue;
+            for(int q = 0; q < m; q++) ia_push(&neighbors[i], d[q].j);
+            break;
+        }
+    }
+
+    mem_free(d);
+    ia_free(&cand);
+    celllist_free(&cl);
+    *out_M = M;
+    return neighbors;
+}
+
+IntArray *sann_neighbors(const Vec2Array *points,
+                         bool use_pbc, double box_x, double box_y,
+                         int *out_M)
+{
+    return cell_neighbors(points, 0, 0, use_pbc, box_x, box_y, out_M);
+}
+
+IntArray *knn_neighbors(const Vec2Array *points, int k,
+                        bool use_pbc, double box_x, double box_y,
+                        int *out_M)
+{
+    if(k <= 0){
+        fprintf(stderr, "knn_neighbors: k must be > 0\n");
+        if(out_M) *out_M = 0;
+        return NULL;
+    }
+    return cell_neighbors(points, 1, k, use_pbc, box_x, box_y, out_M);
+}
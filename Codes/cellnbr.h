@@ -0,0 +1,37 @@
+#ifndef CELLNBR_H
+#define CELLNBR_H
+
+#include <stdbool.h>
+#include "utils.h"
+
+/*
+ * Cell-list neighbor engines (alternatives to the Delaunay neighbors).
+ *
+ * Both return the same layout as triangulate_get_neighbors: a malloc'd array of
+ * M IntArrays, neighbors[i] listing indices in [0..M-1], to be released with
+ * neighbors_free(). Unlike Delaunay neighbors the relation need not be
+ * symmetric (j may be a neighbor of i but not the reverse).
+ * Distances use the minimum image when use_pbc is true.
+ * On failure: returns NULL.
+ */
+
+/*
+ * sann_neighbors
+ *
+ * Parameter-free SANN (solid-angle based nearest neighbors, van Meel et al.
+ * 2012), in its 2D form: with neighbors sorted by distance r_1 <= r_2 <= ...,
+ * point i gets the smallest m >= 3 such that the radius R_m solving
+ *     sum_{j=1..m} arccos(r_j / R_m) = pi
+ * satisfies R_m < r_{m+1}.  Since the sum grows with R this is tested as
+ * sum_{j=1..m} arccos(r_j / r_{m+1}) > pi, without solving for R_m.
+ */
+IntArray *sann_neighbors(const Vec2Array *points,
+                         bool use_pbc, double box_x, double box_y,
+                         int *out_M);
+
+/* knn_neighbors: the k nearest points of each point (fewer if M-1 < k) */
+IntArray *knn_neighbors(const Vec2Array *points, int k,
+                        bool use_pbc, double box_x, double box_y,
+                        int *out_M);
+
+#endif /* CELLNBR_H */
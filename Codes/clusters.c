@@ -8,6 +8,7 @@
  */
 
 #include "clusters.h"
+#include "memacct.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -21,8 +22,8 @@ typedef struct {
 
 static void uf_init(UF *uf, int n){
     uf->n = n;
-    uf->parent = (int*)malloc(n * sizeof(int));
-    uf->rank   = (int*)calloc(n, sizeof(int));
+    uf->parent = (int*)mem_malloc(n * sizeof(int));
+    uf->rank   = (int*)mem_calloc(n, sizeof(int));
     if(!uf->parent || !uf->rank){
         fprintf(stderr, "UF: out of memory\n");
         exit(1);
@@ -32,10 +33,10 @@ static void uf_init(UF *uf, int n){
 
 static void uf_free(UF *uf){
     if(uf->parent){
-        free(uf->parent);
+        mem_free(uf->parent);
     } 
     if(uf->rank){
-        free(uf->rank);
+        mem_free(uf->rank);
     }
     uf->parent = NULL;
     uf->rank = NULL;
@@ -57,10 +58,11 @@ static int uf_root(UF *uf, int i){
     return r;
 }
 
-static void uf_union(UF *uf, int a, int b){
+/* returns 1 if two distinct sets were merged, 0 if a and b were already joined */
+static int uf_union(UF *uf, int a, int b){
     int ra = uf_root(uf, a);
     int rb = uf_root(uf, b);
-    if(ra == rb) return;
+    if(ra == rb) return 0;
     if(uf->rank[ra] < uf->rank[rb]){
         uf->parent[ra] = rb;
     }
@@ -71,6 +73,7 @@ static void uf_union(UF *uf, int a, int b){
         uf->parent[rb] = ra; 
         uf->rank[ra]++; 
     }
+    return 1;
 }
 
 /* ------------------- Public API ------------------- */
@@ -102,6 +105,7 @@ int *find_clusters_from_vec2array(const Vec2Array *pos,
     UF uf;
     uf_init(&uf, N);
     const double lb2 = lbond * lbond;
+    int nmerged = 0;
 
     /* naive O(N^2) pair scan. Replace by cell-list if N large. */
     for(int i=0;i<N-1;i++){
@@ -114,13 +118,24 @@ int *find_clusters_from_vec2array(const Vec2Array *pos,
             }
             double d2 = dx*dx + dy*dy;
             if(d2 <= lb2){
-                uf_union(&uf, i, j);
+                nmerged += uf_union(&uf, i, j);
             }
         }
     }
 
+    /* all singletons (lbond below the closest pair): labels are the identity,
+       no root/map pass needed */
+    if(nmerged == 0){
+        uf_free(&uf);
+        int *cluster_id = (int*)mem_malloc(N * sizeof(int));
+        if(!cluster_id){ fprintf(stderr,"find_clusters: OOM\n"); return NULL; }
+        for(int i=0;i<N;i++) cluster_id[i] = i;
+        *out_nclusters = N;
+        return cluster_id;
+    }
+
     /* compute root for each particle */
-    int *root = (int*)malloc(N * sizeof(int));
+    int *root = (int*)mem_malloc(N * sizeof(int));
     if(!root){
         fprintf(stderr,"find_clusters: OOM\n"); 
         uf_free(&uf); 
@@ -131,10 +146,10 @@ int *find_clusters_from_vec2array(const Vec2Array *pos,
     }
 
     /* map distinct roots to compact cluster indices */
-    int *map = (int*)malloc(N * sizeof(int));
+    int *map = (int*)mem_malloc(N * sizeof(int));
     if(!map){
         fprintf(stderr,"find_clusters: OOM\n"); 
-        free(root); 
+        mem_free(root); 
         uf_free(&uf); 
         return NULL; 
     }
@@ -150,14 +165,14 @@ int *find_clusters_from_vec2array(const Vec2Array *pos,
     }
 
     /* create cluster_id array (caller frees) */
-    int *cluster_id = (int*)malloc(N * sizeof(int));
-    if(!cluster_id){ fprintf(stderr,"find_clusters: OOM\n"); free(root); free(map); uf_free(&uf); return NULL; }
+    int *cluster_id = (int*)mem_malloc(N * sizeof(int));
+    if(!cluster_id){ fprintf(stderr,"find_clusters: OOM\n"); mem_free(root); mem_free(map); uf_free(&uf); return NULL; }
     for(int i=0;i<N;i++){
         cluster_id[i] = map[root[i]];
     }
 
-    free(root);
-    free(map);
+    mem_free(root);
+    mem_free(map);
     uf_free(&uf);
 
     *out_nclusters = nclusters;
@@ -168,7 +183,7 @@ IntArray *make_clusters_from_ids(const int *cluster_id, int N, int nclusters){
     if(nclusters <= 0) return NULL;
     if(!cluster_id || N <= 0) return NULL;
 
-    IntArray *clusters = (IntArray*)malloc(nclusters * sizeof(IntArray));
+    IntArray *clusters = (IntArray*)mem_malloc(nclusters * sizeof(IntArray));
     if(!clusters){ fprintf(stderr,"make_clusters_from_ids: OOM\n"); return NULL; }
     for(int k=0;k<nclusters;k++) ia_init(&clusters[k]);
 
@@ -14,12 +14,17 @@
  *   - box_x, box_y: box dimensions when use_pbc is true (must be > 0)
  *
  * Outputs:
- *   - returns a malloc'd int array cluster_id of length N,
+ *   - returns a mem_malloc'd int array cluster_id of length N,
  *       cluster_id[i] in [0 .. nclusters-1]
  *   - sets *out_nclusters to the number of clusters found
  *
+ * If no pair is within lbond, every particle is its own cluster:
+ * cluster_id[i] == i and *out_nclusters == N. Callers can test
+ * nclusters == N to skip per-cluster bookkeeping and use the positions
+ * directly as COMs.
+ *
  * Ownership:
- *   - Caller must free() the returned array when done.
+ *   - Caller must mem_free() the returned array when done.
  */
 int *find_clusters_from_vec2array(const Vec2Array *pos,
                                   double lbond,
@@ -37,11 +42,11 @@ int *find_clusters_from_vec2array(const Vec2Array *pos,
  *   - nclusters: number of clusters (max cluster_id + 1)
  *
  * Returns:
- *   - malloc'd pointer to an array of IntArray of length nclusters.
+ *   - mem_malloc'd pointer to an array of IntArray of length nclusters.
  *     For cluster k, arr[k].data[0..arr[k].n-1] are member particle indices.
  *
  * Ownership:
- *   - Caller must call ia_free(&arr[k]) for k=0..nclusters-1, then free(arr).
+ *   - Caller must call ia_free(&arr[k]) for k=0..nclusters-1, then mem_free(arr).
  */
 IntArray *make_clusters_from_ids(const int *cluster_id, int N, int nclusters);
 
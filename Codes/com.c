@@ -11,6 +11,7 @@
  */
 
 #include "com.h"
+#include "memacct.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -103,7 +104,7 @@ int compute_cluster_coms_from_ids(const Vec2Array *pos,
     }
 
     /* build IntArray list */
-    IntArray *clusters = (IntArray*)malloc((size_t)nclusters * sizeof(IntArray));
+    IntArray *clusters = (IntArray*)mem_malloc((size_t)nclusters * sizeof(IntArray));
     if(!clusters){ fprintf(stderr, "compute_cluster_coms_from_ids: OOM\n"); return 2; }
     for(int k=0;k<nclusters;k++) ia_init(&clusters[k]);
 
@@ -119,7 +120,30 @@ int compute_cluster_coms_from_ids(const Vec2Array *pos,
     int rc = compute_cluster_coms(pos, clusters, nclusters, use_pbc, box_x, box_y, coms);
 
     for(int k=0;k<nclusters;k++) ia_free(&clusters[k]);
-    free(clusters);
+    mem_free(clusters);
 
     return rc;
 }
+
+/* Keep only COMs of clusters with min_size <= size <= max_size (max_size <= 0: unbounded) */
+int filter_coms_by_size(Vec2Array *coms,
+                        const IntArray *clusters,
+                        int nclusters,
+                        int min_size,
+                        int max_size)
+{
+    if(!coms || !clusters || nclusters < 0 || (size_t)nclusters != coms->n){
+        fprintf(stderr, "filter_coms_by_size: invalid arguments\n");
+        return -1;
+    }
+
+    size_t kept = 0;
+    for(int c = 0; c < nclusters; ++c){
+        int nm = (int)clusters[c].n;
+        if(nm < min_size) continue;
+        if(max_size > 0 && nm > max_size) continue;
+        coms->data[kept++] = coms->data[c];
+    }
+    coms->n = kept;
+    return (int)kept;
+}
@@ -51,4 +51,25 @@ int compute_cluster_coms_from_ids(const Vec2Array *pos,
                                   bool use_pbc, double box_x, double box_y,
                                   Vec2Array *coms);
 
+/*
+ * filter_coms_by_size
+ *
+ * Drops the COMs of clusters whose member count lies outside
+ * [min_size, max_size], compacting `coms` in place (order is kept).
+ *
+ * Inputs:
+ *   - coms: COMs from compute_cluster_coms (coms->n == nclusters)
+ *   - clusters, nclusters: cluster member lists the COMs were computed from
+ *   - min_size: smallest cluster size kept (<= 1 keeps everything from below)
+ *   - max_size: largest cluster size kept (<= 0 means no upper limit)
+ *
+ * Returns:
+ *   - number of COMs kept (new coms->n), or -1 on invalid args.
+ */
+int filter_coms_by_size(Vec2Array *coms,
+                        const IntArray *clusters,
+                        int nclusters,
+                        int min_size,
+                        int max_size);
+
 #endif /* COM_H */
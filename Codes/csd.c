@@ -0,0 +1,120 @@
+/*
+ * csd.c
+ *
+ * Cluster size distribution (see csd.h).
+ */
+
+#include "csd.h"
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+struct CsdAccum {
+    double *count;        /* clusters of size s at count[s] */
+    int     maxsize;      /* count has maxsize + 1 entries */
+    long    frames;
+    double  clusters, particles;
+};
+
+CsdAccum *csd_create(void){
+    CsdAccum *C = (CsdAccum*)mem_calloc(1, sizeof(CsdAccum));
+    if(!C) fprintf(stderr,"csd_create: OOM\n");
+    return C;
+}
+
+void csd_free(CsdAccum *C){
+    if(!C) return;
+    mem_free(C->count);
+    mem_free(C);
+}
+
+/* Make count[] cover sizes up to s */
+static int csd_reserve(CsdAccum *C, int s){
+    if(s <= C->maxsize && C->count) return 0;
+    double *nc = (double*)mem_realloc(C->count, ((size_t)s + 1) * sizeof(double));
+    if(!nc){
+        fprintf(stderr,"csd: OOM\n");
+        return 1;
+    }
+    const int from = C->count ? C->maxsize + 1 : 0;
+    memset(nc + from, 0, ((size_t)s + 1 - (size_t)from) * sizeof(double));
+    C->count = nc;
+    C->maxsize = s;
+    return 0;
+}
+
+int csd_accumulate(CsdAccum *C, const int *cluster_id, int N, int nclusters){
+    if(!C || N < 0 || nclusters < 0){
+        fprintf(stderr,"csd_accumulate: invalid arguments\n");
+        return 1;
+    }
+    if(!cluster_id){
+        if(csd_reserve(C, 1) != 0) return 2;
+        C->count[1] += nclusters;
+    } else {
+        int *size = (int*)mem_calloc((size_t)(nclusters > 0 ? nclusters : 1), sizeof(int));
+        if(!size){
+            fprintf(stderr,"csd_accumulate: OOM\n");
+            return 2;
+        }
+        int smax = 0;
+        for(int i=0;i<N;i++){
+            const int c = cluster_id[i];
+            if(c < 0 || c >= nclusters) continue;
+            if(++size[c] > smax) smax = size[c];
+        }
+        if(csd_reserve(C, smax) != 0){
+            mem_free(size);
+            return 2;
+        }
+        for(int c=0;c<nclusters;c++) C->count[size[c]] += 1.0;
+        mem_free(size);
+    }
+    C->frames++;
+    C->clusters += nclusters;
+    C->particles += N;
+    return 0;
+}
+
+int csd_merge(CsdAccum *A, const CsdAccum *B){
+    if(!A || !B){
+        fprintf(stderr,"csd_merge: invalid arguments\n");
+        return 1;
+    }
+    if(B->count){
+        if(csd_reserve(A, B->maxsize) != 0) return 2;
+        for(int s=0;s<=B->maxsize;s++) A->count[s] += B->count[s];
+    }
+    A->frames += B->frames;
+    A->clusters += B->clusters;
+    A->particles += B->particles;
+    return 0;
+}
+
+void csd_clear(CsdAccum *C){
+    if(C->count) memset(C->count, 0, ((size_t)C->maxsize + 1) * sizeof(double));
+    C->frames = 0;
+    C->clusters = C->particles = 0.0;
+}
+
+int csd_write(const CsdAccum *C, const char *outpath, int t0, int t1, double lbond){
+    if(!C || !outpath){ fprintf(stderr,"csd_write: invalid args\n"); return 1; }
+    FILE *f = fopen(outpath, "w");
+    if(!f){
+        fprintf(stderr,"csd_write: cannot open %s: %s\n", outpath, strerror(errno));
+        return 2;
+    }
+    fprintf(f, "# Cluster size distribution over snapshots time_%d .. time_%d\n", t0, t1);
+    fprintf(f, "# Columns: size  count  fraction_of_clusters  clusters_per_snapshot\n");
+    fprintf(f, "# Params: lbond = %.8g\n", lbond);
+    fprintf(f, "# Snapshots: %ld  clusters: %.0f  particles: %.0f\n", C->frames, C->clusters, C->particles);
+    for(int s=1;C->count && s<=C->maxsize;s++){
+        if(C->count[s] <= 0.0) continue;
+        fprintf(f, "%d %.0f %.10e %.10e\n", s, C->count[s], C->count[s] / C->clusters,
+                C->count[s] / (double)C->frames);
+    }
+    fclose(f);
+    return 0;
+}
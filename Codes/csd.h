@@ -0,0 +1,34 @@
+#ifndef CSD_H
+#define CSD_H
+
+/*
+ * CsdAccum
+ *
+ * Cluster size distribution over snapshots: how many clusters of each size
+ * (number of particles) were found, before any cluster-size filter.
+ */
+typedef struct CsdAccum CsdAccum;
+
+CsdAccum *csd_create(void);
+void csd_free(CsdAccum *C);
+
+/*
+ * csd_accumulate
+ *
+ * Add one snapshot from its cluster labels (cluster_id[i] in 0..nclusters-1
+ * for each of the N particles). cluster_id == NULL means every particle is
+ * its own cluster. Returns 0 on success.
+ */
+int csd_accumulate(CsdAccum *C, const int *cluster_id, int N, int nclusters);
+
+/* Add B's snapshots to A. Returns 0 on success. */
+int csd_merge(CsdAccum *A, const CsdAccum *B);
+
+/* Reset to no snapshots */
+void csd_clear(CsdAccum *C);
+
+/* Write "size count fraction per_snapshot" for every size that occurs.
+   Returns 0 on success. */
+int csd_write(const CsdAccum *C, const char *outpath, int t0, int t1, double lbond);
+
+#endif /* CSD_H */
@@ -2,6 +2,9 @@
  * delaunay.c
  *
  * Triangle wrapper that returns deduplicated neighbor lists for original points.
+ * The in-tree dt2d engine can be selected instead of Triangle; both consume the
+ * same point list (with PBC images) and go through the same edge -> neighbor mapping.
+ * compute_neighbors() also dispatches to the cell-list engines (SANN, kNN).
  *
  * Requires triangle.h in include path and Triangle library (or triangle.c) linked.
  *
@@ -9,12 +12,15 @@
  */
 
 #include "delaunay.h"
+#include "memacct.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 #define REAL double
 #include "triangle.h"  /* Triangle API; ensure this is available at compile time */
+#include "dt2d.h"
+#include "cellnbr.h"
 
 /* Utility: check for neighbor presence (linear) */
 static inline int neighbor_has(const IntArray *nbrs, int v){
@@ -24,40 +30,24 @@ static inline int neighbor_has(const IntArray *nbrs, int v){
     return 0;
 }
 
-IntArray *triangulate_get_neighbors(const Vec2Array *points,
-                                    bool use_pbc,
-                                    double box_x, double box_y,
-                                    int *out_M)
+/* Build the Triangle-style interleaved point list (points + 8 images if PBC). Caller frees. */
+static REAL *build_pointlist(const Vec2Array *points, bool use_pbc,
+                             double box_x, double box_y, int *out_total)
 {
-    if(!points || !out_M){ 
-        fprintf(stderr,"triangulate: invalid args\n");
-        return NULL;
-     }
     const int M = (int)points->n;
-    *out_M = 0;
-    if(M <= 0){
-        return NULL;
-     }
-
-    /* build Triangle input structure (points + images if PBC) */
-    struct triangulateio in, out;
-    memset(&in, 0, sizeof(in));
-    memset(&out, 0, sizeof(out));
-
     int total_points = M;
     if(use_pbc) {
         if(box_x <= 0.0 || box_y <= 0.0){ fprintf(stderr,"triangulate: invalid box dims\n"); return NULL; }
         total_points = M * 9; /* original + 8 images */
     }
 
-    in.numberofpoints = total_points;
-    in.pointlist = (REAL*)malloc((size_t)total_points * 2 * sizeof(REAL));
-    if(!in.pointlist){ fprintf(stderr,"triangulate: OOM\n"); return NULL; }
+    REAL *pointlist = (REAL*)mem_malloc((size_t)total_points * 2 * sizeof(REAL));
+    if(!pointlist){ fprintf(stderr,"triangulate: OOM\n"); return NULL; }
 
     /* fill originals */
     for(int i=0;i<M;i++){
-        in.pointlist[i*2 + 0] = points->data[i].x;
-        in.pointlist[i*2 + 1] = points->data[i].y;
+        pointlist[i*2 + 0] = points->data[i].x;
+        pointlist[i*2 + 1] = points->data[i].y;
     }
 
     /* fill images */
@@ -68,40 +58,27 @@ IntArray *triangulate_get_neighbors(const Vec2Array *points,
             double sx = shifts[s][0] * box_x;
             double sy = shifts[s][1] * box_y;
             for(int i=0;i<M;i++){
-                in.pointlist[idx*2 + 0] = points->data[i].x + sx;
-                in.pointlist[idx*2 + 1] = points->data[i].y + sy;
+                pointlist[idx*2 + 0] = points->data[i].x + sx;
+                pointlist[idx*2 + 1] = points->data[i].y + sy;
                 idx++;
             }
         }
     }
 
-    in.numberofpointattributes = 0;
-    in.pointmarkerlist = NULL;
-    in.numberofsegments = 0;
-    in.segmentlist = NULL;
-
-    /* Run Triangle: z = zero-based indexing, P = no new points, E = output edges, Q = quiet */
-    char switches[] = "zeQ";
-    triangulate(switches, &in, &out, NULL);
-
-    if(out.numberofedges <= 0){
-        fprintf(stderr,"triangulate: no edges produced\n");
-        free(in.pointlist);
-        if(out.pointlist) trifree(out.pointlist);
-        if(out.edgelist) trifree(out.edgelist);
-        if(out.trianglelist) trifree(out.trianglelist);
-        return NULL;
-    }
+    *out_total = total_points;
+    return pointlist;
+}
 
-    /* Allocate neighbor arrays for original M points */
-    IntArray *neighbors = (IntArray*)malloc(sizeof(IntArray) * (size_t)M);
-    if(!neighbors){ fprintf(stderr,"triangulate: OOM neighbors\n"); free(in.pointlist); if(out.pointlist) trifree(out.pointlist); if(out.edgelist) trifree(out.edgelist); if(out.trianglelist) trifree(out.trianglelist); return NULL; }
+/* Map an edge list over (possibly imaged) points back to unique neighbor lists of the M originals */
+static IntArray *neighbors_from_edges(const int *edgelist, int nedges, int M){
+    IntArray *neighbors = (IntArray*)mem_malloc(sizeof(IntArray) * (size_t)M);
+    if(!neighbors){ fprintf(stderr,"triangulate: OOM neighbors\n"); return NULL; }
     for(int i=0;i<M;i++) ia_init(&neighbors[i]);
 
     /* Scan edges and add unique neighbor pairs (map image indices back to originals with %M) */
-    for(int e=0; e < out.numberofedges; e++){
-        int p1 = out.edgelist[e*2 + 0];
-        int p2 = out.edgelist[e*2 + 1];
+    for(int e=0; e < nedges; e++){
+        int p1 = edgelist[e*2 + 0];
+        int p2 = edgelist[e*2 + 1];
 
         /* Map to original index [0..M-1] */
         int o1 = p1 % M;
@@ -116,20 +93,159 @@ IntArray *triangulate_get_neighbors(const Vec2Array *points,
         /* Add o1 to neighbors of o2 if not present */
         if(!neighbor_has(&neighbors[o2], o1)) ia_push(&neighbors[o2], o1);
     }
+    return neighbors;
+}
+
+static IntArray *neighbors_triangle(REAL *pointlist, int total_points, int M){
+    struct triangulateio in, out;
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    in.numberofpoints = total_points;
+    in.pointlist = pointlist;
+    in.numberofpointattributes = 0;
+    in.pointmarkerlist = NULL;
+    in.numberofsegments = 0;
+    in.segmentlist = NULL;
+
+    /* Run Triangle: z = zero-based indexing, P = no new points, E = output edges, Q = quiet */
+    char switches[] = "zeQ";
+    triangulate(switches, &in, &out, NULL);
+
+    IntArray *neighbors = NULL;
+    if(out.numberofedges <= 0){
+        fprintf(stderr,"triangulate: no edges produced\n");
+    } else {
+        neighbors = neighbors_from_edges(out.edgelist, out.numberofedges, M);
+    }
 
-    /* Cleanup Triangle memory. in.pointlist was malloc'ed by us -> free() it.
-       out.* must be freed with trifree() if non-NULL. */
-    free(in.pointlist);
+    /* out.* must be freed with trifree() if non-NULL (in.pointlist is ours) */
     if(out.pointlist) trifree(out.pointlist);
     if(out.edgelist) trifree(out.edgelist);
     if(out.trianglelist) trifree(out.trianglelist);
+    return neighbors;
+}
+
+static IntArray *neighbors_dt2d(const REAL *pointlist, int total_points, int M){
+    int *edges = NULL;
+    int nedges = 0;
+    if(dt2d_edges(pointlist, total_points, &edges, &nedges) != 0) return NULL;
+
+    IntArray *neighbors = NULL;
+    if(nedges <= 0){
+        fprintf(stderr,"triangulate: no edges produced\n");
+    } else {
+        neighbors = neighbors_from_edges(edges, nedges, M);
+    }
+    mem_free(edges);
+    return neighbors;
+}
+
+IntArray *triangulate_get_neighbors_engine(const Vec2Array *points,
+                                           bool use_pbc,
+                                           double box_x, double box_y,
+                                           NeighborEngine engine,
+                                           int *out_M)
+{
+    if(!points || !out_M){ 
+        fprintf(stderr,"triangulate: invalid args\n");
+        return NULL;
+     }
+    const int M = (int)points->n;
+    *out_M = 0;
+    if(M <= 0){
+        return NULL;
+     }
+
+    int total_points = 0;
+    REAL *pointlist = build_pointlist(points, use_pbc, box_x, box_y, &total_points);
+    if(!pointlist) return NULL;
+
+    IntArray *neighbors = NULL;
+    switch(engine){
+        case NEIGHBOR_ENGINE_DT2D:
+            neighbors = neighbors_dt2d(pointlist, total_points, M);
+            break;
+        case NEIGHBOR_ENGINE_TRIANGLE:
+        default:   /* non-Delaunay engines are reached through compute_neighbors() */
+            neighbors = neighbors_triangle(pointlist, total_points, M);
+            break;
+    }
+    mem_free(pointlist);
+    if(!neighbors) return NULL;
 
     *out_M = M;
     return neighbors;
 }
 
+IntArray *triangulate_get_neighbors(const Vec2Array *points,
+                                    bool use_pbc,
+                                    double box_x, double box_y,
+                                    int *out_M)
+{
+    return triangulate_get_neighbors_engine(points, use_pbc, box_x, box_y,
+                                            NEIGHBOR_ENGINE_TRIANGLE, out_M);
+}
+
+IntArray *compute_neighbors(const Vec2Array *points,
+                            bool use_pbc,
+                            double box_x, double box_y,
+                            const NeighborParams *par,
+                            int *out_M)
+{
+    if(!par){
+        fprintf(stderr,"compute_neighbors: invalid args\n");
+        return NULL;
+    }
+    switch(par->engine){
+        case NEIGHBOR_ENGINE_SANN:
+            return sann_neighbors(points, use_pbc, box_x, box_y, out_M);
+        case NEIGHBOR_ENGINE_KNN:
+            return knn_neighbors(points, par->knn_k, use_pbc, box_x, box_y, out_M);
+        case NEIGHBOR_ENGINE_TRIANGLE:
+        case NEIGHBOR_ENGINE_DT2D:
+        default:
+            return triangulate_get_neighbors_engine(points, use_pbc, box_x, box_y, par->engine, out_M);
+    }
+}
+
+int neighbor_engine_parse(const char *name, NeighborEngine *engine){
+    if(!name || !engine) return 1;
+    if(strcmp(name, "triangle") == 0){ *engine = NEIGHBOR_ENGINE_TRIANGLE; return 0; }
+    if(strcmp(name, "dt2d") == 0)    { *engine = NEIGHBOR_ENGINE_DT2D;     return 0; }
+    if(strcmp(name, "sann") == 0)    { *engine = NEIGHBOR_ENGINE_SANN;     return 0; }
+    if(strcmp(name, "knn") == 0)     { *engine = NEIGHBOR_ENGINE_KNN;      return 0; }
+    return 1;
+}
+
+const char *neighbor_engine_name(NeighborEngine engine){
+    switch(engine){
+        case NEIGHBOR_ENGINE_TRIANGLE: return "triangle";
+        case NEIGHBOR_ENGINE_DT2D:     return "dt2d";
+        case NEIGHBOR_ENGINE_SANN:     return "sann";
+        case NEIGHBOR_ENGINE_KNN:      return "knn";
+    }
+    return "unknown";
+}
+
 void neighbors_free(IntArray *neighbors, int M){
     if(!neighbors) return;
     for(int i=0;i<M;i++) ia_free(&neighbors[i]);
-    free(neighbors);
+    mem_free(neighbors);
+}
+
+void neighbors_compare(const IntArray *ref, const IntArray *test, int M, NeighborCompare *out){
+    if(!out) return;
+    memset(out, 0, sizeof(*out));
+    if(!ref || !test) return;
+    for(int i=0;i<M;i++){
+        int common = 0;
+        for(size_t k=0;k<test[i].n;k++){
+            if(neighbor_has(&ref[i], test[i].data[k])) common++;
+        }
+        out->ref_entries    += (long)ref[i].n;
+        out->test_entries   += (long)test[i].n;
+        out->common_entries += common;
+        if(common == (int)ref[i].n && common == (int)test[i].n) out->points_identical++;
+    }
 }
@@ -4,6 +4,19 @@
 #include "utils.h"
 #include <stdbool.h>
 
+/* Backend used to compute neighbor lists */
+typedef enum {
+    NEIGHBOR_ENGINE_TRIANGLE = 0,   /* Delaunay via Shewchuk's Triangle, switches "zeQ" */
+    NEIGHBOR_ENGINE_DT2D     = 1,   /* Delaunay via the in-tree engine (dt2d.c) */
+    NEIGHBOR_ENGINE_SANN     = 2,   /* SANN on a cell list (cellnbr.c) */
+    NEIGHBOR_ENGINE_KNN      = 3    /* fixed-k nearest neighbors on a cell list (cellnbr.c) */
+} NeighborEngine;
+
+typedef struct {
+    NeighborEngine engine;
+    int knn_k;                      /* neighbors per point for NEIGHBOR_ENGINE_KNN */
+} NeighborParams;
+
 /*
  * triangulate_get_neighbors
  *
@@ -13,19 +26,65 @@
  * boundaries are found. The function returns an array of IntArray of length M:
  *   neighbors[i] contains the unique neighbor indices (in [0..M-1]) of point i.
  *
- * On success: returns pointer to malloc'd IntArray array (length M). Caller must call
+ * On success: returns pointer to mem_malloc'd IntArray array (length M). Caller must call
  *    neighbors_free(neighbors, M);
  * On failure: returns NULL.
  *
  * Note: this function uses Triangle (triangulate). It will free Triangle-allocated
- * memory via trifree() and free() for memory it allocates.
+ * memory via trifree() and mem_free() for memory it allocates.
  */
 IntArray *triangulate_get_neighbors(const Vec2Array *points,
                                     bool use_pbc,
                                     double box_x, double box_y,
                                     int *out_M);
 
+/*
+ * triangulate_get_neighbors_engine
+ *
+ * Same as triangulate_get_neighbors, with an explicit choice of Delaunay backend
+ * (NEIGHBOR_ENGINE_TRIANGLE or NEIGHBOR_ENGINE_DT2D).
+ * triangulate_get_neighbors uses NEIGHBOR_ENGINE_TRIANGLE.
+ */
+IntArray *triangulate_get_neighbors_engine(const Vec2Array *points,
+                                           bool use_pbc,
+                                           double box_x, double box_y,
+                                           NeighborEngine engine,
+                                           int *out_M);
+
+/*
+ * compute_neighbors
+ *
+ * Neighbor lists from any backend in NeighborParams, same output contract as
+ * triangulate_get_neighbors (release with neighbors_free). SANN and kNN lists
+ * are not necessarily symmetric.
+ */
+IntArray *compute_neighbors(const Vec2Array *points,
+                            bool use_pbc,
+                            double box_x, double box_y,
+                            const NeighborParams *par,
+                            int *out_M);
+
+/* Parse "triangle" / "dt2d" / "sann" / "knn" into *engine. Returns 0 on success. */
+int neighbor_engine_parse(const char *name, NeighborEngine *engine);
+const char *neighbor_engine_name(NeighborEngine engine);
+
 /* Free neighbors array returned by triangulate_get_neighbors */
 void neighbors_free(IntArray *neighbors, int M);
 
+/*
+ * neighbors_compare
+ *
+ * Edge-for-edge comparison of two neighbor lists over the same M points
+ * (e.g. a candidate engine against the Triangle reference).
+ * Counts are over directed entries (i -> j), so an undirected edge counts twice.
+ */
+typedef struct {
+    long ref_entries;       /* entries in ref */
+    long test_entries;      /* entries in test */
+    long common_entries;    /* entries present in both */
+    int  points_identical;  /* points whose neighbor sets are equal */
+} NeighborCompare;
+
+void neighbors_compare(const IntArray *ref, const IntArray *test, int M, NeighborCompare *out);
+
 #endif /* DELAUNAY_H */
@@ -0,0 +1,618 @@
+/*
+ * dt2d.c
+ *
+ * Neighbor-only 2D Delaunay triangulation (see dt2d.h).
+ *
+ * Data structure: array of triangles, each with three vertex ids (ccw) and
+ * three neighbor triangle ids (n[k] across the edge opposite v[k]).  Hull
+ * edges are closed by ghost triangles (a, b, DT_INF); a ghost "circumcircle"
+ * is the open half-plane left of a->b, i.e. outside the hull.
+ *
+ * Predicates follow Shewchuk's construction: a cheap floating-point estimate
+ * with a forward error bound, and an exact expansion evaluation when the
+ * estimate cannot certify the sign.  The constants are fixed for IEEE-754
+ * double precision, so nothing is initialized at runtime.
+ */
+
+#include "dt2d.h"
+#include "memacct.h"
+#include "utils.h"       /* hilbert_order */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define DT_INF (-1)
+
+/* ---------------------------------------------------------------------------
+ * Robust predicates
+ * ------------------------------------------------------------------------- */
+
+#define DT_SPLITTER 134217729.0               /* 2^27 + 1 */
+#define DT_EPS      1.1102230246251565e-16    /* 2^-53    */
+
+static const double ccwerrboundA = (3.0 + 16.0 * DT_EPS) * DT_EPS;
+static const double iccerrboundA = (10.0 + 96.0 * DT_EPS) * DT_EPS;
+
+static inline void fast_two_sum(double a, double b, double *x, double *y){
+    double s = a + b;
+    *x = s;
+    *y = b - (s - a);
+}
+
+static inline void two_sum(double a, double b, double *x, double *y){
+    double s = a + b;
+    double bv = s - a;
+    double av = s - bv;
+    *x = s;
+    *y = (a - av) + (b - bv);
+}
+
+static inline void two_diff(double a, double b, double *x, double *y){
+    double s = a - b;
+    double bv = a - s;
+    double av = s + bv;
+    *x = s;
+    *y = (a - av) + (bv - b);
+}
+
+static inline void split(double a, double *hi, double *lo){
+    double c = DT_SPLITTER * a;
+    double abig = c - a;
+    *hi = c - abig;
+    *lo = a - *hi;
+}
+
+static inline void two_product_presplit(double a, double b, double bhi, double blo,
+                                        double *x, double *y){
+    double ahi, alo;
+    double p = a * b;
+    split(a, &ahi, &alo);
+    double err1 = p - (ahi * bhi);
+    double err2 = err1 - (alo * bhi);
+    double err3 = err2 - (ahi * blo);
+    *x = p;
+    *y = (alo * blo) - err3;
+}
+
+/* h = e + f (nonoverlapping expansions, increasing magnitude, zeros removed) */
+static int expansion_sum(int elen, const double *e, int flen, const double *f, double *h){
+    double Q, Qnew, hh, enow = e[0], fnow = f[0];
+    int ei = 0, fi = 0, hi = 0;
+
+    if((fnow > enow) == (fnow > -enow)){ Q = enow; enow = (++ei < elen) ? e[ei] : 0.0; }
+    else                               { Q = fnow; fnow = (++fi < flen) ? f[fi] : 0.0; }
+
+    if(ei < elen && fi < flen){
+        if((fnow > enow) == (fnow > -enow)){ fast_two_sum(enow, Q, &Qnew, &hh); enow = (++ei < elen) ? e[ei] : 0.0; }
+        else                               { fast_two_sum(fnow, Q, &Qnew, &hh); fnow = (++fi < flen) ? f[fi] : 0.0; }
+        Q = Qnew;
+        if(hh != 0.0) h[hi++] = hh;
+        while(ei < elen && fi < flen){
+            if((fnow > enow) == (fnow > -enow)){ two_sum(Q, enow, &Qnew, &hh); enow = (++ei < elen) ? e[ei] : 0.0; }
+            else                               { two_sum(Q, fnow, &Qnew, &hh); fnow = (++fi < flen) ? f[fi] : 0.0; }
+            Q = Qnew;
+            if(hh != 0.0) h[hi++] = hh;
+        }
+    }
+    while(ei < elen){
+        two_sum(Q, enow, &Qnew, &hh);
+        enow = (++ei < elen) ? e[ei] : 0.0;
+        Q = Qnew;
+        if(hh != 0.0) h[hi++] = hh;
+    }
+    while(fi < flen){
+        two_sum(Q, fnow, &Qnew, &hh);
+        fnow = (++fi < flen) ? f[fi] : 0.0;
+        Q = Qnew;
+        if(hh != 0.0) h[hi++] = hh;
+    }
+    if(Q != 0.0 || hi == 0) h[hi++] = Q;
+    return hi;
+}
+
+/* h = b * e */
+static int expansion_scale(int elen, const double *e, double b, double *h){
+    double bhi, blo, Q, sum, hh, p1, p0;
+    int hi = 0;
+    split(b, &bhi, &blo);
+    two_product_presplit(e[0], b, bhi, blo, &Q, &hh);
+    if(hh != 0.0) h[hi++] = hh;
+    for(int i = 1; i < elen; i++){
+        two_product_presplit(e[i], b, bhi, blo, &p1, &p0);
+        two_sum(Q, p0, &sum, &hh);
+        if(hh != 0.0) h[hi++] = hh;
+        fast_two_sum(p1, sum, &Q, &hh);
+        if(hh != 0.0) h[hi++] = hh;
+    }
+    if(Q != 0.0 || hi == 0) h[hi++] = Q;
+    return hi;
+}
+
+/* h = e * f; needs elen <= 16 and 2*elen*flen <= 512 (enough for incircle) */
+static int expansion_product(int elen, const double *e, int flen, const double *f, double *h){
+    double t[32], acc[512];
+    int hlen = 1;
+    h[0] = 0.0;
+    for(int i = 0; i < flen; i++){
+        int tlen = expansion_scale(elen, e, f[i], t);
+        int alen = expansion_sum(hlen, h, tlen, t, acc);
+        memcpy(h, acc, (size_t)alen * sizeof(double));
+        hlen = alen;
+    }
+    return hlen;
+}
+
+static inline int expansion_diff2(double a, double b, double *h){
+    two_diff(a, b, &h[1], &h[0]);
+    return 2;
+}
+
+static void expansion_negate(int n, double *e){
+    for(int i = 0; i < n; i++) e[i] = -e[i];
+}
+
+static double orient2d_exact(const double *a, const double *b, const double *c){
+    double acx[2], acy[2], bcx[2], bcy[2];
+    double l[8], r[8], det[16];
+    expansion_diff2(a[0], c[0], acx);
+    expansion_diff2(a[1], c[1], acy);
+    expansion_diff2(b[0], c[0], bcx);
+    expansion_diff2(b[1], c[1], bcy);
+    int ll = expansion_product(2, acx, 2, bcy, l);
+    int rl = expansion_product(2, acy, 2, bcx, r);
+    expansion_negate(rl, r);
+    int dl = expansion_sum(ll, l, rl, r, det);
+    return det[dl - 1];
+}
+
+/* > 0 if a, b, c are counter-clockwise, < 0 if clockwise, 0 if collinear */
+static double orient2d(const double *a, const double *b, const double *c){
+    double detleft  = (a[0] - c[0]) * (b[1] - c[1]);
+    double detright = (a[1] - c[1]) * (b[0] - c[0]);
+    double det = detleft - detright;
+    double detsum;
+
+    if(detleft > 0.0){
+        if(detright <= 0.0) return det;
+        detsum = detleft + detright;
+    } else if(detleft < 0.0){
+        if(detright >= 0.0) return det;
+        detsum = -detleft - detright;
+    } else {
+        return det;
+    }
+    double errbound = ccwerrboundA * detsum;
+    if(det >= errbound || -det >= errbound) return det;
+    return orient2d_exact(a, b, c);
+}
+
+/* cross = x1*y2 - y1*x2 on 2-component expansions */
+static int expansion_cross(const double *x1, const double *y2, const double *y1, const double *x2, double *h){
+    double l[8], r[8];
+    int ll = expansion_product(2, x1, 2, y2, l);
+    int rl = expansion_product(2, y1, 2, x2, r);
+    expansion_negate(rl, r);
+    return expansion_sum(ll, l, rl, r, h);
+}
+
+static int expansion_lift(const double *x, const double *y, double *h){
+    double xx[8], yy[8];
+    int xl = expansion_product(2, x, 2, x, xx);
+    int yl = expansion_product(2, y, 2, y, yy);
+    return expansion_sum(xl, xx, yl, yy, h);
+}
+
+static double incircle_exact(const double *a, const double *b, const double *c, const double *d){
+    double adx[2], ady[2], bdx[2], bdy[2], cdx[2], cdy[2];
+    double alift[16], blift[16], clift[16], bc[16], ca[16], ab[16];
+    double ta[512], tb[512], tc[512], tab[1024], det[1536];
+
+    expansion_diff2(a[0], d[0], adx); expansion_diff2(a[1], d[1], ady);
+    expansion_diff2(b[0], d[0], bdx); expansion_diff2(b[1], d[1], bdy);
+    expansion_diff2(c[0], d[0], cdx); expansion_diff2(c[1], d[1], cdy);
+
+    int al = expansion_lift(adx, ady, alift);
+    int bl = expansion_lift(bdx, bdy, blift);
+    int cl = expansion_lift(cdx, cdy, clift);
+    int bcl = expansion_cross(bdx, cdy, bdy, cdx, bc);
+    int cal = expansion_cross(cdx, ady, cdy, adx, ca);
+    int abl = expansion_cross(adx, bdy, ady, bdx, ab);
+
+    int tal = expansion_product(al, alift, bcl, bc, ta);
+    int tbl = expansion_product(bl, blift, cal, ca, tb);
+    int tcl = expansion_product(cl, clift, abl, ab, tc);
+    int tabl = expansion_sum(tal, ta, tbl, tb, tab);
+    int dl = expansion_sum(tabl, tab, tcl, tc, det);
+    return det[dl - 1];
+}
+
+/* > 0 if d lies inside the circle through counter-clockwise a, b, c */
+static double incircle(const double *a, const double *b, const double *c, const double *d){
+    double adx = a[0] - d[0], ady = a[1] - d[1];
+    double bdx = b[0] - d[0], bdy = b[1] - d[1];
+    double cdx = c[0] - d[0], cdy = c[1] - d[1];
+
+    double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady, adxcdy = adx * cdy;
+    double adxbdy = adx * bdy, bdxady = bdx * ady;
+    double alift = adx * adx + ady * ady;
+    double blift = bdx * bdx + bdy * bdy;
+    double clift = cdx * cdx + cdy * cdy;
+
+    double det = alift * (bdxcdy - cdxbdy)
+               + blift * (cdxady - adxcdy)
+               + clift * (adxbdy - bdxady);
+    double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift
+                     + (fabs(cdxady) + fabs(adxcdy)) * blift
+                     + (fabs(adxbdy) + fabs(bdxady)) * clift;
+    double errbound = iccerrboundA * permanent;
+    if(det > errbound || -det > errbound) return det;
+    return incircle_exact(a, b, c, d);
+}
+
+/* ---------------------------------------------------------------------------
+ * Triangulation
+ * ------------------------------------------------------------------------- */
+
+typedef struct {
+    int v[3];   /* vertex ids, counter-clockwise; DT_INF = vertex at infinity */
+    int n[3];   /* n[k] is the triangle across the edge opposite v[k] */
+} DTri;
+
+typedef struct {
+    int u, w;       /* cavity boundary edge u->w (counter-clockwise seen from the new point) */
+    int outside;    /* triangle across the edge, not in the cavity */
+} DTEdge;
+
+typedef struct {
+    const double *xy;
+    int     n;
+
+    DTri   *tri;
+    int    *mark;       /* cavity stamp per triangle */
+    int     ntri, cap;
+    int     stamp;
+    int     last;       /* recently created triangle, start of the next walk */
+    unsigned rng;
+
+    /* per-insertion scratch */
+    int    *cavity;  int cav_n, cav_cap;
+    DTEdge *bnd;     int bnd_n, bnd_cap;
+    int    *start_at;   /* new triangle whose boundary edge starts at vertex (n+1 slots) */
+    int    *end_at;     /* new triangle whose boundary edge ends at vertex   (n+1 slots) */
+} DT;
+
+#define DT_PT(d, i) (&(d)->xy[2 * (size_t)(i)])
+#define DT_VID(d, v) ((v) == DT_INF ? (d)->n : (v))
+
+static inline int tri_ghost_slot(const DTri *t){
+    if(t->v[0] == DT_INF) return 0;
+    if(t->v[1] == DT_INF) return 1;
+    if(t->v[2] == DT_INF) return 2;
+    return -1;
+}
+
+static int dt_reserve_tri(DT *d, int need){
+    if(need <= d->cap) return 0;
+    int newcap = d->cap ? d->cap : 64;
+    while(newcap < need) newcap *= 2;
+    DTri *nt = (DTri*)mem_realloc(d->tri, (size_t)newcap * sizeof(DTri));
+    if(!nt) return -1;
+    d->tri = nt;
+    int *nm = (int*)mem_realloc(d->mark, (size_t)newcap * sizeof(int));
+    if(!nm) return -1;
+    for(int i = d->cap; i < newcap; i++) nm[i] = 0;
+    d->mark = nm;
+    d->cap = newcap;
+    return 0;
+}
+
+static int dt_push_cavity(DT *d, int t){
+    if(d->cav_n == d->cav_cap){
+        int nc = d->cav_cap ? d->cav_cap * 2 : 64;
+        int *tmp = (int*)mem_realloc(d->cavity, (size_t)nc * sizeof(int));
+        if(!tmp) return -1;
+        d->cavity = tmp;
+        d->cav_cap = nc;
+    }
+    d->cavity[d->cav_n++] = t;
+    return 0;
+}
+
+static int dt_push_boundary(DT *d, int u, int w, int outside){
+    if(d->bnd_n == d->bnd_cap){
+        int nc = d->bnd_cap ? d->bnd_cap * 2 : 64;
+        DTEdge *tmp = (DTEdge*)mem_realloc(d->bnd, (size_t)nc * sizeof(DTEdge));
+        if(!tmp) return -1;
+        d->bnd = tmp;
+        d->bnd_cap = nc;
+    }
+    d->bnd[d->bnd_n].u = u;
+    d->bnd[d->bnd_n].w = w;
+    d->bnd[d->bnd_n].outside = outside;
+    d->bnd_n++;
+    return 0;
+}
+
+/* p on the open segment ab, given that a, b, p are collinear (exact test) */
+static int strictly_between(const double *a, const double *b, const double *p){
+    if(a[0] != b[0]){
+        return (a[0] < p[0] && p[0] < b[0]) || (b[0] < p[0] && p[0] < a[0]);
+    }
+    return (a[1] < p[1] && p[1] < b[1]) || (b[1] < p[1] && p[1] < a[1]);
+}
+
+/* Does p lie strictly inside the circumcircle (half-plane for ghosts) of t? */
+static int dt_conflict(const DT *d, int t, const double *p){
+    const DTri *T = &d->tri[t];
+    int g = tri_ghost_slot(T);
+    if(g < 0){
+        return incircle(DT_PT(d, T->v[0]), DT_PT(d, T->v[1]), DT_PT(d, T->v[2]), p) > 0.0;
+    }
+    const double *a = DT_PT(d, T->v[(g + 1) % 3]);
+    const double *b = DT_PT(d, T->v[(g + 2) % 3]);
+    double o = orient2d(a, b, p);
+    if(o > 0.0) return 1;
+    if(o < 0.0) return 0;
+    return strictly_between(a, b, p);
+}
+
+/* Visibility walk to a triangle in conflict with p. Sets *dup if p is an existing vertex. */
+static int dt_locate(DT *d, const double *p, int *dup){
+    int t = d->last;
+    int g = tri_ghost_slot(&d->tri[t]);
+    if(g >= 0) t = d->tri[t].n[g];
+
+    *dup = 0;
+    for(;;){
+        const DTri *T = &d->tri[t];
+        if(tri_ghost_slot(T) >= 0) return t;   /* crossed a hull edge: p is outside */
+
+        d->rng = d->rng * 1103515245u + 12345u;
+        int k0 = (int)((d->rng >> 16) % 3u);
+        int moved = 0;
+        for(int s = 0; s < 3; s++){
+            int k = (k0 + s) % 3;
+            const double *a = DT_PT(d, T->v[(k + 1) % 3]);
+            const double *b = DT_PT(d, T->v[(k + 2) % 3]);
+            if(orient2d(a, b, p) < 0.0){
+                t = T->n[k];
+                moved = 1;
+                break;
+            }
+        }
+        if(!moved){
+            for(int k = 0; k < 3; k++){
+                const double *q = DT_PT(d, T->v[k]);
+                if(q[0] == p[0] && q[1] == p[1]){ *dup = 1; break; }
+            }
+            return t;
+        }
+    }
+}
+
+/* Insert vertex pi. Returns 0 on success (or duplicate skipped), -1 on OOM. */
+static int dt_insert(DT *d, int pi){
+    const double *p = DT_PT(d, pi);
+    int dup;
+    int t0 = dt_locate(d, p, &dup);
+    if(dup) return 0;
+
+    /* grow the cavity of conflicting triangles from t0 */
+    d->stamp++;
+    d->cav_n = 0;
+    d->bnd_n = 0;
+    if(dt_push_cavity(d, t0) != 0) return -1;
+    d->mark[t0] = d->stamp;
+    for(int i = 0; i < d->cav_n; i++){
+        int c = d->cavity[i];
+        for(int k = 0; k < 3; k++){
+            int nb = d->tri[c].n[k];
+            if(d->mark[nb] == d->stamp) continue;
+            if(dt_conflict(d, nb, p)){
+                d->mark[nb] = d->stamp;
+                if(dt_push_cavity(d, nb) != 0) return -1;
+            } else {
+                if(dt_push_boundary(d, d->tri[c].v[(k + 1) % 3], d->tri[c].v[(k + 2) % 3], nb) != 0) return -1;
+            }
+        }
+    }
+
+    /* star the cavity boundary from p; reuse the cavity slots first */
+    if(dt_reserve_tri(d, d->ntri + d->bnd_n - d->cav_n) != 0) return -1;
+    for(int e = 0; e < d->bnd_n; e++){
+        const DTEdge *E = &d->bnd[e];
+        int nt = (e < d->cav_n) ? d->cavity[e] : d->ntri++;
+        DTri *T = &d->tri[nt];
+        T->v[0] = pi; T->v[1] = E->u; T->v[2] = E->w;
+        T->n[0] = E->outside;
+        d->mark[nt] = 0;
+
+        DTri *O = &d->tri[E->outside];
+        for(int j = 0; j < 3; j++){
+            if(O->v[(j + 1) % 3] == E->w && O->v[(j + 2) % 3] == E->u){ O->n[j] = nt; break; }
+        }
+        d->start_at[DT_VID(d, E->u)] = nt;
+        d->end_at[DT_VID(d, E->w)]   = nt;
+    }
+    for(int e = 0; e < d->bnd_n; e++){
+        int nt = (e < d->cav_n) ? d->cavity[e] : d->ntri - d->bnd_n + e;
+        DTri *T = &d->tri[nt];
+        T->n[1] = d->start_at[DT_VID(d, T->v[2])];
+        T->n[2] = d->end_at[DT_VID(d, T->v[1])];
+        if(tri_ghost_slot(T) < 0) d->last = nt;
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Public API
+ * ------------------------------------------------------------------------- */
+
+typedef struct { double x, y; int idx; } DTPoint;
+
+static int cmp_point_lex(const void *a, const void *b){
+    const DTPoint *pa = (const DTPoint*)a, *pb = (const DTPoint*)b;
+    if(pa->x != pb->x) return pa->x < pb->x ? -1 : 1;
+    if(pa->y != pb->y) return pa->y < pb->y ? -1 : 1;
+    return (pa->idx > pb->idx) - (pa->idx < pb->idx);
+}
+
+/* All points collinear: the Delaunay graph is the path through the sorted distinct points. */
+static int collinear_edges(const double *xy, int n, int **out_edges, int *out_nedges){
+    DTPoint *pts = (DTPoint*)mem_malloc((size_t)n * sizeof(DTPoint));
+    int *edges = (int*)mem_malloc((size_t)(n > 1 ? n - 1 : 1) * 2 * sizeof(int));
+    if(!pts || !edges){ mem_free(pts); mem_free(edges); return -1; }
+    for(int i = 0; i < n; i++){ pts[i].x = xy[2*i]; pts[i].y = xy[2*i + 1]; pts[i].idx = i; }
+    qsort(pts, (size_t)n, sizeof(DTPoint), cmp_point_lex);
+
+    int ne = 0, prev = 0;
+    for(int i = 1; i < n; i++){
+        if(pts[i].x == pts[prev].x && pts[i].y == pts[prev].y) continue;  /* duplicate */
+        edges[2*ne + 0] = pts[prev].idx;
+        edges[2*ne + 1] = pts[i].idx;
+        ne++;
+        prev = i;
+    }
+    mem_free(pts);
+    *out_edges = edges;
+    *out_nedges = ne;
+    return 0;
+}
+
+static void dt_free(DT *d){
+    mem_free(d->tri);
+    mem_free(d->mark);
+    mem_free(d->cavity);
+    mem_free(d->bnd);
+    mem_free(d->start_at);
+    mem_free(d->end_at);
+}
+
+/* First triangle (a, b, c) plus its three ghosts, linked by matching edges. */
+static void dt_seed(DT *d, int a, int b, int c){
+    int gv[4][3] = {{a, b, c}, {c, b, DT_INF}, {a, c, DT_INF}, {b, a, DT_INF}};
+    for(int t = 0; t < 4; t++){
+        for(int k = 0; k < 3; k++){ d->tri[t].v[k] = gv[t][k]; d->tri[t].n[k] = -1; }
+    }
+    for(int t = 0; t < 4; t++){
+        for(int k = 0; k < 3; k++){
+            int u = d->tri[t].v[(k + 1) % 3], w = d->tri[t].v[(k + 2) % 3];
+            for(int s = 0; s < 4 && d->tri[t].n[k] < 0; s++){
+                if(s == t) continue;
+                for(int j = 0; j < 3; j++){
+                    if(d->tri[s].v[(j + 1) % 3] == w && d->tri[s].v[(j + 2) % 3] == u){
+                        d->tri[t].n[k] = s;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    d->ntri = 4;
+    d->last = 0;
+}
+
+int dt2d_edges(const double *xy, int n, int **out_edges, int *out_nedges){
+    if(!xy || n < 0 || !out_edges || !out_nedges){
+        fprintf(stderr, "dt2d_edges: invalid arguments\n");
+        return 1;
+    }
+    *out_edges = NULL;
+    *out_nedges = 0;
+    if(n < 2){
+        *out_edges = (int*)mem_malloc(2 * sizeof(int));
+        return *out_edges ? 0 : 2;
+    }
+
+    int *ord = hilbert_order(xy, n);
+    if(!ord){ fprintf(stderr, "dt2d_edges: OOM\n"); return 2; }
+
+    /* seed: first point, first distinct point, first non-collinear point */
+    int ia = 0, ib = -1, ic = -1;
+    const double *pa = &xy[2 * (size_t)ord[0]];
+    for(int i = 1; i < n; i++){
+        const double *q = &xy[2 * (size_t)ord[i]];
+        if(q[0] != pa[0] || q[1] != pa[1]){ ib = i; break; }
+    }
+    if(ib > 0){
+        const double *pb = &xy[2 * (size_t)ord[ib]];
+        for(int i = ib + 1; i < n; i++){
+            if(orient2d(pa, pb, &xy[2 * (size_t)ord[i]]) != 0.0){ ic = i; break; }
+        }
+    }
+    if(ic < 0){
+        mem_free(ord);
+        int rc = collinear_edges(xy, n, out_edges, out_nedges);
+        if(rc != 0) fprintf(stderr, "dt2d_edges: OOM\n");
+        return rc ? 2 : 0;
+    }
+
+    DT d;
+    memset(&d, 0, sizeof(d));
+    d.xy = xy;
+    d.n = n;
+    d.rng = 12345u;
+    d.start_at = (int*)mem_malloc((size_t)(n + 1) * sizeof(int));
+    d.end_at   = (int*)mem_malloc((size_t)(n + 1) * sizeof(int));
+    if(!d.start_at || !d.end_at || dt_reserve_tri(&d, 2 * n + 8) != 0){
+        fprintf(stderr, "dt2d_edges: OOM\n");
+        dt_free(&d);
+        mem_free(ord);
+        return 2;
+    }
+
+    int va = ord[ia], vb = ord[ib], vc = ord[ic];
+    if(orient2d(&xy[2*(size_t)va], &xy[2*(size_t)vb], &xy[2*(size_t)vc]) < 0.0){
+        int tmp = vb; vb = vc; vc = tmp;
+    }
+    dt_seed(&d, va, vb, vc);
+
+    for(int i = 0; i < n; i++){
+        if(i == ia || i == ib || i == ic) continue;
+        if(dt_insert(&d, ord[i]) != 0){
+            fprintf(stderr, "dt2d_edges: OOM\n");
+            dt_free(&d);
+            mem_free(ord);
+            return 2;
+        }
+    }
+    mem_free(ord);
+
+    /* each finite edge is shared by two triangles; emit it once */
+    int ne = 0;
+    for(int t = 0; t < d.ntri; t++){
+        const DTri *T = &d.tri[t];
+        if(tri_ghost_slot(T) >= 0) continue;
+        for(int k = 0; k < 3; k++){
+            int nb = T->n[k];
+            if(tri_ghost_slot(&d.tri[nb]) >= 0 || t < nb) ne++;
+        }
+    }
+    int *edges = (int*)mem_malloc((size_t)(ne > 0 ? ne : 1) * 2 * sizeof(int));
+    if(!edges){
+        fprintf(stderr, "dt2d_edges: OOM\n");
+        dt_free(&d);
+        return 2;
+    }
+    int e = 0;
+    for(int t = 0; t < d.ntri; t++){
+        const DTri *T = &d.tri[t];
+        if(tri_ghost_slot(T) >= 0) continue;
+        for(int k = 0; k < 3; k++){
+            int nb = T->n[k];
+            if(tri_ghost_slot(&d.tri[nb]) >= 0 || t < nb){
+                edges[2*e + 0] = T->v[(k + 1) % 3];
+                edges[2*e + 1] = T->v[(k + 2) % 3];
+                e++;
+            }
+        }
+    }
+    dt_free(&d);
+
+    *out_edges = edges;
+    *out_nedges = ne;
+    return 0;
+}
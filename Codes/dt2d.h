@@ -0,0 +1,42 @@
+#ifndef DT2D_H
+#define DT2D_H
+
+/*
+ * dt2d
+ *
+ * Compact 2D Delaunay engine used as an alternative to Triangle when only the
+ * Delaunay edge set is needed (the neighbor step of the pipeline).
+ *
+ *   - points are inserted incrementally in Hilbert-curve order (Bowyer-Watson
+ *     cavity retriangulation, walking point location from the last insertion);
+ *   - the convex hull is closed with "ghost" triangles sharing a vertex at
+ *     infinity, so hull edges come out exact without a bounding super-triangle;
+ *   - orientation / incircle tests use a floating-point filter with an exact
+ *     expansion-arithmetic fallback, so the result is the exact Delaunay
+ *     triangulation of the input coordinates (up to cocircular ties).
+ *
+ * Duplicate points are ignored (they get no edges), matching Triangle.
+ */
+
+/*
+ * dt2d_edges
+ *
+ * Inputs:
+ *   - xy: interleaved coordinates x0 y0 x1 y1 ... (length 2*n)
+ *   - n:  number of points
+ *
+ * Outputs:
+ *   - *out_edges: mem_malloc'd int array of length 2 * (*out_nedges), each edge
+ *                 (u, v) with u != v appears exactly once.
+ *
+ * Returns:
+ *   - 0 on success, non-zero on error (invalid args / OOM).
+ *
+ * Ownership:
+ *   - Caller must mem_free() *out_edges.
+ *
+ * The function keeps no global state and may be called from several threads.
+ */
+int dt2d_edges(const double *xy, int n, int **out_edges, int *out_nedges);
+
+#endif /* DT2D_H */
@@ -0,0 +1,296 @@
+/*
+ * framecache.c
+ *
+ * One file per snapshot, <dir>/<key as 16 hex digits>.bin:
+ *
+ *   header   FCHeader (magic, byte-order mark, key, M, nnz, nclusters, checksum)
+ *   payload  M Vec2 COMs, M+1 int32 CSR offsets, nnz int32 neighbor indices,
+ *            M Complex psi6
+ *
+ * in native byte order (the byte-order mark rejects files from another
+ * machine). The checksum is FNV-1a over the payload, then nclusters.
+ */
+
+#define _GNU_SOURCE   /* utimensat, DT_* */
+
+#include "framecache.h"
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FC_MAGIC "HXCACHE2"
+#define FC_BOM   0x0102030405060708ULL
+
+typedef struct {
+    char     magic[8];
+    uint64_t bom;
+    uint64_t key;
+    int64_t  M, nnz, nclusters;
+    uint64_t checksum;
+} FCHeader;
+
+struct FrameCache {
+    char   *dir;
+    int64_t max_bytes;
+    pthread_mutex_t lock;
+    long    hits, misses, rejected;
+};
+
+uint64_t fnv1a64(uint64_t h, const void *data, size_t len){
+    const unsigned char *p = (const unsigned char*)data;
+    for(size_t i=0;i<len;i++){
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+FrameCache *framecache_open(const char *dir, int64_t max_bytes){
+    DIR *d = opendir(dir);
+    if(!d){
+        fprintf(stderr,"framecache_open: cannot open directory %s\n", dir);
+        return NULL;
+    }
+    closedir(d);
+    FrameCache *C = (FrameCache*)calloc(1, sizeof(FrameCache));
+    if(!C || !(C->dir = strdup(dir))){
+        fprintf(stderr,"framecache_open: OOM\n");
+        free(C);
+        return NULL;
+    }
+    C->max_bytes = max_bytes;
+    pthread_mutex_init(&C->lock, NULL);
+    return C;
+}
+
+void framecache_close(FrameCache *C){
+    if(!C) return;
+    framecache_trim(C);
+    pthread_mutex_destroy(&C->lock);
+    free(C->dir);
+    free(C);
+}
+
+static void fc_path(const FrameCache *C, uint64_t key, char *buf, size_t len){
+    snprintf(buf, len, "%s/%016llx.bin", C->dir, (unsigned long long)key);
+}
+
+static void fc_count(FrameCache *C, long *counter){
+    pthread_mutex_lock(&C->lock);
+    (*counter)++;
+    pthread_mutex_unlock(&C->lock);
+}
+
+/* fread n bytes into dst and fold them into the checksum */
+static int fc_read(FILE *f, void *dst, size_t n, uint64_t *h){
+    if(n > 0 && fread(dst, 1, n, f) != n) return 1;
+    *h = fnv1a64(*h, dst, n);
+    return 0;
+}
+
+int framecache_load(FrameCache *C, uint64_t key, Vec2Array *coms, Complex **psi6,
+                    IntArray **neighbors, int *nclusters){
+    char path[4096];
+    fc_path(C, key, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if(!f){
+        fc_count(C, &C->misses);
+        return 1;
+    }
+
+    FCHeader hd;
+    struct stat st;
+    int ok = fread(&hd, sizeof(hd), 1, f) == 1 && fstat(fileno(f), &st) == 0 &&
+             memcmp(hd.magic, FC_MAGIC, 8) == 0 && hd.bom == FC_BOM && hd.key == key &&
+             hd.M >= 0 && hd.M < INT32_MAX && hd.nnz >= 0 && hd.nnz < INT32_MAX;
+    if(ok){
+        const int64_t want = (int64_t)sizeof(hd) + hd.M * (int64_t)(sizeof(Vec2) + sizeof(Complex)) +
+                             (hd.M + 1 + hd.nnz) * (int64_t)sizeof(int32_t);
+        ok = (int64_t)st.st_size == want;
+    }
+
+    const size_t M = ok ? (size_t)hd.M : 0, nnz = ok ? (size_t)hd.nnz : 0;
+    Vec2 *c = NULL;
+    Complex *p = NULL;
+    int32_t *off = NULL, *idx = NULL;
+    if(ok){
+        c = (Vec2*)mem_malloc((M > 0 ? M : 1) * sizeof(Vec2));
+        p = (Complex*)mem_malloc((M > 0 ? M : 1) * sizeof(Complex));
+        off = (int32_t*)mem_malloc((M + 1) * sizeof(int32_t));
+        idx = (int32_t*)mem_malloc((nnz > 0 ? nnz : 1) * sizeof(int32_t));
+        if(!c || !p || !off || !idx){
+            fprintf(stderr,"framecache_load: OOM\n");
+            ok = 0;
+        }
+    }
+    uint64_t h = FNV1A64_INIT;
+    if(ok) ok = fc_read(f, c, M * sizeof(Vec2), &h) == 0 &&
+                fc_read(f, off, (M + 1) * sizeof(int32_t), &h) == 0 &&
+                fc_read(f, idx, nnz * sizeof(int32_t), &h) == 0 &&
+                fc_read(f, p, M * sizeof(Complex), &h) == 0 &&
+                fnv1a64(h, &hd.nclusters, sizeof(hd.nclusters)) == hd.checksum;
+    fclose(f);
+    if(ok){
+        /* CSR must be monotone and in range before anything indexes with it */
+        ok = off[0] == 0 && (size_t)off[M] == nnz;
+        for(size_t i=0;ok && i<M;i++) ok = off[i] <= off[i+1];
+        for(size_t k=0;ok && k<nnz;k++) ok = idx[k] >= 0 && (size_t)idx[k] < M;
+    }
+
+    IntArray *nb = NULL;
+    if(ok && neighbors){
+        nb = (IntArray*)mem_malloc((M > 0 ? M : 1) * sizeof(IntArray));
+        if(!nb) ok = 0;
+        for(size_t i=0;ok && i<M;i++){
+            const size_t deg = (size_t)(off[i+1] - off[i]);
+            ia_init(&nb[i]);
+            if(deg == 0) continue;
+            nb[i].data = (int*)mem_malloc(deg * sizeof(int));
+            if(!nb[i].data){
+                for(size_t q=0;q<i;q++) ia_free(&nb[q]);
+                mem_free(nb);
+                nb = NULL;
+                ok = 0;
+                break;
+            }
+            memcpy(nb[i].data, idx + off[i], deg * sizeof(int));
+            nb[i].n = nb[i].cap = deg;
+        }
+    }
+    mem_free(off);
+    mem_free(idx);
+    if(!ok){
+        mem_free(c);
+        mem_free(p);
+        remove(path);
+        fc_count(C, &C->rejected);
+        return 1;
+    }
+
+    coms->data = c;
+    coms->n = coms->cap = M;
+    *psi6 = p;
+    if(neighbors) *neighbors = nb;
+    *nclusters = (int)hd.nclusters;
+    utimensat(AT_FDCWD, path, NULL, 0);    /* most recently used */
+    fc_count(C, &C->hits);
+    return 0;
+}
+
+int framecache_store(FrameCache *C, uint64_t key, const Vec2Array *coms,
+                     const IntArray *neighbors, const Complex *psi6, int nclusters){
+    const size_t M = coms->n;
+    int32_t *off = (int32_t*)mem_malloc((M + 1) * sizeof(int32_t));
+    if(!off){
+        fprintf(stderr,"framecache_store: OOM\n");
+        return 1;
+    }
+    off[0] = 0;
+    for(size_t i=0;i<M;i++) off[i+1] = off[i] + (int32_t)neighbors[i].n;
+    const size_t nnz = (size_t)off[M];
+
+    FCHeader hd;
+    memset(&hd, 0, sizeof(hd));
+    memcpy(hd.magic, FC_MAGIC, 8);
+    hd.bom = FC_BOM;
+    hd.key = key;
+    hd.M = (int64_t)M;
+    hd.nnz = (int64_t)nnz;
+    hd.nclusters = nclusters;
+    uint64_t h = fnv1a64(FNV1A64_INIT, coms->data, M * sizeof(Vec2));
+    h = fnv1a64(h, off, (M + 1) * sizeof(int32_t));
+    for(size_t i=0;i<M;i++) h = fnv1a64(h, neighbors[i].data, neighbors[i].n * sizeof(int));
+    h = fnv1a64(h, psi6, M * sizeof(Complex));
+    hd.checksum = fnv1a64(h, &hd.nclusters, sizeof(hd.nclusters));
+
+    char path[4096], tmp[4200];
+    fc_path(C, key, path, sizeof(path));
+    /* private name per process and thread; rename makes the entry appear whole */
+    snprintf(tmp, sizeof(tmp), "%s.%ld.%lx.tmp", path, (long)getpid(), (unsigned long)pthread_self());
+    FILE *f = fopen(tmp, "wb");
+    int rc = 1;
+    if(f){
+        int ok = fwrite(&hd, sizeof(hd), 1, f) == 1 &&
+                 fwrite(coms->data, sizeof(Vec2), M, f) == M &&
+                 fwrite(off, sizeof(int32_t), M + 1, f) == M + 1;
+        for(size_t i=0;ok && i<M;i++)
+            ok = fwrite(neighbors[i].data, sizeof(int), neighbors[i].n, f) == neighbors[i].n;
+        ok = ok && fwrite(psi6, sizeof(Complex), M, f) == M;
+        if(fclose(f) != 0) ok = 0;
+        if(ok && rename(tmp, path) == 0) rc = 0;
+        else remove(tmp);
+    }
+    if(rc != 0) fprintf(stderr,"framecache_store: cannot write %s\n", path);
+    mem_free(off);
+    return rc;
+}
+
+typedef struct {
+    char   *name;
+    off_t   size;
+    struct timespec mtime;
+} FCFile;
+
+static int fc_cmp_mtime(const void *a, const void *b){
+    const FCFile *x = (const FCFile*)a, *y = (const FCFile*)b;
+    if(x->mtime.tv_sec != y->mtime.tv_sec) return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    if(x->mtime.tv_nsec != y->mtime.tv_nsec) return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+int framecache_trim(FrameCache *C){
+    if(!C || C->max_bytes <= 0) return 0;
+    DIR *d = opendir(C->dir);
+    if(!d) return 0;
+    FCFile *v = NULL;
+    size_t n = 0, cap = 0;
+    int64_t total = 0;
+    char path[4096];
+    struct dirent *e;
+    while((e = readdir(d))){
+        size_t len = strlen(e->d_name);
+        if(len != 20 || strcmp(e->d_name + 16, ".bin") != 0) continue;
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", C->dir, e->d_name);
+        if(stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if(n == cap){
+            FCFile *nv = (FCFile*)realloc(v, (cap = cap ? 2 * cap : 64) * sizeof(FCFile));
+            if(!nv) break;
+            v = nv;
+        }
+        v[n].name = strdup(e->d_name);
+        if(!v[n].name) break;
+        v[n].size = st.st_size;
+        v[n].mtime = st.st_mtim;
+        total += st.st_size;
+        n++;
+    }
+    closedir(d);
+
+    qsort(v, n, sizeof(FCFile), fc_cmp_mtime);
+    int deleted = 0;
+    for(size_t k=0;k<n && total > C->max_bytes;k++){
+        snprintf(path, sizeof(path), "%s/%s", C->dir, v[k].name);
+        if(remove(path) == 0){
+            total -= v[k].size;
+            deleted++;
+        }
+    }
+    for(size_t k=0;k<n;k++) free(v[k].name);
+    free(v);
+    return deleted;
+}
+
+void framecache_stats(FrameCache *C, long *hits, long *misses, long *rejected){
+    pthread_mutex_lock(&C->lock);
+    *hits = C->hits;
+    *misses = C->misses;
+    *rejected = C->rejected;
+    pthread_mutex_unlock(&C->lock);
+}
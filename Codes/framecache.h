@@ -0,0 +1,61 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <stdint.h>
+#include "utils.h"
+#include "psi6.h"
+
+/*
+ * framecache
+ *
+ * On-disk cache of per-snapshot intermediate results (--cache-dir): the COMs,
+ * the neighbor lists in CSR form and psi6, stored in one binary file per
+ * snapshot named by a 64-bit key. The key is the caller's hash of the
+ * snapshot content and of every parameter the results depend on, so a rerun
+ * with the same data and clustering/neighbor settings (but, e.g., another dr)
+ * goes straight to the g6 stage.
+ *
+ * Each file carries its key, its sizes and an FNV-1a checksum of the payload;
+ * a file that does not match is removed and counted as rejected. Entries are
+ * written to a temporary name and renamed, so concurrent writers and
+ * interrupted runs never leave a partial entry. A hit refreshes the file's
+ * modification time, and framecache_trim deletes the least recently used
+ * entries until the directory fits the size limit.
+ */
+
+typedef struct FrameCache FrameCache;
+
+/* FNV-1a (64 bit) of len bytes, continuing from h (start with FNV1A64_INIT) */
+#define FNV1A64_INIT 0xcbf29ce484222325ULL
+uint64_t fnv1a64(uint64_t h, const void *data, size_t len);
+
+/* Open the cache in an existing directory; max_bytes <= 0 means no limit.
+   Returns NULL on failure. */
+FrameCache *framecache_open(const char *dir, int64_t max_bytes);
+
+/* Trim to the size limit and free the handle */
+void framecache_close(FrameCache *C);
+
+/*
+ * framecache_load
+ *
+ * Look up key. On a hit fills coms (initialized here), *psi6 (mem_free) and,
+ * if neighbors is not NULL, *neighbors (neighbors_free with M = coms->n), and
+ * *nclusters (clusters before any size filter). Returns 0 on a hit, 1 when the
+ * entry is missing or failed its checks (outputs untouched).
+ */
+int framecache_load(FrameCache *C, uint64_t key, Vec2Array *coms, Complex **psi6,
+                    IntArray **neighbors, int *nclusters);
+
+/* Store one snapshot's results under key. Returns 0 on success. */
+int framecache_store(FrameCache *C, uint64_t key, const Vec2Array *coms,
+                     const IntArray *neighbors, const Complex *psi6, int nclusters);
+
+/* Delete least recently used entries until the cache fits its limit.
+   Returns the number of entries deleted. */
+int framecache_trim(FrameCache *C);
+
+/* Lookups so far: hits, misses, and entries rejected by the checks */
+void framecache_stats(FrameCache *C, long *hits, long *misses, long *rejected);
+
+#endif /* FRAMECACHE_H */
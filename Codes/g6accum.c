@@ -3,6 +3,13 @@
  *
  * Accumulator for hexatic correlation g6(r).
  *
+ * Pairs are recorded in fine bins of width dr/subdiv; every dr boundary is
+ * also a fine boundary (a pair's dr-bin is decided exactly as floor(r/dr)),
+ * so writing with the default binning reproduces a plain dr histogram.
+ * g6accum_write rebins the fine sums to the requested output binning;
+ * g6accum_write_raw / g6accum_read_raw store them for later rebinning
+ * (see g6_rebin.c).
+ *
  * Usage:
  *   G6Accum *A = g6accum_create(dr);
  *   g6accum_accumulate(A, &coms, psi6, USE_PBC, BOX_X, BOX_Y);  // per snapshot
@@ -11,80 +18,561 @@
  */
 
 #include "g6accum.h"
+#include "celllist.h"
+#include "tpool.h"
+#include "trace.h"
+#include "memacct.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <stdint.h>
 
 
 
+/* Sums of one bin (rebinned output, MC scratch, raw file lines) */
 typedef struct {
-    double r_center;
     double re_sum;
     double im_sum;
-    long   pair_count;
+    double pair_count;   /* exact count, or estimated count from the MC estimator */
+    double ess;          /* MC effective samples (0 for exact snapshots) */
 } G6Bin;
 
 struct G6Accum {
-    G6Bin *bins;
-    int    nbins;
-    double dr;
+    /* fine bins, SoA: bin f covers [f, f+1) * dr / subdiv */
+    double *re_sum;
+    double *im_sum;
+    double *pair_count; /* exact count, or estimated count from the MC estimator */
+    double *ess;        /* MC effective samples (0 for exact snapshots) */
+    int    nbins;       /* number of fine bins (multiple of subdiv) */
+    double dr;          /* coarse bin width (g6accum_create) */
+    int    subdiv;      /* fine bins per dr */
+    double inv_fine;    /* subdiv / dr */
+    G6Binning out;      /* output binning for g6accum_write */
+    /* squared-distance lookup (rebuilt when bins grow, see g6_bin_r2) */
+    double *edge2;      /* nbins + 2: edge2[f] = smallest r^2 falling in fine bin >= f; last is +inf */
+    int    *lut;        /* nlut: first fine bin of each uniform r^2 cell */
+    int     nlut;
+    double  lut_inv_h;  /* nlut / edge2[nbins] */
+    char **notes;   /* extra header lines (g6accum_add_note) */
+    int    nnotes;
+    long   mc_calls;    /* snapshots through g6accum_accumulate_mc */
+    long   mc_samples;  /* total MC pair samples */
+    int    nchunks;     /* equal-work chunks of the all-pairs kernel (g6accum_set_chunks) */
+    size_t helper_peak; /* chunk bytes held on other threads by the last accumulate */
+    uint64_t helper_ctr[PERFCTR_N];   /* perfctr counts of those chunks */
 };
 
 /* Create accumulator */
 G6Accum *g6accum_create(double dr){
-    if(dr <= 0.0){
-        fprintf(stderr, "g6accum_create: dr must be > 0\n");
+    return g6accum_create_fine(dr, G6ACCUM_DEFAULT_SUBDIV);
+}
+
+G6Accum *g6accum_create_fine(double dr, int subdiv){
+    if(dr <= 0.0 || subdiv < 1){
+        fprintf(stderr, "g6accum_create: dr must be > 0 and subdiv >= 1\n");
         return NULL;
     }
-    G6Accum *A = (G6Accum*)malloc(sizeof(G6Accum));
+    G6Accum *A = (G6Accum*)mem_malloc(sizeof(G6Accum));
     if(!A){
         fprintf(stderr,"g6accum_create: OOM\n"); 
         return NULL; 
     }
-    A->bins = NULL;
+    A->re_sum = A->im_sum = A->pair_count = A->ess = NULL;
     A->nbins = 0;
     A->dr = dr;
+    A->subdiv = subdiv;
+    A->inv_fine = subdiv / dr;
+    A->out.log = 0;
+    A->out.dr = dr;
+    A->out.rmin = 0.0;
+    A->out.per_decade = 0;
+    A->edge2 = NULL;
+    A->lut = NULL;
+    A->nlut = 0;
+    A->lut_inv_h = 0.0;
+    A->notes = NULL;
+    A->nnotes = 0;
+    A->mc_calls = 0;
+    A->mc_samples = 0;
+    A->nchunks = G6ACCUM_DEFAULT_CHUNKS;
+    A->helper_peak = 0;
+    memset(A->helper_ctr, 0, sizeof(A->helper_ctr));
     return A;
 }
 
 /* Free accumulator */
 void g6accum_free(G6Accum *A){
     if(!A) return;
-    free(A->bins);
-    A->bins = NULL;
+    mem_free(A->re_sum);
+    mem_free(A->im_sum);
+    mem_free(A->pair_count);
+    mem_free(A->ess);
     A->nbins = 0;
-    free(A);
+    mem_free(A->edge2);
+    mem_free(A->lut);
+    for(int k=0;k<A->nnotes;k++) mem_free(A->notes[k]);
+    mem_free(A->notes);
+    mem_free(A);
+}
+
+/* Append one formatted header note */
+int g6accum_add_note(G6Accum *A, const char *fmt, ...){
+    if(!A || !fmt) return 1;
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if(len < 0) return 1;
+
+    char *line = (char*)mem_malloc((size_t)len + 1);
+    char **nn = (char**)mem_realloc(A->notes, (size_t)(A->nnotes + 1) * sizeof(char*));
+    if(!line || !nn){
+        fprintf(stderr,"g6accum_add_note: OOM\n");
+        mem_free(line);
+        if(nn) A->notes = nn;
+        return 2;
+    }
+    va_start(ap, fmt);
+    vsnprintf(line, (size_t)len + 1, fmt, ap);
+    va_end(ap);
+    A->notes = nn;
+    A->notes[A->nnotes++] = line;
+    return 0;
+}
+
+/* Fine bin of distance r inside coarse bin b = floor(r / dr) */
+static inline int g6_fine_index(const G6Accum *A, int b, double r){
+    int s = (int)((r - b * A->dr) * A->inv_fine);
+    if(s < 0) s = 0;
+    if(s >= A->subdiv) s = A->subdiv - 1;
+    return b * A->subdiv + s;
+}
+
+/* Fine bin of a squared distance by the reference rule (sqrt, floor(r/dr), sub-bin) */
+static int g6_fine_index_r2(const G6Accum *A, double r2){
+    double r = sqrt(r2);
+    return g6_fine_index(A, (int)floor(r / A->dr), r);
+}
+
+/* Smallest double r2 >= 0 with g6_fine_index_r2(r2) >= f (bisection on the bit pattern) */
+static double g6_edge2(const G6Accum *A, int f){
+    double hi = (f / A->subdiv + 2) * A->dr;
+    hi *= hi;
+    uint64_t lo_bits = 0, hi_bits;
+    memcpy(&hi_bits, &hi, sizeof(hi));
+    while(hi_bits - lo_bits > 1){
+        uint64_t mid_bits = lo_bits + (hi_bits - lo_bits) / 2;
+        double mid;
+        memcpy(&mid, &mid_bits, sizeof(mid));
+        if(g6_fine_index_r2(A, mid) >= f) hi_bits = mid_bits;
+        else lo_bits = mid_bits;
+    }
+    memcpy(&hi, &hi_bits, sizeof(hi));
+    return hi;
+}
+
+/* Rebuild edge2/lut for the current nbins. The edges reproduce the reference
+   rule bit for bit, so the table lookup bins every pair exactly as
+   floor(sqrt(r2)/dr) would. lut[q] is the bin of the smallest r2 whose cell
+   (int)(r2 * lut_inv_h) is q, so it never overshoots and the lookup only
+   corrects upwards; the cell width is ~1/16 of a fine bin in r^2 on average,
+   so past the first few bins at most one step is needed. lut[nlut] = nbins
+   catches everything past the last edge. */
+static void g6accum_build_lookup(G6Accum *A){
+    const int n = A->nbins;
+    double *e2 = (double*)mem_realloc(A->edge2, (size_t)(n + 2) * sizeof(double));
+    int *lut = (int*)mem_realloc(A->lut, ((size_t)16 * n + 1) * sizeof(int));
+    if(!e2 || !lut){
+        fprintf(stderr,"g6accum_build_lookup: OOM\n");
+        exit(1);
+    }
+    e2[0] = 0.0;
+    for(int f=1;f<=n;f++) e2[f] = g6_edge2(A, f);
+    e2[n + 1] = INFINITY;
+
+    A->nlut = 16 * n;
+    A->lut_inv_h = A->nlut / e2[n];
+    const double h = e2[n] / A->nlut;
+    int f = 0;
+    lut[0] = 0;
+    for(int q=1;q<A->nlut;q++){
+        double c = q * h;
+        while(c > 0.0 && (int)(c * A->lut_inv_h) >= q) c = nextafter(c, 0.0);
+        while((int)(c * A->lut_inv_h) < q) c = nextafter(c, INFINITY);
+        while(f < n && e2[f + 1] <= c) f++;
+        lut[q] = f;
+    }
+    lut[A->nlut] = n;
+    A->edge2 = e2;
+    A->lut = lut;
 }
 
-/* Ensure we have bins up to index bmax (inclusive) */
+/* lut cell of squared distance r2, clamped to the catch-all cell nlut */
+static inline int g6_lut_cell(const G6Accum *A, double r2){
+    double q = r2 * A->lut_inv_h;
+    return q < A->nlut ? (int)q : A->nlut;
+}
+
+/* Fine bin of squared distance r2, or nbins past the last bin */
+static inline int g6_bin_cell(const G6Accum *A, double r2, int q){
+    int f = A->lut[q];
+    f += r2 >= A->edge2[f + 1];     /* the common single step, branch-free */
+    while(r2 >= A->edge2[f + 1]) f++;
+    return f;
+}
+
+/* Fine bin of squared distance r2, or -1 past the last bin */
+static inline int g6_bin_r2(const G6Accum *A, double r2){
+    int f = g6_bin_cell(A, r2, g6_lut_cell(A, r2));
+    return f < A->nbins ? f : -1;
+}
+
+/* Ensure we have fine bins for coarse bins up to index bmax (inclusive) */
 static void g6accum_ensure_bins(G6Accum *A, int bmax){
     if(bmax < 0) return;
-    if(bmax < A->nbins) return;
-    int new_n = bmax + 1;
-    G6Bin *nb = (G6Bin*)realloc(A->bins, (size_t)new_n * sizeof(G6Bin));
-    if(!nb){ 
-        fprintf(stderr,"g6accum_ensure_bins: OOM\n"); 
-        exit(1); 
-    }
-    /* initialize newly allocated bins */
-    for(int b = A->nbins; b < new_n; ++b){
-        nb[b].r_center = (b + 0.5) * A->dr;
-        nb[b].re_sum = 0.0;
-        nb[b].im_sum = 0.0;
-        nb[b].pair_count = 0;
-    }
-    A->bins = nb;
+    int new_n = (bmax + 1) * A->subdiv;
+    if(new_n <= A->nbins) return;
+    double **cols[4] = { &A->re_sum, &A->im_sum, &A->pair_count, &A->ess };
+    for(int c=0;c<4;c++){
+        double *nb = (double*)mem_realloc(*cols[c], (size_t)new_n * sizeof(double));
+        if(!nb){ 
+            fprintf(stderr,"g6accum_ensure_bins: OOM\n"); 
+            exit(1); 
+        }
+        /* initialize newly allocated bins */
+        memset(nb + A->nbins, 0, (size_t)(new_n - A->nbins) * sizeof(double));
+        *cols[c] = nb;
+    }
     A->nbins = new_n;
+    g6accum_build_lookup(A);
+}
+
+
+int g6accum_bin_of_r2(G6Accum *A, double r2){
+    if(!A || !(r2 >= 0.0)) return -1;
+    g6accum_ensure_bins(A, (int)floor(sqrt(r2) / A->dr) + 1);
+    return g6_bin_r2(A, r2);
+}
+
+void g6accum_clear(G6Accum *A){
+    if(!A) return;
+    const size_t n = (size_t)A->nbins * sizeof(double);
+    if(n > 0){
+        memset(A->re_sum, 0, n);
+        memset(A->im_sum, 0, n);
+        memset(A->pair_count, 0, n);
+        memset(A->ess, 0, n);
+    }
+    A->mc_calls = 0;
+    A->mc_samples = 0;
+}
+
+int g6accum_merge(G6Accum *A, const G6Accum *B){
+    if(!A || !B || A->dr != B->dr || A->subdiv != B->subdiv){
+        fprintf(stderr,"g6accum_merge: accumulators have different bins\n");
+        return 1;
+    }
+    if(B->nbins > 0) g6accum_ensure_bins(A, B->nbins / B->subdiv - 1);
+    for(int f=0;f<B->nbins;f++){
+        A->re_sum[f] += B->re_sum[f];
+        A->im_sum[f] += B->im_sum[f];
+        A->pair_count[f] += B->pair_count[f];
+        A->ess[f] += B->ess[f];
+    }
+    A->mc_calls += B->mc_calls;
+    A->mc_samples += B->mc_samples;
+    return 0;
+}
+
+G6Accum *g6accum_clone(const G6Accum *A){
+    G6Accum *C = g6accum_create_fine(A->dr, A->subdiv);
+    if(!C) return NULL;
+    C->out = A->out;
+    C->nchunks = A->nchunks;
+    if(g6accum_merge(C, A) != 0){
+        g6accum_free(C);
+        return NULL;
+    }
+    for(int k=0;k<A->nnotes;k++)
+        if(g6accum_add_note(C, "%s", A->notes[k]) != 0){
+            g6accum_free(C);
+            return NULL;
+        }
+    return C;
+}
+
+int g6accum_coarse_sums(const G6Accum *A, int n, double *re, double *im, double *cnt){
+    for(int k=0;k<n;k++) re[k] = im[k] = cnt[k] = 0.0;
+    for(int f=0;f<A->nbins && f / A->subdiv < n;f++){
+        const int k = f / A->subdiv;
+        re[k] += A->re_sum[f];
+        im[k] += A->im_sum[f];
+        cnt[k] += A->pair_count[f];
+    }
+    return A->nbins / A->subdiv;
+}
+
+/* Largest pair distance that can occur: half the box diagonal with PBC,
+   the diagonal of the bounding box otherwise */
+static double g6_max_distance(const Vec2Array *coms, bool use_pbc, double box_x, double box_y){
+    if(use_pbc) return 0.5 * sqrt(box_x*box_x + box_y*box_y);
+    double xmin = coms->data[0].x, xmax = xmin, ymin = coms->data[0].y, ymax = ymin;
+    for(size_t i=1;i<coms->n;i++){
+        double x = coms->data[i].x, y = coms->data[i].y;
+        if(x < xmin) xmin = x;
+        if(x > xmax) xmax = x;
+        if(y < ymin) ymin = y;
+        if(y > ymax) ymax = y;
+    }
+    return sqrt((xmax - xmin)*(xmax - xmin) + (ymax - ymin)*(ymax - ymin));
+}
+
+/* One row of the pair kernel: squared distances, lut cells and psi6 products
+ * of point i with points j = 0..n-1 (SoA inputs). Branch-free so the compiler
+ * vectorizes it. Im(psi_i conj(psi_j)) is antisymmetric; oj/oi are the
+ * callers' original indices (as doubles) and the sign follows the original
+ * i < j orientation.
+ */
+static void g6_pair_row(int n,
+                        const double *restrict xj, const double *restrict yj,
+                        const double *restrict cj, const double *restrict dj,
+                        const double *restrict oj,
+                        double xi, double yi, double a, double b, double oi,
+                        bool use_pbc, double box_x, double box_y,
+                        double inv_h, double qmax,
+                        double *restrict r2, int *restrict cell,
+                        double *restrict re, double *restrict im)
+{
+    const double hx = 0.5 * box_x, hy = 0.5 * box_y;
+    if(use_pbc){
+        /* minimum image; |d| < L since positions are wrapped */
+        for(int k=0;k<n;k++){
+            double dx = xj[k] - xi;
+            double dy = yj[k] - yi;
+            dx -= (dx > hx ? box_x : 0.0) - (dx < -hx ? box_x : 0.0);
+            dy -= (dy > hy ? box_y : 0.0) - (dy < -hy ? box_y : 0.0);
+            double d2 = dx*dx + dy*dy;
+            double q = d2 * inv_h;
+            r2[k] = d2;
+            cell[k] = (int)(q < qmax ? q : qmax);
+            /* (a + i b)*(c - i d) = (ac + bd) + i (bc - ad) */
+            re[k] = a * cj[k] + b * dj[k];
+            double v = b * cj[k] - a * dj[k];
+            im[k] = oj[k] > oi ? v : -v;
+        }
+    } else {
+        for(int k=0;k<n;k++){
+            double dx = xj[k] - xi;
+            double dy = yj[k] - yi;
+            double d2 = dx*dx + dy*dy;
+            double q = d2 * inv_h;
+            r2[k] = d2;
+            cell[k] = (int)(q < qmax ? q : qmax);
+            re[k] = a * cj[k] + b * dj[k];
+            double v = b * cj[k] - a * dj[k];
+            im[k] = oj[k] > oi ? v : -v;
+        }
+    }
+}
+
+/* Tile edge (points) of the blocked pair kernel: one j tile of SoA inputs
+   (20 KB) plus the row scratch stays in L1 while the rows of the i tile stream
+   over it, and the pairs of two Hilbert-ordered tiles span few bins, so the
+   histogram lines they touch stay cached too. */
+#define G6_TILE 512
+
+/* Private sub-histograms: pair k of a row goes to lane k % G6_LANES, so runs
+   of pairs in the same bin (common along the Hilbert order) update independent
+   memory and the adds do not serialize on a store-to-load chain. Lanes are
+   summed in fixed order once per chunk (counts are exact; sums deterministic). */
+#define G6_LANES 4
+
+/* Fewest pairs worth a chunk of their own (and its G6_LANES histograms) */
+#define G6_MIN_CHUNK_PAIRS 131072.0
+
+size_t g6accum_helper_peak(const G6Accum *A){
+    return A ? A->helper_peak : 0;
+}
+
+void g6accum_helper_counts(const G6Accum *A, uint64_t v[PERFCTR_N]){
+    for(int k=0;k<PERFCTR_N;k++) v[k] = A ? A->helper_ctr[k] : 0;
+}
+
+int g6accum_set_chunks(G6Accum *A, int nchunks){
+    if(!A || nchunks < 1){
+        fprintf(stderr,"g6accum_set_chunks: need at least one chunk\n");
+        return 1;
+    }
+    A->nchunks = nchunks;
+    return 0;
+}
+
+/* Ordered fold of finished chunks into the accumulator: chunk `next` is the
+   first not yet folded; whichever thread finishes it folds it and every
+   finished chunk after it, so the sums see the chunks in index order. It also
+   counts the chunk bytes live on threads other than the owner (the caller),
+   and the hardware counts of the chunks run there, for g6accum_helper_peak and
+   g6accum_helper_counts. */
+typedef struct G6Chunk G6Chunk;
+typedef struct {
+    pthread_mutex_t lock;
+    G6Accum *A;
+    G6Chunk *chunks;
+    int      T, next;
+    pthread_t owner;
+    size_t   helper_live, helper_peak;
+    uint64_t helper_ctr[PERFCTR_N];
+} G6Fold;
+
+/* One chunk of the pair triangle for g6accum_accumulate: `ntp` tile pairs,
+   starting at (ti, tj) in row-major order over tj >= ti, binned into the
+   chunk's own lane histograms. */
+struct G6Chunk {
+    const G6Accum *A;
+    const double *xs, *ys, *pr, *pi, *oidx;   /* SoA inputs in Hilbert order */
+    int    M;
+    bool   use_pbc;
+    double box_x, box_y;
+    int    ti, tj;
+    long   ntp;
+    G6Fold *fold;
+    bool   done;          /* histograms complete, waiting for the fold */
+    double *hre;          /* G6_LANES x (nbins + 1) re then im, [lane][bin] */
+    uint64_t *hcnt;
+    size_t hbytes;        /* bytes of hre and hcnt if allocated off the owner thread */
+};
+
+/* Add the lane histograms of a finished chunk to A in lane order, free them */
+static void g6_chunk_fold(G6Accum *A, G6Chunk *C){
+    const int nb = A->nbins;
+    const size_t hw = (size_t)nb + 1;
+    for(int l=0;l<G6_LANES;l++){
+        const double *lre = C->hre + l*hw, *lim = C->hre + (G6_LANES + l)*hw;
+        const uint64_t *lcnt = C->hcnt + l*hw;
+        for(int f=0;f<nb;f++){
+            A->re_sum[f] += lre[f];
+            A->im_sum[f] += lim[f];
+            A->pair_count[f] += (double)lcnt[f];
+        }
+    }
+    mem_free(C->hre);
+    mem_free(C->hcnt);
+    C->hre = NULL;
+    C->hcnt = NULL;
+    C->fold->helper_live -= C->hbytes;
+}
+
+static void g6_chunk_run(void *arg, int c){
+    G6Chunk *C = (G6Chunk*)arg + c;
+    const G6Accum *A = C->A;
+    const double *xs = C->xs, *ys = C->ys, *pr = C->pr, *pi = C->pi, *oidx = C->oidx;
+    const int M = C->M, nblk = (M + G6_TILE - 1) / G6_TILE;
+    const size_t hw = (size_t)A->nbins + 1;
+    const double inv_h = A->lut_inv_h, qmax = (double)A->nlut;
+    const double t0 = trace_enabled() ? trace_now() : 0.0;
+    G6Fold *F = C->fold;
+    const int helper = !pthread_equal(pthread_self(), F->owner);
+    uint64_t ctr0[PERFCTR_N];
+    const int counting = helper && perfctr_read(ctr0) == 0;
+
+    /* row scratch and lane histograms (bin nbins takes pairs past the last
+       edge and is dropped); allocated here so they are local to the thread */
+    double *rows = (double*)mem_malloc((size_t)G6_TILE * 3 * sizeof(double));
+    int *cell = (int*)mem_malloc(G6_TILE * sizeof(int));
+    double *hre = (double*)mem_calloc(hw * 2 * G6_LANES, sizeof(double));
+    uint64_t *hcnt = (uint64_t*)mem_calloc(hw * G6_LANES, sizeof(uint64_t));
+    if(!rows || !cell || !hre || !hcnt){
+        fprintf(stderr,"g6accum_accumulate: OOM\n");
+        exit(1);
+    }
+    const size_t rbytes = (size_t)G6_TILE * (3 * sizeof(double) + sizeof(int));
+    if(helper){
+        C->hbytes = hw * G6_LANES * (2 * sizeof(double) + sizeof(uint64_t));
+        pthread_mutex_lock(&F->lock);
+        F->helper_live += rbytes + C->hbytes;
+        if(F->helper_live > F->helper_peak) F->helper_peak = F->helper_live;
+        pthread_mutex_unlock(&F->lock);
+    }
+    double *r2row = rows, *rerow = r2row + G6_TILE, *imrow = rerow + G6_TILE;
+    double *him = hre + hw * G6_LANES;
+    double *re0 = hre, *re1 = hre + hw, *re2 = hre + 2*hw, *re3 = hre + 3*hw;
+    double *im0 = him, *im1 = him + hw, *im2 = him + 2*hw, *im3 = him + 3*hw;
+    uint64_t *c0 = hcnt, *c1 = hcnt + hw, *c2 = hcnt + 2*hw, *c3 = hcnt + 3*hw;
+
+    int ti = C->ti, tj = C->tj;
+    for(long t=0;t<C->ntp;t++){
+        const int i0 = ti * G6_TILE, i1 = i0 + G6_TILE < M ? i0 + G6_TILE : M;
+        const int j0 = tj * G6_TILE, j1 = j0 + G6_TILE < M ? j0 + G6_TILE : M;
+        for(int i=i0;i<i1;i++){
+            const int js = (tj == ti) ? i + 1 : j0;
+            const int n = j1 - js;
+            if(n <= 0) continue;
+            g6_pair_row(n, xs + js, ys + js, pr + js, pi + js, oidx + js,
+                        xs[i], ys[i], pr[i], pi[i], oidx[i], C->use_pbc, C->box_x, C->box_y,
+                        inv_h, qmax, r2row, cell, rerow, imrow);
+
+            int k = 0;
+            for(;k+G6_LANES<=n;k+=G6_LANES){
+                int f0 = g6_bin_cell(A, r2row[k], cell[k]);
+                int f1 = g6_bin_cell(A, r2row[k+1], cell[k+1]);
+                int f2 = g6_bin_cell(A, r2row[k+2], cell[k+2]);
+                int f3 = g6_bin_cell(A, r2row[k+3], cell[k+3]);
+                re0[f0] += rerow[k];   im0[f0] += imrow[k];   c0[f0]++;
+                re1[f1] += rerow[k+1]; im1[f1] += imrow[k+1]; c1[f1]++;
+                re2[f2] += rerow[k+2]; im2[f2] += imrow[k+2]; c2[f2]++;
+                re3[f3] += rerow[k+3]; im3[f3] += imrow[k+3]; c3[f3]++;
+            }
+            for(;k<n;k++){
+                int f = g6_bin_cell(A, r2row[k], cell[k]);
+                re0[f] += rerow[k]; im0[f] += imrow[k]; c0[f]++;
+            }
+        }
+        if(++tj == nblk){ ti++; tj = ti; }
+    }
+    mem_free(rows);
+    mem_free(cell);
+    C->hre = hre;
+    C->hcnt = hcnt;
+    if(t0 > 0.0) trace_event("g6 chunk", -1, t0, trace_now());
+
+    uint64_t ctr1[PERFCTR_N];
+    const int counted = counting && perfctr_read(ctr1) == 0;
+
+    /* fold this chunk, and the finished ones queued behind it, if it is next */
+    pthread_mutex_lock(&F->lock);
+    if(helper) F->helper_live -= rbytes;
+    if(counted)
+        for(int k=0;k<PERFCTR_N;k++) F->helper_ctr[k] += ctr1[k] - ctr0[k];
+    C->done = true;
+    while(F->next < F->T && F->chunks[F->next].done) g6_chunk_fold(F->A, &F->chunks[F->next++]);
+    pthread_mutex_unlock(&F->lock);
 }
 
 /* Accumulate contributions from a snapshot.
  * For each unordered pair i<j of COMs:
- *   r = distance(coms[i], coms[j]) (use mic_delta for PBC),
- *   bin = floor(r / dr),
+ *   r^2 = squared distance(coms[i], coms[j]) (minimum image for PBC),
+ *   fine bin from the r^2 edge table (same bin as floor(r / dr) + sub-bin),
  *   add Re(psi_i * conj(psi_j)) and Im(...)
  *   increment pair_count
+ *
+ * Blocked kernel: the COMs are packed SoA in Hilbert order and the pair
+ * triangle is walked in G6_TILE x G6_TILE tiles. Each row of a tile is done
+ * in two passes: a branch-free, vectorized pass computing r^2, its lut cell
+ * and the psi6 products, then the update of G6_LANES private SoA histograms
+ * (pair counts kept as integers). No per-pair sqrt or division.
+ *
+ * The sequence of tile pairs is cut into up to T = g6accum_set_chunks
+ * contiguous chunks of equal pair count (fewer for small snapshots, at least
+ * G6_MIN_CHUNK_PAIRS pairs each), run as tasks on the default pool (tpool.h), each with its own
+ * histograms. A finished chunk is folded into the accumulator (lane order) as
+ * soon as every chunk before it has been, and its histograms freed, so at most
+ * the chunks still running or waiting on an earlier one hold histograms. The
+ * fold order is fixed, so the result depends only on T and the snapshot, never
+ * on the number of threads; pair counts are exact.
  */
 void g6accum_accumulate(G6Accum *A,
                         const Vec2Array *coms,
@@ -94,54 +582,185 @@ void g6accum_accumulate(G6Accum *A,
                         double box_y)
 {
     if(!A || !coms || !psi6) return;
+    A->helper_peak = 0;
+    memset(A->helper_ctr, 0, sizeof(A->helper_ctr));
     int M = (int)coms->n;
     if(M < 2) return;
 
-    /* First pass: find rmax to know how many bins we need */
-    double rmax = 0.0;
-    for(int i=0;i<M-1;i++){
-        for(int j=i+1;j<M;j++){
-            double dx = coms->data[j].x - coms->data[i].x;
-            double dy = coms->data[j].y - coms->data[i].y;
+    /* bins up to the largest possible distance (+1 for rounding at the corner) */
+    int bmax = (int)floor(g6_max_distance(coms, use_pbc, box_x, box_y) / A->dr) + 1;
+    g6accum_ensure_bins(A, bmax);
+    const int nblk = (M + G6_TILE - 1) / G6_TILE;
+    const long ntp = (long)nblk * (nblk + 1) / 2;
+    const double total = 0.5 * (double)M * (M - 1);
+    double tmax = floor(total / G6_MIN_CHUNK_PAIRS);
+    if(tmax > ntp) tmax = (double)ntp;
+    int T = A->nchunks < tmax ? A->nchunks : (int)tmax;
+    if(T < 1) T = 1;
+
+    /* Hilbert order of the (wrapped) COMs: consecutive tiles are spatially compact */
+    double *xy = (double*)mem_malloc(2 * (size_t)M * sizeof(double));
+    int *ord = NULL;
+    if(xy){
+        for(int i=0;i<M;i++){
+            double x = coms->data[i].x, y = coms->data[i].y;
             if(use_pbc){
-                dx = mic_delta(dx, box_x);
-                dy = mic_delta(dy, box_y);
+                /* inside the box, so one image shift is enough in g6_pair_row */
+                if(x < 0.0 || x >= box_x) x = wrap_pos(x, box_x);
+                if(y < 0.0 || y >= box_y) y = wrap_pos(y, box_y);
             }
-            double r2 = dx*dx + dy*dy;
-            if(r2 > rmax*rmax) rmax = sqrt(r2);
+            xy[2*i] = x;
+            xy[2*i + 1] = y;
         }
+        ord = hilbert_order(xy, M);
     }
-    int bmax = (int)floor(rmax / A->dr);
-    g6accum_ensure_bins(A, bmax);
 
-    /* Accumulate pair contributions */
-    for(int i=0;i<M-1;i++){
-        for(int j=i+1;j<M;j++){
-            double dx = coms->data[j].x - coms->data[i].x;
-            double dy = coms->data[j].y - coms->data[i].y;
-            if(use_pbc){
-                dx = mic_delta(dx, box_x);
-                dy = mic_delta(dy, box_y);
+    double *buf = (double*)mem_malloc((size_t)M * 5 * sizeof(double));
+    G6Chunk *chunks = (G6Chunk*)mem_calloc((size_t)T, sizeof(G6Chunk));
+    if(!xy || !ord || !buf || !chunks){
+        fprintf(stderr,"g6accum_accumulate: OOM\n");
+        exit(1);
+    }
+    double *xs = buf, *ys = buf + M, *pr = buf + 2*(size_t)M, *pi = buf + 3*(size_t)M;
+    double *oidx = buf + 4*(size_t)M;   /* original index, for the sign of Im */
+    for(int k=0;k<M;k++){
+        xs[k] = xy[2*ord[k]];
+        ys[k] = xy[2*ord[k] + 1];
+        pr[k] = psi6[ord[k]].re;
+        pi[k] = psi6[ord[k]].im;
+        oidx[k] = (double)ord[k];
+    }
+    mem_free(xy);
+    mem_free(ord);
+
+    /* equal-work chunks: chunk c ends once the running pair count reaches
+       (c + 1) / T of the total (the triangle makes equal tile-row splits
+       badly unbalanced) */
+    double done = 0.0;
+    int c = 0;
+    long t = 0;
+    for(int ti=0;ti<nblk && c<T;ti++){
+        const int ni = (ti + 1) * G6_TILE < M ? G6_TILE : M - ti * G6_TILE;
+        for(int tj=ti;tj<nblk && c<T;tj++){
+            const int nj = (tj + 1) * G6_TILE < M ? G6_TILE : M - tj * G6_TILE;
+            G6Chunk *C = &chunks[c];
+            if(C->ntp == 0){
+                C->ti = ti;
+                C->tj = tj;
             }
-            double r = sqrt(dx*dx + dy*dy);
-            int b = (int)floor(r / A->dr);
-            if(b < 0 || b >= A->nbins) continue;
+            C->ntp++;
+            t++;
+            done += (ti == tj) ? 0.5 * (double)ni * (ni - 1) : (double)ni * nj;
+            /* keep at least one tile pair for each remaining chunk */
+            if(c < T - 1 && (done >= total * (c + 1) / T || ntp - t == T - 1 - c)) c++;
+        }
+    }
+    G6Fold fold = { .A = A, .chunks = chunks, .T = T, .next = 0, .owner = pthread_self() };
+    pthread_mutex_init(&fold.lock, NULL);
+    for(c=0;c<T;c++){
+        G6Chunk *C = &chunks[c];
+        C->A = A;
+        C->xs = xs; C->ys = ys; C->pr = pr; C->pi = pi; C->oidx = oidx;
+        C->M = M;
+        C->use_pbc = use_pbc;
+        C->box_x = box_x;
+        C->box_y = box_y;
+        C->fold = &fold;
+    }
 
-            /* (a + i b)*(c - i d) = (ac + bd) + i (bc - ad) */
-            double a = psi6[i].re;
-            double b_im = psi6[i].im;
-            double c = psi6[j].re;
-            double d = psi6[j].im;
+    tpool_run(NULL, T, g6_chunk_run, chunks);
+    pthread_mutex_destroy(&fold.lock);
+    A->helper_peak = fold.helper_peak;
+    memcpy(A->helper_ctr, fold.helper_ctr, sizeof(A->helper_ctr));
+    mem_free(chunks);
+    mem_free(buf);
+}
+
+/* ------------------------- Output binning ------------------------- */
+
+int g6accum_set_binning(G6Accum *A, const G6Binning *bin){
+    if(!A || !bin) return 1;
+    if(bin->log ? (bin->rmin <= 0.0 || bin->per_decade < 1) : bin->dr <= 0.0){
+        fprintf(stderr, "g6accum_set_binning: invalid binning\n");
+        return 1;
+    }
+    A->out = *bin;
+    return 0;
+}
+
+int g6_binning_parse(const char *arg, G6Binning *bin){
+    if(strncmp(arg, "--out-dr=", 9) == 0){
+        bin->log = 0;
+        bin->dr = atof(arg + 9);
+        return bin->dr > 0.0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--out-log=", 10) == 0){
+        bin->log = 1;
+        if(sscanf(arg + 10, "%lf:%d", &bin->rmin, &bin->per_decade) != 2) return 1;
+        return (bin->rmin > 0.0 && bin->per_decade > 0) ? 0 : 1;
+    }
+    return 1;
+}
 
-            A->bins[b].re_sum += a * c + b_im * d;
-            A->bins[b].im_sum += b_im * c - a * d;
-            A->bins[b].pair_count += 1;
+/* Output bin sums built from the fine bins */
+typedef struct {
+    G6Bin *bins;
+    double *r_center;
+    int    n;
+    double width;      /* uniform width actually used (multiple of the fine width) */
+} G6Rebinned;
+
+static int g6_rebin(const G6Accum *A, G6Rebinned *R){
+    const double fine = A->dr / A->subdiv;
+    int m = 0;
+    memset(R, 0, sizeof(*R));
+    if(A->out.log){
+        int omax = -1;
+        for(int f=0;f<A->nbins;f++){
+            double rc = (f + 0.5) * fine;
+            if(rc < A->out.rmin) continue;
+            int o = (int)floor(A->out.per_decade * log10(rc / A->out.rmin));
+            if(o > omax) omax = o;
+        }
+        R->n = omax + 1;
+    } else {
+        m = (int)floor(A->out.dr / fine + 0.5);
+        if(m < 1) m = 1;
+        /* the default (m == subdiv) keeps the exact dr of the accumulator */
+        R->width = (m == A->subdiv) ? A->dr : m * fine;
+        R->n = (A->nbins + m - 1) / m;
+    }
+    R->bins = (G6Bin*)calloc((size_t)(R->n > 0 ? R->n : 1), sizeof(G6Bin));
+    R->r_center = (double*)malloc((size_t)(R->n > 0 ? R->n : 1) * sizeof(double));
+    if(!R->bins || !R->r_center){
+        fprintf(stderr, "g6_rebin: OOM\n");
+        free(R->bins); free(R->r_center);
+        return 2;
+    }
+    for(int o=0;o<R->n;o++){
+        R->r_center[o] = A->out.log ? A->out.rmin * pow(10.0, (o + 0.5) / A->out.per_decade)
+                                    : (o + 0.5) * R->width;
+    }
+    for(int f=0;f<A->nbins;f++){
+        int o;
+        if(A->out.log){
+            double rc = (f + 0.5) * fine;
+            if(rc < A->out.rmin) continue;
+            o = (int)floor(A->out.per_decade * log10(rc / A->out.rmin));
+        } else {
+            o = f / m;
         }
+        R->bins[o].re_sum += A->re_sum[f];
+        R->bins[o].im_sum += A->im_sum[f];
+        R->bins[o].pair_count += A->pair_count[f];
+        R->bins[o].ess += A->ess[f];
     }
+    return 0;
 }
 
 /* Write averaged g6(r) file. Format:
  * r_center  Re[g6(r)]  Im[g6(r)]  |g6(r)|  pair_count
+ * Bins follow the output binning (g6accum_set_binning; default: uniform dr).
  */
 int g6accum_write(G6Accum *A,
                   const char *outpath,
@@ -152,25 +771,505 @@ int g6accum_write(G6Accum *A,
                   double box_y)
 {
     if(!A || !outpath){ fprintf(stderr,"g6accum_write: invalid args\n"); return 1; }
+    G6Rebinned R;
+    if(g6_rebin(A, &R) != 0) return 3;
     FILE *f = fopen(outpath, "w");
-    if(!f){ fprintf(stderr,"g6accum_write: cannot open %s: %s\n", outpath, strerror(errno)); return 2; }
+    if(!f){
+        fprintf(stderr,"g6accum_write: cannot open %s: %s\n", outpath, strerror(errno));
+        free(R.bins); free(R.r_center);
+        return 2;
+    }
 
     fprintf(f, "# Averaged g6(r) over snapshots time_%d .. time_%d\n", t0, t1);
-    fprintf(f, "# Columns: r_center  Re[g6(r)]  Im[g6(r)]  |g6(r)|  pair_count\n");
-    fprintf(f, "# Params: dr = %.8g  lbond = %.8g  USE_PBC = %s\n", A->dr, lbond, use_pbc ? "true" : "false");
+    if(A->mc_calls > 0){
+        fprintf(f, "# Columns: r_center  Re[g6(r)]  Im[g6(r)]  |g6(r)|  pair_count  ess\n");
+    } else {
+        fprintf(f, "# Columns: r_center  Re[g6(r)]  Im[g6(r)]  |g6(r)|  pair_count\n");
+    }
+    if(A->out.log){
+        fprintf(f, "# Params: log bins rmin = %.8g  per_decade = %d  lbond = %.8g  USE_PBC = %s\n",
+                A->out.rmin, A->out.per_decade, lbond, use_pbc ? "true" : "false");
+    } else {
+        fprintf(f, "# Params: dr = %.8g  lbond = %.8g  USE_PBC = %s\n", R.width, lbond, use_pbc ? "true" : "false");
+    }
     if(use_pbc){
         fprintf(f, "# Box dims: %.8g x %.8g\n", box_x, box_y);
     }
+    if(A->out.log || R.width != A->dr){
+        fprintf(f, "# Rebinned from fine bins of width %.8g\n", A->dr / A->subdiv);
+    }
+    if(A->mc_calls > 0){
+        fprintf(f, "# Monte Carlo estimate: %ld snapshots, %ld pair samples (pair_count is estimated)\n",
+                A->mc_calls, A->mc_samples);
+    }
+    for(int k=0;k<A->nnotes;k++){
+        fprintf(f, "# %s\n", A->notes[k]);
+    }
 
-    for(int b=0;b<A->nbins;b++){
-        long cnt = A->bins[b].pair_count;
-        if(cnt <= 0) continue;
-        double re = A->bins[b].re_sum / (double)cnt;
-        double im = A->bins[b].im_sum / (double)cnt;
+    for(int b=0;b<R.n;b++){
+        double cnt = R.bins[b].pair_count;
+        if(cnt <= 0.0) continue;
+        double re = R.bins[b].re_sum / cnt;
+        double im = R.bins[b].im_sum / cnt;
         double mag = sqrt(re*re + im*im);
-        fprintf(f, "%.8f %.10e %.10e %.10e %ld\n", A->bins[b].r_center, re, im, mag, cnt);
+        if(A->mc_calls > 0){
+            fprintf(f, "%.8f %.10e %.10e %.10e %.0f %.1f\n", R.r_center[b], re, im, mag, cnt, R.bins[b].ess);
+        } else {
+            fprintf(f, "%.8f %.10e %.10e %.10e %.0f\n", R.r_center[b], re, im, mag, cnt);
+        }
     }
 
     fclose(f);
+    free(R.bins);
+    free(R.r_center);
     return 0;
 }
+
+int g6accum_write_ensemble(G6Accum *P,
+                           G6Accum *const *R,
+                           int nrep,
+                           const char *outpath,
+                           int t0, int t1,
+                           double lbond,
+                           bool use_pbc,
+                           double box_x,
+                           double box_y)
+{
+    if(!P || !R || nrep < 1 || !outpath){ fprintf(stderr,"g6accum_write_ensemble: invalid args\n"); return 1; }
+    G6Rebinned PB;
+    if(g6_rebin(P, &PB) != 0) return 3;
+    G6Rebinned *RB = (G6Rebinned*)calloc((size_t)nrep, sizeof(G6Rebinned));
+    if(!RB){ fprintf(stderr,"g6accum_write_ensemble: OOM\n"); free(PB.bins); free(PB.r_center); return 3; }
+    int rc = 0;
+    for(int k=0;k<nrep && rc == 0;k++){
+        if(R[k]->dr != P->dr || R[k]->subdiv != P->subdiv){
+            fprintf(stderr,"g6accum_write_ensemble: replica %d has different bins\n", k);
+            rc = 1;
+        } else if(g6_rebin(R[k], &RB[k]) != 0){
+            rc = 3;
+        }
+    }
+    FILE *f = rc == 0 ? fopen(outpath, "w") : NULL;
+    if(rc == 0 && !f){
+        fprintf(stderr,"g6accum_write_ensemble: cannot open %s: %s\n", outpath, strerror(errno));
+        rc = 2;
+    }
+    if(f){
+        fprintf(f, "# Averaged g6(r) over snapshots time_%d .. time_%d of %d replicas\n", t0, t1, nrep);
+        fprintf(f, "# Columns: r_center  Re[g6(r)]  Im[g6(r)]  |g6(r)|  pair_count  err_Re  err_Im  err_|g6|  nrep\n");
+        fprintf(f, "# Pooled over all replicas (pair-weighted); err = replica standard deviation / sqrt(nrep)\n");
+        if(P->out.log){
+            fprintf(f, "# Params: log bins rmin = %.8g  per_decade = %d  lbond = %.8g  USE_PBC = %s\n",
+                    P->out.rmin, P->out.per_decade, lbond, use_pbc ? "true" : "false");
+        } else {
+            fprintf(f, "# Params: dr = %.8g  lbond = %.8g  USE_PBC = %s\n", PB.width, lbond, use_pbc ? "true" : "false");
+        }
+        if(use_pbc){
+            fprintf(f, "# Box dims: %.8g x %.8g\n", box_x, box_y);
+        }
+        for(int k=0;k<P->nnotes;k++){
+            fprintf(f, "# %s\n", P->notes[k]);
+        }
+        for(int b=0;b<PB.n;b++){
+            double cnt = PB.bins[b].pair_count;
+            if(cnt <= 0.0) continue;
+            double re = PB.bins[b].re_sum / cnt, im = PB.bins[b].im_sum / cnt;
+            /* spread of the replica averages (Welford) */
+            double m[3] = {0.0, 0.0, 0.0}, m2[3] = {0.0, 0.0, 0.0};
+            int n = 0;
+            for(int k=0;k<nrep;k++){
+                if(b >= RB[k].n || RB[k].bins[b].pair_count <= 0.0) continue;
+                const double c = RB[k].bins[b].pair_count;
+                const double x[3] = { RB[k].bins[b].re_sum / c, RB[k].bins[b].im_sum / c,
+                                      sqrt(RB[k].bins[b].re_sum * RB[k].bins[b].re_sum +
+                                           RB[k].bins[b].im_sum * RB[k].bins[b].im_sum) / c };
+                n++;
+                for(int q=0;q<3;q++){
+                    const double d = x[q] - m[q];
+                    m[q] += d / n;
+                    m2[q] += d * (x[q] - m[q]);
+                }
+            }
+            double err[3] = {0.0, 0.0, 0.0};
+            if(n > 1)
+                for(int q=0;q<3;q++) err[q] = sqrt(m2[q] / (n - 1) / n);
+            fprintf(f, "%.8f %.10e %.10e %.10e %.0f %.10e %.10e %.10e %d\n", PB.r_center[b], re, im,
+                    sqrt(re*re + im*im), cnt, err[0], err[1], err[2], n);
+        }
+        fclose(f);
+    }
+    for(int k=0;k<nrep;k++){ free(RB[k].bins); free(RB[k].r_center); }
+    free(RB);
+    free(PB.bins);
+    free(PB.r_center);
+    return rc;
+}
+
+/* ------------------------- Raw fine-bin dump ------------------------- */
+
+/* Raw format (text, full precision):
+ *   # g6accum raw v1
+ *   # dr <dr> subdiv <subdiv>
+ *   # meta <t0> <t1> <lbond> <use_pbc> <box_x> <box_y>
+ *   # mc <mc_calls> <mc_samples>
+ *   # note <text>                       (zero or more)
+ *   <fine_index> <re_sum> <im_sum> <pair_count> <ess>   (non-empty bins)
+ */
+int g6accum_write_raw(G6Accum *A,
+                      const char *outpath,
+                      int t0, int t1,
+                      double lbond,
+                      bool use_pbc,
+                      double box_x,
+                      double box_y)
+{
+    if(!A || !outpath){ fprintf(stderr,"g6accum_write_raw: invalid args\n"); return 1; }
+    FILE *f = fopen(outpath, "w");
+    if(!f){ fprintf(stderr,"g6accum_write_raw: cannot open %s: %s\n", outpath, strerror(errno)); return 2; }
+
+    fprintf(f, "# g6accum raw v1\n");
+    fprintf(f, "# dr %.17g subdiv %d\n", A->dr, A->subdiv);
+    fprintf(f, "# meta %d %d %.17g %d %.17g %.17g\n", t0, t1, lbond, use_pbc ? 1 : 0, box_x, box_y);
+    fprintf(f, "# mc %ld %ld\n", A->mc_calls, A->mc_samples);
+    for(int k=0;k<A->nnotes;k++){
+        fprintf(f, "# note %s\n", A->notes[k]);
+    }
+    for(int b=0;b<A->nbins;b++){
+        if(A->pair_count[b] <= 0.0) continue;
+        fprintf(f, "%d %.17g %.17g %.17g %.17g\n", b, A->re_sum[b], A->im_sum[b], A->pair_count[b], A->ess[b]);
+    }
+    fclose(f);
+    return 0;
+}
+
+G6Accum *g6accum_read_raw(const char *path, G6RawMeta *meta){
+    if(!path){ fprintf(stderr,"g6accum_read_raw: invalid args\n"); return NULL; }
+    FILE *f = fopen(path, "r");
+    if(!f){ fprintf(stderr,"g6accum_read_raw: cannot open %s: %s\n", path, strerror(errno)); return NULL; }
+
+    char line[4096];
+    if(!fgets(line, sizeof(line), f) || strncmp(line, "# g6accum raw v1", 16) != 0){
+        fprintf(stderr,"g6accum_read_raw: %s is not a g6accum raw file\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    /* data lines are collected first, so the bins (and their r^2 tables)
+       are sized once for the largest index */
+    G6Accum *A = NULL;
+    G6RawMeta m;
+    memset(&m, 0, sizeof(m));
+    G6Bin *vals = NULL;
+    int *idx = NULL, bmax = -1, bad = 0;
+    size_t nval = 0, cap = 0;
+    while(fgets(line, sizeof(line), f)){
+        if(line[0] == '#'){
+            double dr; int subdiv, pbc;
+            long calls, samples;
+            if(!A && sscanf(line, "# dr %lf subdiv %d", &dr, &subdiv) == 2){
+                A = g6accum_create_fine(dr, subdiv);
+                if(!A) break;
+            } else if(sscanf(line, "# meta %d %d %lf %d %lf %lf", &m.t0, &m.t1, &m.lbond, &pbc, &m.box_x, &m.box_y) == 6){
+                m.use_pbc = pbc != 0;
+            } else if(A && sscanf(line, "# mc %ld %ld", &calls, &samples) == 2){
+                A->mc_calls = calls;
+                A->mc_samples = samples;
+            } else if(A && strncmp(line, "# note ", 7) == 0){
+                line[strcspn(line, "\n")] = '\0';
+                g6accum_add_note(A, "%s", line + 7);
+            }
+            continue;
+        }
+        int b;
+        G6Bin B;
+        if(!A || sscanf(line, "%d %lf %lf %lf %lf", &b, &B.re_sum, &B.im_sum, &B.pair_count, &B.ess) != 5 || b < 0){
+            fprintf(stderr,"g6accum_read_raw: malformed line in %s: %s", path, line);
+            bad = 1;
+            break;
+        }
+        if(nval == cap){
+            cap = cap ? 2 * cap : 1024;
+            G6Bin *nv = (G6Bin*)realloc(vals, cap * sizeof(G6Bin));
+            int *ni = (int*)realloc(idx, cap * sizeof(int));
+            if(nv) vals = nv;
+            if(ni) idx = ni;
+            if(!nv || !ni){ fprintf(stderr,"g6accum_read_raw: OOM\n"); bad = 1; break; }
+        }
+        vals[nval] = B;
+        idx[nval++] = b;
+        if(b > bmax) bmax = b;
+    }
+    fclose(f);
+    if(!A && !bad) fprintf(stderr,"g6accum_read_raw: missing dr/subdiv header in %s\n", path);
+    if(bad || !A){
+        free(vals);
+        free(idx);
+        g6accum_free(A);
+        return NULL;
+    }
+    if(bmax >= 0) g6accum_ensure_bins(A, bmax / A->subdiv);
+    for(size_t k=0;k<nval;k++){
+        A->re_sum[idx[k]] = vals[k].re_sum;
+        A->im_sum[idx[k]] = vals[k].im_sum;
+        A->pair_count[idx[k]] = vals[k].pair_count;
+        A->ess[idx[k]] = vals[k].ess;
+    }
+    free(vals);
+    free(idx);
+    if(meta) *meta = m;
+    return A;
+}
+
+/* ------------------- Monte Carlo pair-sampling estimator ------------------- */
+
+void g6accum_mc_defaults(G6MCParams *p){
+    if(!p) return;
+    p->tol = 0.01;
+    p->min_samples = 200;
+    p->max_samples = 1000000;
+    p->seed = 0x9E3779B97F4A7C15ULL;
+    p->stream = -1;
+}
+
+/* splitmix64: small, fast, good enough for sampling indices */
+static inline uint64_t mc_next(uint64_t *s){
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* uniform integer in [0, n) */
+static inline int mc_below(uint64_t *s, int n){
+    return (int)(((mc_next(s) >> 32) * (uint64_t)n) >> 32);
+}
+
+/* Range of |dx| (minimum image with PBC) between points of two cells `o` cells apart */
+static void mc_axis_range(int o, double w, bool use_pbc, double L, double *lo, double *hi){
+    int a = o < 0 ? -o : o;
+    double l = (a > 0 ? a - 1 : 0) * w;
+    double h = (a + 1) * w;
+    if(use_pbc){
+        double lw = L - h;          /* the other image can be closer */
+        if(lw < l) l = lw > 0.0 ? lw : 0.0;
+        if(h > 0.5 * L) h = 0.5 * L;
+    }
+    *lo = l;
+    *hi = h;
+}
+
+/* Per-bin running sums: x = w*1[bin], y = x*f for f = Re, Im of psi_i conj(psi_j) */
+typedef struct {
+    long   n, hits;
+    double sx, sxx;
+    double sy_re, syy_re, sxy_re;
+    double sy_im, syy_im, sxy_im;
+} MCBinStat;
+
+/* SE of the ratio estimate sy/sx (delta method): sqrt(sum (y - g x)^2) / sx */
+static double mc_ratio_se(double sx, double sy, double syy, double sxy, double sxx){
+    double g = sy / sx;
+    double v = syy - 2.0 * g * sxy + g * g * sxx;
+    if(v < 0.0) v = 0.0;
+    return sqrt(v) / sx;
+}
+
+int g6accum_accumulate_mc(G6Accum *A,
+                          const Vec2Array *coms,
+                          const Complex *psi6,
+                          bool use_pbc,
+                          double box_x,
+                          double box_y,
+                          const G6MCParams *p,
+                          G6MCStats *st)
+{
+    if(st) memset(st, 0, sizeof(*st));
+    if(!A || !coms || !psi6 || !p || p->tol <= 0.0){
+        fprintf(stderr, "g6accum_accumulate_mc: invalid arguments\n");
+        return 1;
+    }
+    if(use_pbc && (box_x <= 0.0 || box_y <= 0.0)){
+        fprintf(stderr, "g6accum_accumulate_mc: use_pbc true but box_x/box_y not positive\n");
+        return 1;
+    }
+    const int M = (int)coms->n;
+    if(M < 2) return 0;
+
+    CellList cl;
+    if(celllist_build(&cl, coms, A->dr, use_pbc, box_x, box_y) != 0) return 2;
+
+    /* largest possible pair distance -> number of bins */
+    double hx = use_pbc ? 0.5 * box_x : cl.ncx * cl.cw;
+    double hy = use_pbc ? 0.5 * box_y : cl.ncy * cl.ch;
+    int nb = (int)floor(sqrt(hx*hx + hy*hy) / A->dr) + 1;
+
+    /* small snapshots: all pairs are cheaper than the minimum sampling budget */
+    if((double)M * (M - 1) / 2.0 <= (double)nb * (double)p->min_samples){
+        celllist_free(&cl);
+        g6accum_accumulate(A, coms, psi6, use_pbc, box_x, box_y);
+        if(st) st->exact = 1;
+        return 0;
+    }
+
+    /* bins and r^2 edges for the whole range before sampling */
+    g6accum_ensure_bins(A, nb - 1);
+
+    /* distinct cell offsets (each target cell reached once under PBC) */
+    int oxlo, oxhi, oylo, oyhi;
+    if(use_pbc){
+        oxlo = -((cl.ncx - 1) / 2); oxhi = cl.ncx / 2;
+        oylo = -((cl.ncy - 1) / 2); oyhi = cl.ncy / 2;
+    } else {
+        oxlo = -(cl.ncx - 1); oxhi = cl.ncx - 1;
+        oylo = -(cl.ncy - 1); oyhi = cl.ncy - 1;
+    }
+    const int nox = oxhi - oxlo + 1;
+    const long noff = (long)nox * (oyhi - oylo + 1);
+
+    /* per-bin offset lists (CSR): offset k goes to every bin its distance range touches */
+    int *off_start = (int*)mem_calloc((size_t)nb + 1, sizeof(int));
+    int *off_b0 = (int*)mem_malloc((size_t)noff * sizeof(int));
+    int *off_b1 = (int*)mem_malloc((size_t)noff * sizeof(int));
+    MCBinStat *bs = (MCBinStat*)mem_calloc((size_t)nb, sizeof(MCBinStat));
+    int *off_list = NULL;
+    int *fill = NULL;
+    char *finished = NULL;
+    G6Bin *fine = (G6Bin*)mem_calloc((size_t)nb * A->subdiv, sizeof(G6Bin));  /* per fine bin: sum x, y; ess holds sum x^2 */
+    int rc = 0;
+    if(!off_start || !off_b0 || !off_b1 || !bs || !fine){ rc = 2; goto done; }
+
+    for(long k=0;k<noff;k++){
+        double xlo, xhi, ylo, yhi;
+        mc_axis_range(oxlo + (int)(k % nox), cl.cw, use_pbc, box_x, &xlo, &xhi);
+        mc_axis_range(oylo + (int)(k / nox), cl.ch, use_pbc, box_y, &ylo, &yhi);
+        off_b0[k] = (int)floor(sqrt(xlo*xlo + ylo*ylo) / A->dr);
+        off_b1[k] = (int)floor(sqrt(xhi*xhi + yhi*yhi) / A->dr);
+        if(off_b1[k] >= nb) off_b1[k] = nb - 1;
+        for(int b=off_b0[k];b<=off_b1[k];b++) off_start[b + 1]++;
+    }
+    for(int b=0;b<nb;b++) off_start[b + 1] += off_start[b];
+    off_list = (int*)mem_malloc((size_t)(off_start[nb] > 0 ? off_start[nb] : 1) * sizeof(int));
+    fill = (int*)mem_malloc((size_t)nb * sizeof(int));
+    finished = (char*)mem_calloc((size_t)nb, 1);
+    if(!off_list || !fill || !finished){ rc = 2; goto done; }
+    memcpy(fill, off_start, (size_t)nb * sizeof(int));
+    for(long k=0;k<noff;k++){
+        for(int b=off_b0[k];b<=off_b1[k];b++) off_list[fill[b]++] = (int)k;
+    }
+
+    /* sample bins in rounds until every bin has converged or hit the cap; a bin
+       never draws more samples than it has candidate (i, j) pairs on average */
+    const double occupancy = (double)M / ((double)cl.ncx * cl.ncy);
+    const long min_hits = 30;     /* SE from fewer hits is not trusted */
+    long stream = p->stream >= 0 ? p->stream : A->mc_calls;
+    uint64_t rng = (uint64_t)p->seed ^ ((uint64_t)(stream + 1) * 0xD1B54A32D192ED03ULL);
+    const long batch = 256;
+    int active = 1;
+    while(active){
+        active = 0;
+        for(int b=0;b<nb;b++){
+            const int L = off_start[b + 1] - off_start[b];
+            MCBinStat *S = &bs[b];
+            if(L == 0 || finished[b]) continue;
+
+            const double r2lo = A->edge2[b * A->subdiv];
+            const double r2hi = A->edge2[(b + 1) * A->subdiv];
+            for(long t=0;t<batch;t++){
+                S->n++;
+                int i = mc_below(&rng, M);
+                int k = off_list[off_start[b] + mc_below(&rng, L)];
+                int cx = cl.cell_of[i] % cl.ncx + oxlo + k % nox;
+                int cy = cl.cell_of[i] / cl.ncx + oylo + k / nox;
+                if(use_pbc){
+                    if(cx < 0) cx += cl.ncx; else if(cx >= cl.ncx) cx -= cl.ncx;
+                    if(cy < 0) cy += cl.ncy; else if(cy >= cl.ncy) cy -= cl.ncy;
+                } else if(cx < 0 || cx >= cl.ncx || cy < 0 || cy >= cl.ncy){
+                    continue;
+                }
+                int c = cy * cl.ncx + cx;
+                int nc = cl.start[c + 1] - cl.start[c];
+                if(nc == 0) continue;
+                int j = cl.items[cl.start[c] + mc_below(&rng, nc)];
+                if(j == i) continue;
+
+                double dx = coms->data[j].x - coms->data[i].x;
+                double dy = coms->data[j].y - coms->data[i].y;
+                if(use_pbc){
+                    dx = mic_delta(dx, box_x);
+                    dy = mic_delta(dy, box_y);
+                }
+                double r2 = dx*dx + dy*dy;
+                if(r2 < r2lo || r2 >= r2hi) continue;
+
+                double x = (double)L * (double)nc;
+                double fre = psi6[i].re * psi6[j].re + psi6[i].im * psi6[j].im;
+                double fim = psi6[i].im * psi6[j].re - psi6[i].re * psi6[j].im;
+                if(i > j) fim = -fim;     /* Im of the pair with i < j, as the exact kernel */
+                G6Bin *F = &fine[g6_bin_r2(A, r2)];
+                F->pair_count += x;  F->ess += x * x;
+                F->re_sum += x * fre; F->im_sum += x * fim;
+                S->hits++;
+                S->sx += x;          S->sxx += x * x;
+                S->sy_re += x * fre; S->syy_re += x * x * fre * fre; S->sxy_re += x * x * fre;
+                S->sy_im += x * fim; S->syy_im += x * x * fim * fim; S->sxy_im += x * x * fim;
+            }
+
+            long cap = p->max_samples;
+            double cand = (double)M * L * occupancy;
+            if(cand < (double)cap) cap = (long)cand + batch;
+            if(S->n >= p->min_samples && S->hits >= min_hits
+               && mc_ratio_se(S->sx, S->sy_re, S->syy_re, S->sxy_re, S->sxx) <= p->tol
+               && mc_ratio_se(S->sx, S->sy_im, S->syy_im, S->sxy_im, S->sxx) <= p->tol){
+                finished[b] = 1;
+            } else if(S->n >= cap){
+                finished[b] = 1;
+                if(st) st->nbins_capped++;
+            } else {
+                active = 1;
+            }
+        }
+    }
+
+    /* deposit per fine bin: unordered pair count C = M * sum(x) / (2 n_b),
+       g6 = sum(y) / sum(x), where n_b is the sample count of the parent bin */
+    if(st) st->min_ess = INFINITY;
+    long samples = 0;
+    for(int b=0;b<nb;b++){
+        MCBinStat *S = &bs[b];
+        if(off_start[b + 1] == off_start[b]) continue;
+        samples += S->n;
+        if(st) st->nbins++;
+        if(S->hits == 0) continue;
+        double ess = S->sx * S->sx / S->sxx;
+        if(st && ess < st->min_ess) st->min_ess = ess;
+        for(int k=0;k<A->subdiv;k++){
+            const G6Bin *F = &fine[b * A->subdiv + k];
+            if(F->pair_count <= 0.0) continue;
+            const int d = b * A->subdiv + k;
+            double cnt = 0.5 * (double)M * F->pair_count / (double)S->n;
+            A->re_sum[d] += cnt * F->re_sum / F->pair_count;
+            A->im_sum[d] += cnt * F->im_sum / F->pair_count;
+            A->pair_count[d] += cnt;
+            A->ess[d] += F->pair_count * F->pair_count / F->ess;
+        }
+    }
+    if(st){
+        st->samples = samples;
+        if(isinf(st->min_ess)) st->min_ess = 0.0;
+    }
+    A->mc_calls++;
+    A->mc_samples += samples;
+
+done:
+    if(rc != 0) fprintf(stderr, "g6accum_accumulate_mc: OOM\n");
+    mem_free(off_list);
+    mem_free(fill);
+    mem_free(finished);
+    mem_free(off_b0);
+    mem_free(off_b1);
+    mem_free(off_start);
+    mem_free(bs);
+    mem_free(fine);
+    celllist_free(&cl);
+    return rc;
+}
@@ -3,15 +3,54 @@
 
 #include "utils.h"   /* Vec2Array, mic_delta */
 #include "psi6.h"    /* Complex */
+#include "perfctr.h"  /* PERFCTR_N */
 #include <stdbool.h>
 
 /* Opaque accumulator */
 typedef struct G6Accum G6Accum;
 
-/* Create/destroy */
+/* Fine bins recorded per dr by g6accum_create */
+#define G6ACCUM_DEFAULT_SUBDIV 8
+
+/* Equal-work chunks of the all-pairs kernel per snapshot (g6accum_set_chunks) */
+#define G6ACCUM_DEFAULT_CHUNKS 16
+
+/* Output binning used by g6accum_write.
+ * - uniform (log == 0): width dr, rounded to a whole number of fine bins
+ * - logarithmic (log == 1): per_decade bins per factor 10, starting at rmin
+ * Fine bins are assigned whole to an output bin (by their center for log bins).
+ */
+typedef struct {
+    int    log;
+    double dr;
+    double rmin;
+    int    per_decade;
+} G6Binning;
+
+/* Create/destroy.
+ * g6accum_create(dr) records G6ACCUM_DEFAULT_SUBDIV fine bins per dr and writes
+ * with uniform width dr by default; g6accum_create_fine chooses the subdivision.
+ */
 G6Accum *g6accum_create(double dr);
+G6Accum *g6accum_create_fine(double dr, int subdiv);
 void g6accum_free(G6Accum *A);
 
+/* Select the output binning (default: uniform with the creation dr). Returns 0 on success. */
+int g6accum_set_binning(G6Accum *A, const G6Binning *bin);
+
+/* Parse "--out-dr=DR" or "--out-log=RMIN:PER_DECADE" into *bin.
+ * Returns 0 if arg is one of these and valid, non-zero otherwise.
+ */
+int g6_binning_parse(const char *arg, G6Binning *bin);
+
+/* Number of equal-work chunks g6accum_accumulate splits one snapshot's pairs
+ * into (default G6ACCUM_DEFAULT_CHUNKS; small snapshots get fewer). The chunks
+ * run on the default thread pool (tpool.h) and are summed in chunk order, so
+ * the result depends on the count but not on the pool size. Returns 0 on
+ * success.
+ */
+int g6accum_set_chunks(G6Accum *A, int nchunks);
+
 /* Accumulate one snapshot's contributions.
  * - coms: Vec2Array of M cluster COMs
  * - psi6: Complex array length M (psi6 at each COM)
@@ -24,6 +63,94 @@ void g6accum_accumulate(G6Accum *A,
                         double box_x,
                         double box_y);
 
+/* High-water bytes of chunk buffers the last g6accum_accumulate held on pool
+ * threads other than the caller. The caller's memacct thread counters do not
+ * see them; the pipeline adds them to the snapshot's g6 peak.
+ */
+size_t g6accum_helper_peak(const G6Accum *A);
+
+/* Hardware counts (perfctr.h, zero unless counting is on) of the chunks the
+ * last g6accum_accumulate ran on pool threads other than the caller, which
+ * the caller's own counters miss.
+ */
+void g6accum_helper_counts(const G6Accum *A, uint64_t v[PERFCTR_N]);
+
+/* Fine bin g6accum_accumulate puts a pair at squared distance r2 in (the
+ * r^2 edge-table lookup), growing the bins to cover it; -1 if r2 < 0.
+ * Exposed for the checks in tests/.
+ */
+int g6accum_bin_of_r2(G6Accum *A, double r2);
+
+/* Parameters of the Monte Carlo pair-sampling estimator (g6accum_accumulate_mc) */
+typedef struct {
+    double             tol;          /* target standard error of Re/Im g6 in every bin */
+    long               min_samples;  /* samples drawn in a bin before testing convergence */
+    long               max_samples;  /* per-bin sample cap (bins that never converge stop here) */
+    unsigned long long seed;         /* RNG seed; each call derives its own stream */
+    long               stream;       /* stream index (e.g. frame number); < 0: the number
+                                        of earlier MC snapshots on the accumulator */
+} G6MCParams;
+
+/* Per-snapshot report of g6accum_accumulate_mc */
+typedef struct {
+    long   samples;      /* pair samples drawn over all bins */
+    int    nbins;        /* bins with candidate pairs */
+    int    nbins_capped; /* bins stopped by max_samples before reaching tol */
+    double min_ess;      /* smallest effective sample count over bins with hits */
+    int    exact;        /* 1 if the snapshot was small enough to be done exactly */
+} G6MCStats;
+
+/* Defaults: tol 0.01, min 200, max 1e6 samples per bin, fixed seed, stream -1 */
+void g6accum_mc_defaults(G6MCParams *p);
+
+/* Monte Carlo variant of g6accum_accumulate.
+ * Pairs are sampled stratified by distance bin: a cell list of the COMs gives,
+ * per bin, the cell offsets that can hold pairs at that distance; a sample is
+ * (uniform i, uniform offset, uniform j in the offset cell) with importance
+ * weight (#offsets * cell occupancy). Per bin, the pair count and the ratio
+ * estimate of g6 are deposited so snapshots combine pair-weighted exactly as in
+ * the all-pairs path. Sampling in a bin stops once the standard errors of
+ * Re/Im g6 are below p->tol (or at p->max_samples). The Kish effective sample
+ * count is accumulated per fine bin (summed on rebinning) and written as an
+ * extra column.
+ * Snapshots with fewer pairs than the minimum sampling budget are done exactly.
+ * Returns 0 on success, non-zero on error; `st` may be NULL.
+ */
+int g6accum_accumulate_mc(G6Accum *A,
+                          const Vec2Array *coms,
+                          const Complex *psi6,
+                          bool use_pbc,
+                          double box_x,
+                          double box_y,
+                          const G6MCParams *p,
+                          G6MCStats *st);
+
+/* Add the sums of B (same dr and fine bins) into A; notes are not copied.
+ * Used to combine per-frame accumulators filled in parallel. Returns 0 on success.
+ */
+int g6accum_merge(G6Accum *A, const G6Accum *B);
+
+/* Independent copy of A: bins, sums, output binning and notes. NULL on OOM. */
+G6Accum *g6accum_clone(const G6Accum *A);
+
+/* Sums of the coarse bins (width dr, bin k covers [k, k+1) * dr), fine bins
+ * added up: re/im sums and pair counts of the first n bins (zeros past the
+ * recorded range). Returns the number of coarse bins recorded.
+ */
+int g6accum_coarse_sums(const G6Accum *A, int n, double *re, double *im, double *cnt);
+
+/* Zero all sums and MC counters of A, keeping its bins (for reuse after a merge) */
+void g6accum_clear(G6Accum *A);
+
+/* Attach a free-form line to the output header (written as "# <text>" after the
+ * standard header lines, in the order added). printf-style; returns 0 on success.
+ */
+int g6accum_add_note(G6Accum *A, const char *fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
 /* Write averaged g6 file:
  * - outpath: path to output file to create (filename, not directory)
  * - t0,t1: time index range used in header
@@ -38,4 +165,47 @@ int g6accum_write(G6Accum *A,
                   double box_x,
                   double box_y);
 
+/* Write the replica ensemble file: the pooled average P (as g6accum_write)
+ * with the spread of the nrep replica averages R[k] (same bins as P) as an
+ * error estimate. Columns:
+ *   r_center  Re  Im  |g6|  pair_count  err_Re  err_Im  err_|g6|  nrep
+ * where err_x is the standard deviation of x over the replicas with pairs in
+ * the bin divided by sqrt(nrep) (0 with fewer than two). Header notes of P are
+ * written. Returns 0 on success, non-zero on failure.
+ */
+int g6accum_write_ensemble(G6Accum *P,
+                           G6Accum *const *R,
+                           int nrep,
+                           const char *outpath,
+                           int t0, int t1,
+                           double lbond,
+                           bool use_pbc,
+                           double box_x,
+                           double box_y);
+
+/* Run metadata stored in a raw dump (header of the rebinned output) */
+typedef struct {
+    int    t0, t1;
+    double lbond;
+    bool   use_pbc;
+    double box_x, box_y;
+} G6RawMeta;
+
+/* Dump the fine-bin sums (full precision text) so the run can be rebinned
+ * later without reprocessing (g6accum_read_raw, g6_rebin tool).
+ * Returns 0 on success, non-zero on failure.
+ */
+int g6accum_write_raw(G6Accum *A,
+                      const char *outpath,
+                      int t0, int t1,
+                      double lbond,
+                      bool use_pbc,
+                      double box_x,
+                      double box_y);
+
+/* Load a raw dump into a new accumulator (header notes included).
+ * Fills *meta if non-NULL. Returns NULL on error; free with g6accum_free.
+ */
+G6Accum *g6accum_read_raw(const char *path, G6RawMeta *meta);
+
 #endif /* G6ACCUM_H */
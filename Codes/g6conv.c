@@ -0,0 +1,143 @@
+/*
+ * g6conv.c
+ *
+ * Block-error convergence monitor for the g6 run average (see g6conv.h).
+ */
+
+#include "g6conv.h"
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+struct G6Conv {
+    double  tol;
+    int     every;
+    int     k0, nb;           /* coarse bins k0 .. k0 + nb - 1 */
+    int     nall;             /* k0 + nb: bins read from each snapshot */
+    double *f_re, *f_im, *f_cnt;          /* one snapshot (nall) */
+    double *tot_re, *tot_im, *tot_cnt;    /* run sums (nb) */
+    double *blk;              /* per block and bin: re, im, cnt sums (3 nb per block) */
+    long    nblk, cap;        /* closed blocks, capacity in blocks */
+    int     open_n;           /* snapshots in the open block (its sums at blk[nblk]) */
+    int     failed;           /* out of memory: no more checks */
+    double *prev_re, *prev_im;            /* run mean at the previous check */
+    G6ConvReport rep;
+};
+
+G6Conv *g6conv_create(double tol, int every, double dr, double rmin, double rmax){
+    if(!(tol > 0.0) || every < 1 || !(dr > 0.0) || rmin < 0.0 || !(rmax > rmin)){
+        fprintf(stderr,"g6conv_create: invalid arguments\n");
+        return NULL;
+    }
+    G6Conv *C = (G6Conv*)mem_calloc(1, sizeof(G6Conv));
+    if(!C){ fprintf(stderr,"g6conv_create: OOM\n"); return NULL; }
+    C->tol = tol;
+    C->every = every;
+    C->k0 = (int)floor(rmin / dr);
+    C->nall = (int)ceil(rmax / dr);
+    if(C->nall <= C->k0) C->nall = C->k0 + 1;
+    C->nb = C->nall - C->k0;
+    const size_t nb = (size_t)C->nb, nall = (size_t)C->nall;
+    C->f_re = (double*)mem_malloc(3 * nall * sizeof(double));
+    C->tot_re = (double*)mem_calloc(3 * nb, sizeof(double));
+    C->prev_re = (double*)mem_calloc(2 * nb, sizeof(double));
+    C->cap = 16;
+    C->blk = (double*)mem_calloc((size_t)C->cap * 3 * nb, sizeof(double));
+    if(!C->f_re || !C->tot_re || !C->prev_re || !C->blk){
+        fprintf(stderr,"g6conv_create: OOM\n");
+        g6conv_free(C);
+        return NULL;
+    }
+    C->f_im = C->f_re + nall;
+    C->f_cnt = C->f_im + nall;
+    C->tot_im = C->tot_re + nb;
+    C->tot_cnt = C->tot_im + nb;
+    C->prev_im = C->prev_re + nb;
+    return C;
+}
+
+void g6conv_free(G6Conv *C){
+    if(!C) return;
+    mem_free(C->f_re);
+    mem_free(C->tot_re);
+    mem_free(C->prev_re);
+    mem_free(C->blk);
+    mem_free(C);
+}
+
+/* Check the closed blocks: fills the error/change maxima, returns 1 if converged */
+static int g6conv_check(G6Conv *C){
+    const int nb = C->nb;
+    double max_err = 0.0, max_change = 0.0;
+    int ok = C->nblk >= G6CONV_MIN_BLOCKS && C->rep.checks > 0;
+    for(int k=0;k<nb;k++){
+        if(C->tot_cnt[k] <= 0.0) continue;     /* no pairs at this r */
+        const double mre = C->tot_re[k] / C->tot_cnt[k], mim = C->tot_im[k] / C->tot_cnt[k];
+        const double mag = sqrt(mre*mre + mim*mim);
+
+        /* scatter of the block means around the run mean */
+        double ss = 0.0;
+        long n = 0;
+        for(long b=0;b<C->nblk;b++){
+            const double *B = C->blk + (size_t)b * 3 * nb;
+            if(B[2*nb + k] <= 0.0) continue;
+            const double dre = B[k] / B[2*nb + k] - mre, dim = B[nb + k] / B[2*nb + k] - mim;
+            ss += dre*dre + dim*dim;
+            n++;
+        }
+        const double err = n > 1 ? sqrt(ss / ((double)(n - 1) * (double)n)) : INFINITY;
+        const double dre = mre - C->prev_re[k], dim = mim - C->prev_im[k];
+        const double change = sqrt(dre*dre + dim*dim);
+        const double rel_err = mag > 0.0 ? err / mag : INFINITY;
+        const double rel_change = mag > 0.0 ? change / mag : INFINITY;
+        if(rel_err > max_err) max_err = rel_err;
+        if(rel_change > max_change) max_change = rel_change;
+        C->prev_re[k] = mre;
+        C->prev_im[k] = mim;
+    }
+    C->rep.checks++;
+    C->rep.max_err = max_err;
+    C->rep.max_change = max_change;
+    return ok && max_err < C->tol && max_change < C->tol;
+}
+
+int g6conv_add(G6Conv *C, const G6Accum *frame){
+    const int nb = C->nb;
+    C->rep.frames++;
+    if(C->failed) return C->rep.converged;
+    g6accum_coarse_sums(frame, C->nall, C->f_re, C->f_im, C->f_cnt);
+    double *B = C->blk + (size_t)C->nblk * 3 * nb;
+    for(int k=0;k<nb;k++){
+        const int q = C->k0 + k;
+        B[k] += C->f_re[q];
+        B[nb + k] += C->f_im[q];
+        B[2*nb + k] += C->f_cnt[q];
+        C->tot_re[k] += C->f_re[q];
+        C->tot_im[k] += C->f_im[q];
+        C->tot_cnt[k] += C->f_cnt[q];
+    }
+    if(++C->open_n < C->every) return C->rep.converged;
+
+    /* close the block and make room for the next one */
+    C->open_n = 0;
+    C->nblk++;
+    if(C->nblk == C->cap){
+        double *nbk = (double*)mem_realloc(C->blk, (size_t)C->cap * 2 * 3 * nb * sizeof(double));
+        if(!nbk){
+            fprintf(stderr,"g6conv_add: OOM, convergence no longer checked\n");
+            C->failed = 1;
+            return C->rep.converged;
+        }
+        memset(nbk + (size_t)C->cap * 3 * nb, 0, (size_t)C->cap * 3 * nb * sizeof(double));
+        C->blk = nbk;
+        C->cap *= 2;
+    }
+    if(!C->rep.converged && g6conv_check(C)) C->rep.converged = 1;
+    return C->rep.converged;
+}
+
+void g6conv_report(const G6Conv *C, G6ConvReport *r){
+    *r = C->rep;
+}
@@ -0,0 +1,44 @@
+#ifndef G6CONV_H
+#define G6CONV_H
+
+#include "g6accum.h"
+
+/*
+ * G6Conv
+ *
+ * Convergence monitor for the run average of g6(r). Snapshots are fed in
+ * order; every `every` snapshots close a block, and at each block end the
+ * coarse bins (width dr) with r in [rmin, rmax) are checked:
+ *   - relative block error: standard error of the run mean of g6 from the
+ *     scatter of the block means, over |mean|
+ *   - relative change of the run mean since the previous check
+ * The average has converged when both are below tol in every bin of the
+ * range that has pairs, with at least G6CONV_MIN_BLOCKS blocks. Bins where
+ * g6 has decayed to noise never converge in relative terms, so the range
+ * should stop short of them.
+ */
+typedef struct G6Conv G6Conv;
+
+/* Blocks needed before the block error is trusted */
+#define G6CONV_MIN_BLOCKS 4
+
+/* Returns NULL on invalid arguments or OOM */
+G6Conv *g6conv_create(double tol, int every, double dr, double rmin, double rmax);
+void g6conv_free(G6Conv *C);
+
+/* Add the next snapshot's sums. Returns 1 once the average has converged
+   (checked at block ends), 0 otherwise. */
+int g6conv_add(G6Conv *C, const G6Accum *frame);
+
+/* State of the last check */
+typedef struct {
+    long   frames;        /* snapshots added */
+    int    converged;     /* 1 if a check passed */
+    long   checks;        /* block ends checked */
+    double max_err;       /* largest relative block error over the range */
+    double max_change;    /* largest relative change of the mean over the range */
+} G6ConvReport;
+
+void g6conv_report(const G6Conv *C, G6ConvReport *r);
+
+#endif /* G6CONV_H */
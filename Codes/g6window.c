@@ -0,0 +1,104 @@
+/*
+ * g6window.c
+ *
+ * Windowed g6 averages from one pass (see g6window.h).
+ */
+
+#include "g6window.h"
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+struct G6Window {
+    int       width, stride;
+    int       nslots;         /* windows open at once: ceil(width / stride) */
+    G6Accum **slot;           /* open windows, window k sums into slot k % nslots */
+    int      *slot_t0;        /* time index of each open window's first snapshot */
+    long      nadded;         /* snapshots added */
+    G6Accum  *sum;            /* last completed window */
+    int       sum_t0, sum_t1;
+    int       pending;        /* snapshots since the last window */
+};
+
+static G6Accum *g6window_new_accum(double dr, int subdiv, const G6Binning *bin){
+    G6Accum *A = g6accum_create_fine(dr, subdiv);
+    if(A && bin && g6accum_set_binning(A, bin) != 0){
+        g6accum_free(A);
+        return NULL;
+    }
+    return A;
+}
+
+G6Window *g6window_create(int width, int stride, double dr, int subdiv, const G6Binning *bin){
+    if(width < 1 || stride < 1){
+        fprintf(stderr,"g6window_create: invalid width %d / stride %d\n", width, stride);
+        return NULL;
+    }
+    G6Window *W = (G6Window*)mem_calloc(1, sizeof(G6Window));
+    if(!W){ fprintf(stderr,"g6window_create: OOM\n"); return NULL; }
+    W->width = width;
+    W->stride = stride;
+    W->nslots = (width + stride - 1) / stride;
+    W->slot = (G6Accum**)mem_calloc((size_t)W->nslots, sizeof(G6Accum*));
+    W->slot_t0 = (int*)mem_calloc((size_t)W->nslots, sizeof(int));
+    int ok = W->slot && W->slot_t0;
+    for(int k=0;ok && k<W->nslots;k++) ok = (W->slot[k] = g6window_new_accum(dr, subdiv, bin)) != NULL;
+    ok = ok && (W->sum = g6window_new_accum(dr, subdiv, bin)) != NULL;
+    if(!ok){
+        fprintf(stderr,"g6window_create: failed to create accumulators\n");
+        g6window_free(W);
+        return NULL;
+    }
+    return W;
+}
+
+void g6window_free(G6Window *W){
+    if(!W) return;
+    if(W->slot)
+        for(int k=0;k<W->nslots;k++) g6accum_free(W->slot[k]);
+    mem_free(W->slot);
+    mem_free(W->slot_t0);
+    g6accum_free(W->sum);
+    mem_free(W);
+}
+
+int g6window_add(G6Window *W, const G6Accum *frame, int tindex){
+    /* window k holds snapshots k*stride .. k*stride + width - 1 */
+    const long n = W->nadded++;
+    const long k1 = n / W->stride;
+    long k0 = n - W->width + 1;
+    k0 = k0 > 0 ? (k0 + W->stride - 1) / W->stride : 0;
+    if(n % W->stride == 0){
+        /* window k1 starts; its slot was last used by window k1 - nslots,
+           which ended before this snapshot */
+        const int s = (int)(k1 % W->nslots);
+        g6accum_clear(W->slot[s]);
+        W->slot_t0[s] = tindex;
+    }
+    /* each window is summed snapshot by snapshot from zero, in the order a
+       separate run over it would merge them, so its sums are bit-identical */
+    for(long k=k0;k<=k1;k++)
+        if(g6accum_merge(W->slot[k % W->nslots], frame) != 0) return -1;
+    W->pending++;
+
+    /* windows end after width, width + stride, width + 2 stride, ... snapshots */
+    const long end = n + 1 - W->width;
+    if(end < 0 || end % W->stride != 0) return 0;
+    const int s = (int)((end / W->stride) % W->nslots);
+    g6accum_clear(W->sum);
+    if(g6accum_merge(W->sum, W->slot[s]) != 0) return -1;
+    W->sum_t0 = W->slot_t0[s];
+    W->sum_t1 = tindex;
+    W->pending = 0;
+    return 1;
+}
+
+G6Accum *g6window_sum(G6Window *W, int *t0, int *t1){
+    if(t0) *t0 = W->sum_t0;
+    if(t1) *t1 = W->sum_t1;
+    return W->sum;
+}
+
+int g6window_pending(const G6Window *W){
+    return W->pending;
+}
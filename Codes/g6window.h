@@ -0,0 +1,43 @@
+#ifndef G6WINDOW_H
+#define G6WINDOW_H
+
+#include "g6accum.h"
+
+/*
+ * G6Window
+ *
+ * g6 averaged over windows of `width` consecutive snapshots, a new window
+ * starting every `stride` snapshots (stride == width: fixed, non-overlapping
+ * windows; stride < width: sliding windows; stride > width: windows with
+ * gaps). Snapshots are fed once, in order; each is merged into every window
+ * open at it, each window into its own accumulator, so every window of the
+ * run comes out of a single pass at the cost of ceil(width / stride) + 1
+ * accumulators. A window's sums are built snapshot by snapshot in order, so
+ * they are bit-identical to those of a separate run over its snapshots.
+ */
+typedef struct G6Window G6Window;
+
+/* Accumulators use dr / subdiv fine bins and the output binning bin (NULL:
+   uniform dr). Returns NULL on error. */
+G6Window *g6window_create(int width, int stride, double dr, int subdiv, const G6Binning *bin);
+void g6window_free(G6Window *W);
+
+/*
+ * g6window_add
+ *
+ * Add the next snapshot's sums (frame is not modified); tindex is its time
+ * index, for the window labels. Returns 1 when a window ends with this
+ * snapshot (see g6window_sum), 0 otherwise, and -1 on error.
+ */
+int g6window_add(G6Window *W, const G6Accum *frame, int tindex);
+
+/* The window completed by the last g6window_add that returned 1, with the
+   time indices of its first and last snapshot. Notes added to the returned
+   accumulator are kept for every later window. */
+G6Accum *g6window_sum(G6Window *W, int *t0, int *t1);
+
+/* Snapshots added since the last completed window (0 after a full run of
+   windows; the tail of a run that does not fill a window is not written) */
+int g6window_pending(const G6Window *W);
+
+#endif /* G6WINDOW_H */
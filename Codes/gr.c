@@ -0,0 +1,155 @@
+/*
+ * gr.c
+ *
+ * g(r) of cluster COMs (see gr.h).
+ */
+
+#include "gr.h"
+#include "memacct.h"
+#include "celllist.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct GrAccum {
+    double  dr, rmax;
+    int     nbins;
+    double *g_sum;        /* sum over snapshots of normalized g(r) */
+    double *pair_count;   /* pairs per bin over all snapshots */
+    long    frames;
+};
+
+GrAccum *gr_create(double dr, double rmax){
+    if(!(dr > 0.0) || !(rmax > dr)){
+        fprintf(stderr,"gr_create: invalid dr %g / rmax %g\n", dr, rmax);
+        return NULL;
+    }
+    GrAccum *G = (GrAccum*)mem_calloc(1, sizeof(GrAccum));
+    if(!G){ fprintf(stderr,"gr_create: OOM\n"); return NULL; }
+    /* whole bins only, so the last shell is not cut short */
+    G->dr = dr;
+    G->nbins = (int)floor(rmax / dr);
+    G->rmax = G->nbins * dr;
+    G->g_sum = (double*)mem_calloc((size_t)G->nbins, sizeof(double));
+    G->pair_count = (double*)mem_calloc((size_t)G->nbins, sizeof(double));
+    if(!G->g_sum || !G->pair_count){
+        fprintf(stderr,"gr_create: OOM\n");
+        gr_free(G);
+        return NULL;
+    }
+    return G;
+}
+
+void gr_free(GrAccum *G){
+    if(!G) return;
+    mem_free(G->g_sum);
+    mem_free(G->pair_count);
+    mem_free(G);
+}
+
+int gr_accumulate(GrAccum *G, const Vec2Array *coms, bool use_pbc, double box_x, double box_y){
+    if(!G || !coms || box_x <= 0.0 || box_y <= 0.0){
+        fprintf(stderr,"gr_accumulate: invalid arguments\n");
+        return 1;
+    }
+    const int N = (int)coms->n;
+    if(N < 2) return 0;
+
+    CellList cl;
+    if(celllist_build(&cl, coms, G->rmax, use_pbc, box_x, box_y) != 0) return 2;
+    uint64_t *cnt = (uint64_t*)mem_calloc((size_t)G->nbins, sizeof(uint64_t));
+    IntArray cand;
+    ia_init(&cand);
+    if(!cnt){
+        fprintf(stderr,"gr_accumulate: OOM\n");
+        celllist_free(&cl);
+        return 2;
+    }
+
+    const double rmax2 = G->rmax * G->rmax, inv_dr = 1.0 / G->dr;
+    int ring = 1;
+    for(int i=0;i<N;i++){
+        const double xi = coms->data[i].x, yi = coms->data[i].y;
+        cand.n = 0;
+        while(celllist_gather(&cl, xi, yi, ring, &cand) < G->rmax){
+            ring++;
+            cand.n = 0;
+        }
+        for(size_t k=0;k<cand.n;k++){
+            const int j = cand.data[k];
+            if(j <= i) continue;
+            double dx = coms->data[j].x - xi, dy = coms->data[j].y - yi;
+            if(use_pbc){
+                dx = mic_delta(dx, box_x);
+                dy = mic_delta(dy, box_y);
+            }
+            const double r2 = dx*dx + dy*dy;
+            if(r2 >= rmax2) continue;
+            int b = (int)(sqrt(r2) * inv_dr);
+            if(b >= G->nbins) b = G->nbins - 1;
+            cnt[b]++;
+        }
+    }
+
+    /* normalize by the ideal-gas pair count of each shell */
+    const double npairs = 0.5 * (double)N * (double)(N - 1), area = box_x * box_y;
+    for(int b=0;b<G->nbins;b++){
+        const double r0 = b * G->dr, r1 = (b + 1) * G->dr;
+        const double ideal = npairs * M_PI * (r1*r1 - r0*r0) / area;
+        G->g_sum[b] += (double)cnt[b] / ideal;
+        G->pair_count[b] += (double)cnt[b];
+    }
+    G->frames++;
+
+    mem_free(cnt);
+    ia_free(&cand);
+    celllist_free(&cl);
+    return 0;
+}
+
+int gr_merge(GrAccum *A, const GrAccum *B){
+    if(!A || !B || A->nbins != B->nbins || A->dr != B->dr){
+        fprintf(stderr,"gr_merge: incompatible accumulators\n");
+        return 1;
+    }
+    for(int b=0;b<A->nbins;b++){
+        A->g_sum[b] += B->g_sum[b];
+        A->pair_count[b] += B->pair_count[b];
+    }
+    A->frames += B->frames;
+    return 0;
+}
+
+void gr_clear(GrAccum *G){
+    memset(G->g_sum, 0, (size_t)G->nbins * sizeof(double));
+    memset(G->pair_count, 0, (size_t)G->nbins * sizeof(double));
+    G->frames = 0;
+}
+
+int gr_write(const GrAccum *G, const char *outpath, int t0, int t1,
+             bool use_pbc, double box_x, double box_y){
+    if(!G || !outpath){ fprintf(stderr,"gr_write: invalid args\n"); return 1; }
+    FILE *f = fopen(outpath, "w");
+    if(!f){
+        fprintf(stderr,"gr_write: cannot open %s: %s\n", outpath, strerror(errno));
+        return 2;
+    }
+    fprintf(f, "# Averaged g(r) of cluster COMs over snapshots time_%d .. time_%d\n", t0, t1);
+    fprintf(f, "# Columns: r_center  g(r)  pair_count\n");
+    fprintf(f, "# Params: dr = %.8g  rmax = %.8g  USE_PBC = %s\n", G->dr, G->rmax, use_pbc ? "true" : "false");
+    fprintf(f, "# Box dims: %.8g x %.8g (density normalization)\n", box_x, box_y);
+    fprintf(f, "# Snapshots: %ld\n", G->frames);
+    for(int b=0;b<G->nbins;b++){
+        const double g = G->frames > 0 ? G->g_sum[b] / (double)G->frames : 0.0;
+        fprintf(f, "%.8f %.10e %.0f\n", (b + 0.5) * G->dr, g, G->pair_count[b]);
+    }
+    fclose(f);
+    return 0;
+}
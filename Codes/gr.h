@@ -0,0 +1,43 @@
+#ifndef GR_H
+#define GR_H
+
+#include "utils.h"
+#include <stdbool.h>
+
+/*
+ * GrAccum
+ *
+ * Radial distribution function g(r) of the cluster COMs, averaged over
+ * snapshots: each snapshot's pair histogram (bins of width dr up to rmax) is
+ * normalized by the ideal-gas count N(N-1)/2 * shell area / box area, and
+ * the averages of those are written. Pairs are found with a cell list, so a
+ * snapshot costs about as much as its pairs closer than rmax.
+ */
+typedef struct GrAccum GrAccum;
+
+/* Bins of width dr on [0, rmax), rmax rounded down to whole bins.
+   Returns NULL on invalid arguments or OOM. */
+GrAccum *gr_create(double dr, double rmax);
+void gr_free(GrAccum *G);
+
+/*
+ * gr_accumulate
+ *
+ * Add one snapshot. The box area normalizes the density with and without PBC
+ * (without PBC, g(r) then falls off near the edges of the sample).
+ * Returns 0 on success.
+ */
+int gr_accumulate(GrAccum *G, const Vec2Array *coms, bool use_pbc, double box_x, double box_y);
+
+/* Add B's snapshots to A (same dr and rmax). Returns 0 on success. */
+int gr_merge(GrAccum *A, const GrAccum *B);
+
+/* Reset to no snapshots */
+void gr_clear(GrAccum *G);
+
+/* Write "r_center g(r) pair_count" with a header like the g6 output.
+   Returns 0 on success. */
+int gr_write(const GrAccum *G, const char *outpath, int t0, int t1,
+             bool use_pbc, double box_x, double box_y);
+
+#endif /* GR_H */
@@ -1,10 +1,42 @@
+#define _GNU_SOURCE
+
 #include "io.h"
+#include "memacct.h"
+#include "tpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Bytes per chunk of the parallel parse (parse_snapshot_xy); smaller
+   buffers are parsed serially */
+#ifndef IO_PARSE_CHUNK
+#define IO_PARSE_CHUNK (4u << 20)
+#endif
+
+/* The fgets loop, for files that cannot be mapped (pipes, special files) */
+static void read_stream_xy(FILE *fp, Vec2Array *pos)
+{
+    char line[4096];
+    while(fgets(line, sizeof(line), fp)){
+        /* skip comments and blank lines */
+        if(line[0] == '#' || line[0] == '\n') continue;
+
+        double x, y, z;
+        if(sscanf(line, "%lf %lf  %lf", &x, &y , &z) == 3){
+            v2a_push(pos, (Vec2){x, y});
+        }
+        /* else ignore malformed lines */
+    }
+}
 
 /* --------------------- read_snapshot_xy --------------------- */
+/* Regular files are mapped and handed to parse_snapshot_xy (chunks in
+   parallel on the default pool); anything else is read line by line */
 int read_snapshot_xy(const char *path, Vec2Array *pos)
 {
     if(!path || !pos){
@@ -12,28 +44,162 @@ int read_snapshot_xy(const char *path, Vec2Array *pos)
         return 0;
     }
 
-    FILE *fp = fopen(path, "r");
-    if(!fp){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
         fprintf(stderr, "read_snapshot_xy: cannot open %s\n", path);
         return 0;
     }
 
     // v2a_init(pos);
 
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)){
+        if(st.st_size == 0){ close(fd); return 1; }
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED){
+            close(fd);
+            madvise(map, (size_t)st.st_size, MADV_WILLNEED);
+            int ok = parse_snapshot_xy((const char*)map, (size_t)st.st_size, pos);
+            munmap(map, (size_t)st.st_size);
+            return ok;
+        }
+    }
+
+    FILE *fp = fdopen(fd, "r");
+    if(!fp){
+        fprintf(stderr, "read_snapshot_xy: cannot open %s\n", path);
+        close(fd);
+        return 0;
+    }
+    read_stream_xy(fp, pos);
+    fclose(fp);
+    return 1;
+}
+
+/* --------------------- read_file_bytes ------------------------ */
+int read_file_bytes(const char *path, char **buf, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if(!fp){
+        fprintf(stderr, "read_file_bytes: cannot open %s\n", path);
+        return 0;
+    }
+    long size = -1;
+    if(fseek(fp, 0, SEEK_END) == 0) size = ftell(fp);
+    if(size < 0 || fseek(fp, 0, SEEK_SET) != 0){
+        fprintf(stderr, "read_file_bytes: cannot size %s\n", path);
+        fclose(fp);
+        return 0;
+    }
+    char *b = (char*)mem_malloc((size_t)size + 1);
+    if(!b){
+        fprintf(stderr, "read_file_bytes: OOM\n");
+        fclose(fp);
+        return 0;
+    }
+    size_t got = fread(b, 1, (size_t)size, fp);
+    fclose(fp);
+    if(got != (size_t)size){
+        fprintf(stderr, "read_file_bytes: short read on %s\n", path);
+        mem_free(b);
+        return 0;
+    }
+    b[got] = '\0';
+    *buf = b;
+    *len = got;
+    return 1;
+}
+
+/* --------------------- parse_snapshot_xy ---------------------- */
+static void parse_lines_xy(const char *buf, size_t len, Vec2Array *pos)
+{
+    /* cut lines exactly as fgets does into read_stream_xy's buffer */
     char line[4096];
-    while(fgets(line, sizeof(line), fp)){
-        /* skip comments and blank lines */
+    size_t p = 0;
+    while(p < len){
+        size_t n = len - p < sizeof(line) - 1 ? len - p : sizeof(line) - 1;
+        const char *nl = (const char*)memchr(buf + p, '\n', n);
+        if(nl) n = (size_t)(nl - (buf + p)) + 1;
+        memcpy(line, buf + p, n);
+        line[n] = '\0';
+        p += n;
+
         if(line[0] == '#' || line[0] == '\n') continue;
 
         double x, y, z;
         if(sscanf(line, "%lf %lf  %lf", &x, &y , &z) == 3){
             v2a_push(pos, (Vec2){x, y});
         }
-        /* else ignore malformed lines */
     }
+}
 
-    fclose(fp);
-    return 1;
+typedef struct {
+    const char *buf;
+    const size_t *start;      /* chunk c is buf[start[c] .. start[c+1]) */
+    Vec2Array  *out;          /* points of each chunk */
+} ParseJob;
+
+static void parse_chunk_task(void *ctx, int c)
+{
+    const ParseJob *J = (const ParseJob*)ctx;
+    parse_lines_xy(J->buf + J->start[c], J->start[c+1] - J->start[c], &J->out[c]);
+}
+
+/* Chunks start right after a newline, where fgets starts a new line too, so
+   every chunk sees the lines (and the 4095-byte pieces of long lines) the
+   serial parse sees; their points are appended in chunk order. */
+int parse_snapshot_xy(const char *buf, size_t len, Vec2Array *pos)
+{
+    const size_t nch = len / IO_PARSE_CHUNK;
+    if(nch < 2 || tpool_size(NULL) < 2){
+        parse_lines_xy(buf, len, pos);
+        return 1;
+    }
+
+    size_t *start = (size_t*)malloc((nch + 1) * sizeof(size_t));
+    Vec2Array *out = (Vec2Array*)malloc(nch * sizeof(Vec2Array));
+    if(!start || !out){
+        free(start);
+        free(out);
+        parse_lines_xy(buf, len, pos);
+        return 1;
+    }
+    start[0] = 0;
+    for(size_t c=1;c<nch;c++){
+        size_t p = c * (len / nch);
+        if(p < start[c-1]) p = start[c-1];
+        const char *nl = p < len ? (const char*)memchr(buf + p, '\n', len - p) : NULL;
+        start[c] = nl ? (size_t)(nl - buf) + 1 : len;
+    }
+    start[nch] = len;
+    for(size_t c=0;c<nch;c++) v2a_init(&out[c]);
+
+    ParseJob J = { buf, start, out };
+    tpool_run(NULL, (int)nch, parse_chunk_task, &J);
+
+    size_t total = pos->n;
+    for(size_t c=0;c<nch;c++) total += out[c].n;
+    int ok = 1;
+    if(total > pos->cap){
+        Vec2 *tmp = (Vec2*)mem_realloc(pos->data, total * sizeof(Vec2));
+        if(tmp){
+            pos->data = tmp;
+            pos->cap = total;
+        } else {
+            fprintf(stderr, "parse_snapshot_xy: OOM\n");
+            ok = 0;
+        }
+    }
+    for(size_t c=0;c<nch;c++){
+        if(ok && out[c].n > 0){
+            memcpy(pos->data + pos->n, out[c].data, out[c].n * sizeof(Vec2));
+            pos->n += out[c].n;
+        }
+        v2a_free(&out[c]);
+    }
+    free(start);
+    free(out);
+    return ok;
 }
 
 /* --------------------- extract_time_index --------------------- */
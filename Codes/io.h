@@ -9,6 +9,8 @@
  * Reads an ASCII snapshot file containing at least two columns: x y
  * Extra columns are ignored.
  * Lines starting with '#' or blank lines are skipped.
+ * Regular files are mapped and parsed with parse_snapshot_xy (in parallel
+ * chunks when large).
  *
  * On success:
  *   - fills Vec2Array *pos (must be uninitialized; function will call v2a_init)
@@ -21,6 +23,26 @@
  */
 int read_snapshot_xy(const char *path, Vec2Array *pos);
 
+/*
+ * read_file_bytes
+ *
+ * Reads a whole file into a mem_malloc'd buffer (*buf, *len; release with
+ * mem_free). Returns 1 on success, 0 on failure.
+ */
+int read_file_bytes(const char *path, char **buf, size_t *len);
+
+/*
+ * parse_snapshot_xy
+ *
+ * read_snapshot_xy on a file already in memory (len bytes, need not be
+ * NUL-terminated): same line rules, same result. Buffers of several
+ * IO_PARSE_CHUNK (4 MB) are cut at newlines into chunks that are parsed in
+ * parallel on the default thread pool and appended in order, so the points
+ * are identical to a serial parse. Returns 1, or 0 if the chunks could not
+ * be joined (OOM).
+ */
+int parse_snapshot_xy(const char *buf, size_t len, Vec2Array *pos);
+
 /*
  * extract_time_index
  *
@@ -0,0 +1,458 @@
+/*
+ * loader.c
+ *
+ * io_uring whole-file loader (see loader.h). Each file goes
+ *
+ *   IDLE -> OPENING (IORING_OP_OPENAT) -> READING (IORING_OP_READ, repeated
+ *   on short reads) -> READY -> TAKEN
+ *
+ * with FAILED for errors. Only the I/O thread submits and reaps; the state,
+ * the want queue and the counters are shared under L->lock. The fstat that
+ * sizes the buffer and the close are plain syscalls on the I/O thread, as are
+ * the plain reads of the fallback (made without the lock).
+ */
+
+#define _GNU_SOURCE
+
+#include "loader.h"
+#include "io.h"
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LOADER_HAVE_URING 1
+#endif
+#endif
+#endif
+
+#ifdef LOADER_HAVE_URING
+
+enum { LF_IDLE, LF_OPENING, LF_READING, LF_READY, LF_FAILED, LF_TAKEN };
+
+typedef struct {
+    int     state;
+    int     fd;
+    char   *buf;
+    size_t  size, got;
+    int     wanted;           /* in the want queue */
+    char   *lost;             /* buffer left to the kernel when the ring broke */
+} LFile;
+
+struct FileLoader {
+    /* ring */
+    int       ring_fd;
+    void     *sq_ptr, *cq_ptr;
+    size_t    sq_sz, cq_sz;
+    struct io_uring_sqe *sqes;
+    size_t    sqes_sz;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    /* files */
+    char *const *paths;
+    size_t    n;
+    LFile    *f;
+    int       depth;
+    size_t    next;           /* next file of the in-order prefetch */
+    size_t   *want;           /* files asked for before they were started */
+    size_t    nwant;
+    int       inflight;       /* OPENING + READING */
+    int       ready;          /* READY, not yet taken */
+    long      n_uring, n_fallback;
+    int       stop;
+    int       broken;         /* io_uring_enter failed: plain reads from then on */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cv;
+};
+
+static int lo_setup(unsigned entries, struct io_uring_params *p){
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int lo_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int lo_ring_init(FileLoader *L, unsigned entries){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    L->ring_fd = lo_setup(entries, &p);
+    if(L->ring_fd < 0){
+        fprintf(stderr,"loader_open: io_uring_setup failed: %s\n", strerror(errno));
+        return 1;
+    }
+    L->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    L->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    const int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single){
+        if(L->cq_sz > L->sq_sz) L->sq_sz = L->cq_sz;
+        L->cq_sz = L->sq_sz;
+    }
+    L->sq_ptr = mmap(NULL, L->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, L->ring_fd, IORING_OFF_SQ_RING);
+    if(L->sq_ptr == MAP_FAILED){ L->sq_ptr = NULL; goto fail; }
+    if(single){
+        L->cq_ptr = L->sq_ptr;
+    } else {
+        L->cq_ptr = mmap(NULL, L->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, L->ring_fd, IORING_OFF_CQ_RING);
+        if(L->cq_ptr == MAP_FAILED){ L->cq_ptr = NULL; goto fail; }
+    }
+    L->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    L->sqes = (struct io_uring_sqe*)mmap(NULL, L->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                         L->ring_fd, IORING_OFF_SQES);
+    if(L->sqes == MAP_FAILED){ L->sqes = NULL; goto fail; }
+
+    char *sq = (char*)L->sq_ptr, *cq = (char*)L->cq_ptr;
+    L->sq_head = (unsigned*)(sq + p.sq_off.head);
+    L->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    L->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    L->sq_array = (unsigned*)(sq + p.sq_off.array);
+    L->cq_head = (unsigned*)(cq + p.cq_off.head);
+    L->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    L->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    L->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    fprintf(stderr,"loader_open: cannot map the io_uring rings: %s\n", strerror(errno));
+    return 1;
+}
+
+static void lo_ring_free(FileLoader *L){
+    if(L->sqes) munmap(L->sqes, L->sqes_sz);
+    if(L->cq_ptr && L->cq_ptr != L->sq_ptr) munmap(L->cq_ptr, L->cq_sz);
+    if(L->sq_ptr) munmap(L->sq_ptr, L->sq_sz);
+    if(L->ring_fd >= 0) close(L->ring_fd);
+}
+
+/* Next free SQE, zeroed (there is at most one SQE per file in flight and the
+   ring has depth entries, so it never runs out) */
+static struct io_uring_sqe *lo_sqe(FileLoader *L, size_t k, int opcode){
+    const unsigned tail = *L->sq_tail, idx = tail & *L->sq_mask;
+    struct io_uring_sqe *s = &L->sqes[idx];
+    memset(s, 0, sizeof(*s));
+    s->opcode = (unsigned char)opcode;
+    s->user_data = (unsigned long long)k;
+    L->sq_array[idx] = idx;
+    __atomic_store_n(L->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return s;
+}
+
+/* SQEs queued but not yet consumed by the kernel */
+static unsigned lo_pending(const FileLoader *L){
+    return *L->sq_tail - __atomic_load_n(L->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/* Hand the completions so far to fn (L->lock held by the caller if needed) */
+static void lo_reap(FileLoader *L, void (*fn)(FileLoader *L, size_t k, int res)){
+    unsigned head = *L->cq_head;
+    const unsigned tail = __atomic_load_n(L->cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail){
+        const struct io_uring_cqe *c = &L->cqes[head & *L->cq_mask];
+        fn(L, (size_t)c->user_data, c->res);
+        head++;
+    }
+    __atomic_store_n(L->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void lo_submit_open(FileLoader *L, size_t k){
+    struct io_uring_sqe *s = lo_sqe(L, k, IORING_OP_OPENAT);
+    s->fd = AT_FDCWD;
+    s->addr = (unsigned long long)(uintptr_t)L->paths[k];
+    s->open_flags = O_RDONLY | O_CLOEXEC;
+}
+
+static void lo_submit_read(FileLoader *L, size_t k){
+    LFile *F = &L->f[k];
+    struct io_uring_sqe *s = lo_sqe(L, k, IORING_OP_READ);
+    s->fd = F->fd;
+    s->addr = (unsigned long long)(uintptr_t)(F->buf + F->got);
+    s->len = (unsigned)(F->size - F->got);
+    s->off = F->got;
+}
+
+/* File k is done (L->lock held): publish it and wake the takers */
+static void lo_finish(FileLoader *L, size_t k, int ok){
+    LFile *F = &L->f[k];
+    if(F->fd >= 0){ close(F->fd); F->fd = -1; }
+    if(ok){
+        F->buf[F->got] = '\0';
+        F->state = LF_READY;
+        L->ready++;
+    } else {
+        mem_free(F->buf);
+        F->buf = NULL;
+        F->state = LF_FAILED;
+    }
+    L->inflight--;
+    pthread_cond_broadcast(&L->cv);
+}
+
+/* The kernel rejected an operation: read file k the plain way (L->lock held,
+   released around the read so takers of other files are not held up; only
+   the I/O thread touches a file that is OPENING or READING, and the ring) */
+static void lo_fallback(FileLoader *L, size_t k){
+    LFile *F = &L->f[k];
+    if(F->fd >= 0){ close(F->fd); F->fd = -1; }
+    mem_free(F->buf);
+    F->buf = NULL;
+    F->got = 0;
+    char *buf = NULL;
+    size_t len = 0;
+    pthread_mutex_unlock(&L->lock);
+    const int ok = read_file_bytes(L->paths[k], &buf, &len);
+    pthread_mutex_lock(&L->lock);
+    F->buf = buf;
+    F->got = len;
+    L->n_fallback++;
+    lo_finish(L, k, ok);
+}
+
+/* One completion (L->lock held) */
+static void lo_complete(FileLoader *L, size_t k, int res){
+    LFile *F = &L->f[k];
+    if(F->state == LF_OPENING){
+        if(res == -EINVAL || res == -EOPNOTSUPP || res == -ENOSYS){ lo_fallback(L, k); return; }
+        if(res < 0){
+            fprintf(stderr,"loader: cannot open %s: %s\n", L->paths[k], strerror(-res));
+            lo_finish(L, k, 0);
+            return;
+        }
+        F->fd = res;
+        struct stat st;
+        if(fstat(F->fd, &st) != 0 || st.st_size < 0){
+            fprintf(stderr,"loader: cannot size %s\n", L->paths[k]);
+            lo_finish(L, k, 0);
+            return;
+        }
+        F->size = (size_t)st.st_size;
+        F->got = 0;
+        F->buf = (char*)mem_malloc(F->size + 1);
+        if(!F->buf){
+            fprintf(stderr,"loader: OOM\n");
+            lo_finish(L, k, 0);
+            return;
+        }
+        F->state = LF_READING;
+        if(F->size == 0){ lo_finish(L, k, 1); return; }
+        lo_submit_read(L, k);
+        return;
+    }
+    /* LF_READING */
+    if(res == -EINVAL || res == -EOPNOTSUPP || res == -ENOSYS){ lo_fallback(L, k); return; }
+    if(res < 0){
+        fprintf(stderr,"loader: read error on %s: %s\n", L->paths[k], strerror(-res));
+        lo_finish(L, k, 0);
+        return;
+    }
+    F->got += (size_t)res;
+    if(res > 0 && F->got < F->size){ lo_submit_read(L, k); return; }   /* short read */
+    L->n_uring++;
+    lo_finish(L, k, 1);     /* res == 0 before the end: the file shrank, keep what was read */
+}
+
+/* Next file to start (L->lock held): one asked for, else the next in order
+   while the prefetch is less than 2 * depth files ahead. Returns n if none. */
+static size_t lo_pick(FileLoader *L){
+    while(L->nwant > 0){
+        size_t k = L->want[--L->nwant];
+        L->f[k].wanted = 0;
+        if(L->f[k].state == LF_IDLE) return k;
+    }
+    while(L->next < L->n && L->f[L->next].state != LF_IDLE) L->next++;
+    if(L->next < L->n && L->ready + L->inflight < 2 * L->depth) return L->next++;
+    return L->n;
+}
+
+static void *lo_thread(void *arg){
+    FileLoader *L = (FileLoader*)arg;
+    pthread_mutex_lock(&L->lock);
+    for(;;){
+        while(!L->stop && L->inflight < L->depth){
+            size_t k = lo_pick(L);
+            if(k == L->n) break;
+            L->f[k].state = LF_OPENING;
+            L->inflight++;
+            lo_submit_open(L, k);
+        }
+        if(L->stop) break;
+        if(L->inflight == 0){
+            pthread_cond_wait(&L->cv, &L->lock);
+            continue;
+        }
+
+        /* submit and wait for at least one completion, outside the lock
+           (SQEs not consumed after EINTR/EAGAIN are submitted next time) */
+        pthread_mutex_unlock(&L->lock);
+        int rc = lo_enter(L->ring_fd, lo_pending(L), 1, IORING_ENTER_GETEVENTS);
+        pthread_mutex_lock(&L->lock);
+        if(rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY){
+            /* the ring is unusable: files in flight leave their buffers to
+               the kernel (it may still write them) and go back to the front
+               of the queue, to be read the plain way like all the rest */
+            fprintf(stderr,"loader: io_uring_enter failed: %s; reading directly\n", strerror(errno));
+            L->broken = 1;
+            for(size_t k=0;k<L->n;k++){
+                LFile *F = &L->f[k];
+                if(F->state != LF_OPENING && F->state != LF_READING) continue;
+                F->lost = F->buf;
+                F->buf = NULL;
+                if(F->fd >= 0){ close(F->fd); F->fd = -1; }
+                F->state = LF_IDLE;
+                if(!F->wanted){
+                    F->wanted = 1;
+                    L->want[L->nwant++] = k;
+                }
+            }
+            L->inflight = 0;
+            while(!L->stop){
+                size_t k;
+                while((k = lo_pick(L)) != L->n){
+                    L->f[k].state = LF_OPENING;     /* taken, so takers do not queue it again */
+                    L->inflight++;
+                    lo_fallback(L, k);
+                }
+                pthread_cond_wait(&L->cv, &L->lock);
+            }
+            break;
+        }
+        lo_reap(L, lo_complete);
+    }
+    pthread_mutex_unlock(&L->lock);
+    return NULL;
+}
+
+FileLoader *loader_open(char *const *paths, size_t n, int depth){
+    if(depth < 1) depth = 1;
+    FileLoader *L = (FileLoader*)calloc(1, sizeof(FileLoader));
+    if(!L){ fprintf(stderr,"loader_open: OOM\n"); return NULL; }
+    L->ring_fd = -1;
+    L->paths = paths;
+    L->n = n;
+    L->depth = depth;
+    L->f = (LFile*)calloc(n > 0 ? n : 1, sizeof(LFile));
+    L->want = (size_t*)malloc((n > 0 ? n : 1) * sizeof(size_t));
+    if(!L->f || !L->want){
+        fprintf(stderr,"loader_open: OOM\n");
+        free(L->f); free(L->want); free(L);
+        return NULL;
+    }
+    for(size_t k=0;k<n;k++) L->f[k].fd = -1;
+    if(lo_ring_init(L, (unsigned)depth) != 0){
+        lo_ring_free(L);
+        free(L->f); free(L->want); free(L);
+        return NULL;
+    }
+    pthread_mutex_init(&L->lock, NULL);
+    pthread_cond_init(&L->cv, NULL);
+    if(pthread_create(&L->thread, NULL, lo_thread, L) != 0){
+        fprintf(stderr,"loader_open: cannot start the I/O thread\n");
+        pthread_mutex_destroy(&L->lock);
+        pthread_cond_destroy(&L->cv);
+        lo_ring_free(L);
+        free(L->f); free(L->want); free(L);
+        return NULL;
+    }
+    return L;
+}
+
+int loader_take(FileLoader *L, size_t k, char **buf, size_t *len){
+    if(k >= L->n) return 0;
+    pthread_mutex_lock(&L->lock);
+    LFile *F = &L->f[k];
+    if(F->state == LF_IDLE && !F->wanted){
+        F->wanted = 1;
+        L->want[L->nwant++] = k;
+        pthread_cond_broadcast(&L->cv);
+    }
+    while(F->state != LF_READY && F->state != LF_FAILED && F->state != LF_TAKEN)
+        pthread_cond_wait(&L->cv, &L->lock);
+    int ok = F->state == LF_READY;
+    if(ok){
+        *buf = F->buf;
+        *len = F->got;
+        F->buf = NULL;
+        L->ready--;
+        pthread_cond_broadcast(&L->cv);     /* room for the prefetch */
+    }
+    F->state = LF_TAKEN;
+    pthread_mutex_unlock(&L->lock);
+    return ok;
+}
+
+void loader_stats(FileLoader *L, long *uring, long *fallback){
+    pthread_mutex_lock(&L->lock);
+    *uring = L->n_uring;
+    *fallback = L->n_fallback;
+    pthread_mutex_unlock(&L->lock);
+}
+
+/* A completion after loader_close stopped the I/O thread: only release the fd */
+static void lo_drop(FileLoader *L, size_t k, int res){
+    LFile *F = &L->f[k];
+    if(F->state == LF_OPENING && res >= 0) F->fd = res;
+    if(F->fd >= 0){ close(F->fd); F->fd = -1; }
+    F->state = LF_FAILED;
+    L->inflight--;
+}
+
+void loader_close(FileLoader *L){
+    if(!L) return;
+    pthread_mutex_lock(&L->lock);
+    L->stop = 1;
+    pthread_cond_broadcast(&L->cv);
+    pthread_mutex_unlock(&L->lock);
+    pthread_join(L->thread, NULL);
+    /* operations still in flight: wait for them before the buffers go */
+    while(!L->broken && L->inflight > 0){
+        if(lo_enter(L->ring_fd, lo_pending(L), 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) break;
+        lo_reap(L, lo_drop);
+    }
+    for(size_t k=0;k<L->n;k++){
+        mem_free(L->f[k].buf);     /* not lost: the kernel may still write those */
+        if(L->f[k].fd >= 0) close(L->f[k].fd);
+    }
+    pthread_mutex_destroy(&L->lock);
+    pthread_cond_destroy(&L->cv);
+    lo_ring_free(L);
+    free(L->f);
+    free(L->want);
+    free(L);
+}
+
+#else /* !LOADER_HAVE_URING */
+
+FileLoader *loader_open(char *const *paths, size_t n, int depth){
+    (void)paths; (void)n; (void)depth;
+    fprintf(stderr,"loader_open: built without io_uring support\n");
+    return NULL;
+}
+
+int loader_take(FileLoader *L, size_t k, char **buf, size_t *len){
+    (void)L; (void)k; (void)buf; (void)len;
+    return 0;
+}
+
+void loader_stats(FileLoader *L, long *uring, long *fallback){
+    (void)L;
+    *uring = *fallback = 0;
+}
+
+void loader_close(FileLoader *L){
+    (void)L;
+}
+
+#endif /* LOADER_HAVE_URING */
@@ -0,0 +1,44 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stddef.h>
+
+/*
+ * FileLoader
+ *
+ * Batched whole-file reader on Linux io_uring (--io-uring). One I/O thread
+ * keeps up to `depth` files in flight (open, then read of the whole file),
+ * going through the list in order and serving files asked for out of order
+ * first. Consumers take complete buffers and parse them in memory
+ * (parse_snapshot_xy), so many small snapshot files keep the device queue
+ * full instead of one fopen/fgets at a time. The prefetch does not run more
+ * than 2 * depth files ahead of what has been taken.
+ *
+ * io_uring is driven through the raw syscalls (no liburing). loader_open
+ * returns NULL when the kernel or the build has no io_uring (or it is
+ * disabled); callers then read with read_snapshot_xy as before. A single
+ * operation the kernel rejects (e.g. IORING_OP_OPENAT before 5.6) falls back
+ * to a plain read of that file on the I/O thread.
+ */
+typedef struct FileLoader FileLoader;
+
+/* Start loading paths[0..n-1] (the strings must outlive the loader).
+   Returns NULL if io_uring is unavailable (reason printed to stderr). */
+FileLoader *loader_open(char *const *paths, size_t n, int depth);
+
+/*
+ * loader_take
+ *
+ * Wait for file k and take its bytes: *buf (mem_malloc'd, NUL-terminated,
+ * release with mem_free) and *len. Each file can be taken once. Thread-safe.
+ * Returns 1 on success, 0 if the file could not be read.
+ */
+int loader_take(FileLoader *L, size_t k, char **buf, size_t *len);
+
+/* Files read through io_uring, and through the per-file fallback */
+void loader_stats(FileLoader *L, long *uring, long *fallback);
+
+/* Stop the I/O thread and free buffers nobody took */
+void loader_close(FileLoader *L);
+
+#endif /* LOADER_H */
@@ -19,6 +19,8 @@
  *   - delaunay.{c,h}
  *   - psi6.{c,h}
  *   - g6accum.{c,h}
+ *   - tpool.{c,h}      (process-wide thread pool; snapshots run as pool tasks)
+ *   - loader.{c,h}     (--io-uring: batched whole-file reads)
  *
  * Compile: see Makefile in project root (link everything together).
  */
@@ -29,6 +31,12 @@
 #include <string.h>
 #include <glob.h>
 #include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "utils.h"
 #include "clusters.h"
@@ -36,6 +44,18 @@
 #include "delaunay.h"
 #include "psi6.h"
 #include "g6accum.h"
+#include "tpool.h"
+#include "numa.h"
+#include "perfctr.h"
+#include "trace.h"
+#include "memacct.h"
+#include "framecache.h"
+#include "gr.h"
+#include "csd.h"
+#include "g6window.h"
+#include "g6conv.h"
+#include "autocorr.h"
+#include "loader.h"
 #include "io.h"   /* must provide: int read_snapshot_xy(const char *path, Vec2Array *pos); */
 
 /* ----------------------- DEFAULT CONFIG (can be moved to params.h) ----------------------- */
@@ -76,279 +96,1880 @@ static void ensure_output_dir(const char *outdir){
     (void)rc;
 }
 
+/* Snapshots time_<idx>.dat of dir (pattern "<dir>time_*.dat", so dir keeps
+   its trailing slash) with idx in [t0, t1], time-ordered, appended to
+   (*paths)[*n...]. Returns 0 on success, also when none match. */
+static int collect_snapshots(const char *dir, int t0, int t1, char ***paths, size_t *n){
+    char pattern[4096];
+    snprintf(pattern, sizeof(pattern), "%stime_*.dat", dir);
+
+    glob_t g;
+    memset(&g, 0, sizeof(g));
+    int glob_rc = glob(pattern, 0, NULL, &g);
+    if(glob_rc != 0){
+        fprintf(stderr, "No files match pattern: %s  (glob rc=%d)\n", pattern, glob_rc);
+        globfree(&g);
+        return glob_rc == GLOB_NOMATCH ? 0 : 1;
+    }
+
+    /* Filter paths by index range */
+    char **p = (char**)realloc(*paths, (*n + g.gl_pathc) * sizeof(char*));
+    if(!p){ fprintf(stderr,"OOM\n"); globfree(&g); return 1; }
+    *paths = p;
+    const size_t n0 = *n;
+    for(size_t i=0;i<g.gl_pathc;i++){
+        int ti = extract_time_index(g.gl_pathv[i]);
+        if(ti < 0) continue;
+        if(ti >= t0 && ti <= t1){
+            p[(*n)++] = strdup(g.gl_pathv[i]);
+        }
+    }
+    globfree(&g);
+    qsort(p + n0, *n - n0, sizeof(char*), cmp_paths_by_time);
+    return 0;
+}
+
+/* DATA_DIR: a directory, or a comma-separated list of directories and glob
+   patterns matching directories (one replica each, in the order given, glob
+   matches sorted). A single plain entry is used verbatim. Returns the number
+   of directories in *dirs. */
+static int expand_data_dirs(const char *arg, char ***dirs){
+    int n = 0, cap = 0;
+    *dirs = NULL;
+    while(*arg){
+        size_t len = strcspn(arg, ",");
+        char entry[4096];
+        snprintf(entry, sizeof(entry), "%.*s", (int)len, arg);
+        arg += len;
+        if(*arg == ',') arg++;
+        if(!entry[0]) continue;
+
+        glob_t g;
+        memset(&g, 0, sizeof(g));
+        const int pattern = strpbrk(entry, "*?[") != NULL;
+        /* GLOB_MARK: directories come back with a trailing slash */
+        if(pattern && glob(entry, GLOB_MARK, NULL, &g) != 0){
+            globfree(&g);
+            continue;
+        }
+        const size_t m = pattern ? g.gl_pathc : 1;
+        for(size_t k=0;k<m;k++){
+            const char *d = pattern ? g.gl_pathv[k] : entry;
+            if(pattern && d[strlen(d) - 1] != '/') continue;
+            if(n == cap){
+                char **nd = (char**)realloc(*dirs, (size_t)(cap = cap ? 2 * cap : 16) * sizeof(char*));
+                if(!nd){ fprintf(stderr,"OOM\n"); exit(1); }
+                *dirs = nd;
+            }
+            (*dirs)[n++] = strdup(d);
+        }
+        if(pattern) globfree(&g);
+    }
+    return n;
+}
+
 /* Print usage */
 static void usage(const char *prog){
     fprintf(stderr,
-        "Usage: %s DATA_DIR START_INDEX END_INDEX OUTPUT_DIR [LBOND] [DR] [USE_PBC] [BOX_X] [BOX_Y]\n\n"
+        "Usage: %s DATA_DIR START_INDEX END_INDEX OUTPUT_DIR [LBOND] [DR] [USE_PBC] [BOX_X] [BOX_Y] [OPTIONS]\n\n"
         "Example:\n"
         "  %s ./data/ 1000 1200 ./out/ 1.5 0.5 1 180.0 180.0\n\n"
-        "If optional args omitted, defaults are used.\n",
+        "If optional args omitted, defaults are used.\n\n"
+        "Replicas: DATA_DIR may be a comma list of directories and/or glob patterns of\n"
+        "directories (e.g. 'runs/rep_*/'). All their snapshots share one thread pool;\n"
+        "g6 is written pooled, per replica (g6_avg_repK_time_S_E.dat) and with the\n"
+        "inter-replica error (g6_ens_time_S_E.dat).\n\n"
+        "Options:\n"
+        "  --neighbors=ENGINE    neighbor backend: triangle (default), dt2d, sann or knn\n"
+        "  --knn=K               neighbors per point for --neighbors=knn (default 6)\n"
+        "  --check-neighbors     also run Triangle and report neighbor agreement and psi6\n"
+        "                        differences per snapshot and for the whole run\n"
+        "  --no-cluster          skip clustering; particle positions are used as COMs\n"
+        "  --min-cluster-size=N  drop clusters with fewer than N particles before neighbors/g6\n"
+        "  --max-cluster-size=N  drop clusters with more than N particles (0 = no limit)\n"
+        "  --g6-mc-tol=TOL       estimate g6 by stratified pair sampling until the standard\n"
+        "                        error of every bin is below TOL (default: all pairs)\n"
+        "  --g6-mc-max=N         per-bin sample cap for --g6-mc-tol (default 1000000)\n"
+        "  --g6-mc-seed=S        RNG seed for --g6-mc-tol\n"
+        "  --g6-conv-tol=TOL     stop reading snapshots once g6 has converged: the block\n"
+        "                        error and the change of the running mean are below TOL\n"
+        "                        (relative) in every bin of --g6-conv-range\n"
+        "  --g6-conv-every=K     snapshots per block / between checks (default 20)\n"
+        "  --g6-conv-range=A:B   r range checked (default 0:10*DR)\n"
+        "  --subsample=K         use only every K-th snapshot of the range\n"
+        "  --subsample=auto[:P]  choose K = ceil(2 tau) from the autocorrelation time tau of\n"
+        "                        the global |psi6| over a pilot of the first P snapshots\n"
+        "                        (default 100; of the first replica only); with --cache-dir\n"
+        "                        the pilot's psi6 is reused\n"
+        "  --threads=N           worker threads shared by all stages: snapshots run in\n"
+        "                        parallel, large ones are also split internally (default 1)\n"
+        "  --outputs=LIST        comma list of g6, gr (g(r) of the COMs) and csd (cluster\n"
+        "                        size distribution); only the stages they need run\n"
+        "                        (default g6)\n"
+        "  --window=W[:S]        also write g6 averaged over windows of W snapshots, one\n"
+        "                        starting every S (default W: fixed windows), each as\n"
+        "                        g6_avg_time_T0_T1.dat; all windows come from one pass\n"
+        "  --cache-dir=DIR       keep each snapshot's COMs, neighbors and psi6 in DIR, keyed\n"
+        "                        by its content and the clustering/neighbor settings;\n"
+        "                        reruns (e.g. with another DR) skip straight to g6\n"
+        "  --cache-max=SIZE      limit DIR to SIZE (K/M/G), dropping least recently used\n"
+        "  --io-uring[=DEPTH]    read the snapshot files through io_uring, DEPTH files in\n"
+        "                        flight (default 32); falls back to plain reads if the\n"
+        "                        kernel has no io_uring\n"
+        "  --io-bench            time reading the selected files with read_snapshot_xy and\n"
+        "                        with --io-uring (files/s, cold page cache), then exit\n"
+        "  --trace=FILE          write a Chrome trace (JSON) of every stage per snapshot and\n"
+        "                        thread; open it in chrome://tracing or ui.perfetto.dev\n"
+        "  --perf-counters       count cycles, instructions, cache and branch misses and\n"
+        "                        page faults per stage (perf_event_open) in the timing report\n"
+        "  --mem-stats           report allocations, peak tracked memory and sampled RSS per\n"
+        "                        stage, for every snapshot and for the run\n"
+        "  --mem-budget=SIZE     start a snapshot only while the estimated memory of those\n"
+        "                        running fits in SIZE (K/M/G suffixes); one always runs\n"
+        "  --numa                pin the --threads workers round-robin over NUMA nodes and\n"
+        "                        report how much of the per-snapshot memory is node-local\n"
+        "  --g6-chunks=N         split each snapshot's g6 pair loop into N equal-work\n"
+        "                        chunks (default 16, fewer for small snapshots); they run\n"
+        "                        on the --threads pool, and g6 depends on N but not on\n"
+        "                        --threads\n"
+        "  --fine-bins=K         record g6 in K fine bins per DR (default 8)\n"
+        "  --out-dr=W            write g6 with uniform bins of width W (multiple of DR/K)\n"
+        "  --out-log=RMIN:N      write g6 with N logarithmic bins per decade from RMIN\n"
+        "                        (the fine sums are also saved to g6_raw_time_S_E.dat;\n"
+        "                        rebin them later with g6_rebin)\n",
         prog, prog);
 }
 
-/* ------------------------------- main ---------------------------------- */
-int main(int argc, char **argv){
-    const char *data_dir = DEFAULT_DATA_DIR;
-    const char *out_dir  = DEFAULT_OUTPUT_DIR;
-    int start_idx = DEFAULT_START_IDX;
-    int end_idx   = DEFAULT_END_IDX;
-    double lbond  = DEFAULT_LBOND;
-    double dr     = DEFAULT_DR;
-    int use_pbc_flag = 1;
-    double box_x = 180.0, box_y = 180.0;
+/* Run-time options given as --name[=value] anywhere on the command line */
+typedef struct {
+    NeighborParams nbr;
+    int check_neighbors;
+    int no_cluster;         /* --no-cluster: every particle is its own cluster */
+    int min_cluster_size;   /* drop COMs of clusters smaller than this (1 = keep all) */
+    int max_cluster_size;   /* drop COMs of clusters larger than this (0 = no limit) */
+    int g6_mc;              /* 1: Monte Carlo g6 estimator (--g6-mc-tol) */
+    G6MCParams mc;
+    double g6_conv_tol;     /* --g6-conv-tol: early stop (0 = off) */
+    int    g6_conv_every;
+    double g6_conv_rmin, g6_conv_rmax;    /* rmax 0: 10 * dr */
+    int subsample;          /* --subsample: every k-th snapshot (0 = all, -1 = auto) */
+    int subsample_pilot;    /* --subsample=auto:P: snapshots in the pilot pass */
+    int threads;            /* size of the process-wide thread pool */
+    const char *cache_dir;  /* --cache-dir: per-snapshot results cache */
+    int64_t cache_max;      /* --cache-max: bytes (0 = no limit) */
+    int io_uring;           /* --io-uring: files in flight (0 = plain reads) */
+    int io_bench;           /* --io-bench: time the readers and exit */
+    const char *trace_path; /* --trace=FILE: Chrome trace JSON of the run */
+    int perf_counters;      /* --perf-counters: hardware counters per stage */
+    int mem_stats;          /* --mem-stats: memory report per stage */
+    int64_t mem_budget;     /* --mem-budget: bytes (0 = none) */
+    int numa;               /* --numa: pin threads round-robin over NUMA nodes */
+    unsigned outputs;       /* --outputs: bit per OUTPUTS entry (default g6) */
+    int window, window_stride;   /* --window: g6 per W snapshots every S (0 = off) */
+    int g6_chunks;          /* --g6-chunks: equal-work chunks of the all-pairs g6 kernel (0: default) */
+    int fine_bins;          /* fine g6 bins per dr */
+    int out_binning;        /* 1: --out-dr / --out-log given */
+    G6Binning out;
+} Options;
 
-    if(argc < 5){
-        if(argc == 1){
-            fprintf(stderr, "No args supplied — using defaults. To see usage, run with -h\n");
-        } else {
-            usage(argv[0]);
-            return 1;
+/* Run totals for --check-neighbors */
+typedef struct {
+    long   frames;
+    long   ref_entries, test_entries, common_entries;
+    long   points, points_identical;
+    double sum_dpsi;      /* sum over points of |psi6_test - psi6_ref| */
+    double max_dpsi;
+} NeighborCheck;
+
+/* --check-neighbors: compare one snapshot's neighbors/psi6 with the Triangle reference */
+static void check_neighbors_against_triangle(const Vec2Array *coms, const IntArray *neighbors,
+                                             const Complex *psi6, int M, bool use_pbc,
+                                             double box_x, double box_y, NeighborEngine engine,
+                                             NeighborCheck *check, FILE *out, FILE *err)
+{
+    int Mref;
+    IntArray *ref = triangulate_get_neighbors(coms, use_pbc, box_x, box_y, &Mref);
+    Complex *psi6_ref = (ref && Mref == M) ? compute_psi6_from_neighbors(coms, ref, use_pbc, box_x, box_y) : NULL;
+    if(psi6_ref){
+        NeighborCompare nc;
+        neighbors_compare(ref, neighbors, M, &nc);
+        double sum_d = 0.0, max_d = 0.0;
+        for(int i=0;i<M;i++){
+            double dre = psi6[i].re - psi6_ref[i].re;
+            double dim = psi6[i].im - psi6_ref[i].im;
+            double dd = sqrt(dre*dre + dim*dim);
+            sum_d += dd;
+            if(dd > max_d) max_d = dd;
         }
+        fprintf(out, "  neighbor check (%s vs triangle): entries %ld / %ld, common %ld, identical points %d / %d, "
+               "|dpsi6| mean %.4e max %.4e\n",
+               neighbor_engine_name(engine), nc.test_entries, nc.ref_entries,
+               nc.common_entries, nc.points_identical, M, sum_d / M, max_d);
+        check->frames++;
+        check->ref_entries += nc.ref_entries;
+        check->test_entries += nc.test_entries;
+        check->common_entries += nc.common_entries;
+        check->points += M;
+        check->points_identical += nc.points_identical;
+        check->sum_dpsi += sum_d;
+        if(max_d > check->max_dpsi) check->max_dpsi = max_d;
     } else {
-        data_dir = argv[1];
-        start_idx = atoi(argv[2]);
-        end_idx   = atoi(argv[3]);
-        out_dir   = argv[4];
-        if(argc >= 6) lbond = atof(argv[5]);
-        if(argc >= 7) dr    = atof(argv[6]);
-        if(argc >= 8) use_pbc_flag = atoi(argv[7]);
-        if(argc >= 10) {
-            box_x = atof(argv[8]);
-            box_y = atof(argv[9]);
+        fprintf(err, "  ! neighbor check: Triangle reference failed\n");
+    }
+    mem_free(psi6_ref);
+    if(ref) neighbors_free(ref, Mref);
+}
+
+/* Singleton fast path: COM of a one-particle cluster is its position wrapped into the box */
+static void wrap_positions_in_place(Vec2Array *pos, double box_x, double box_y){
+    for(size_t i=0;i<pos->n;i++){
+        double x = pos->data[i].x, y = pos->data[i].y;
+        if(x < 0.0 || x >= box_x) pos->data[i].x = wrap_pos(x, box_x);
+        if(y < 0.0 || y >= box_y) pos->data[i].y = wrap_pos(y, box_y);
+    }
+}
+
+/* Intermediates of a snapshot. Each is made by one step from the ones it
+   depends on, only when an output (or a later step) asks for it, and is then
+   shared by every consumer. */
+enum {
+    IM_POS       = 1u << 0,   /* particle positions */
+    IM_CLUSTERS  = 1u << 1,   /* cluster labels and count */
+    IM_COMS      = 1u << 2,   /* COMs of the clusters kept by the size filter */
+    IM_NEIGHBORS = 1u << 3,   /* neighbor lists of the COMs */
+    IM_PSI6      = 1u << 4    /* psi6 at each COM */
+};
+
+/* Per-snapshot outputs and the intermediates they consume */
+enum { OUT_G6, OUT_GR, OUT_CSD, NOUTPUTS };
+static const struct { const char *name; unsigned needs; } OUTPUTS[NOUTPUTS] = {
+    { "g6",  IM_COMS | IM_PSI6 },
+    { "gr",  IM_COMS },
+    { "csd", IM_CLUSTERS },
+};
+
+/* --outputs=LIST: bit o for each OUTPUTS[o] named in the comma list.
+   Returns 0 on success. */
+static int parse_outputs(const char *list, unsigned *mask){
+    *mask = 0;
+    while(*list){
+        size_t len = strcspn(list, ",");
+        int o = 0;
+        while(o < NOUTPUTS && !(strlen(OUTPUTS[o].name) == len && strncmp(list, OUTPUTS[o].name, len) == 0)) o++;
+        if(o == NOUTPUTS) return 1;
+        *mask |= 1u << o;
+        list += len;
+        if(*list == ',') list++;
+    }
+    return *mask ? 0 : 1;
+}
+
+/* Returns 0 if arg was understood */
+static int parse_option(const char *arg, Options *opt){
+    if(strncmp(arg, "--neighbors=", 12) == 0){
+        return neighbor_engine_parse(arg + 12, &opt->nbr.engine);
+    }
+    if(strncmp(arg, "--knn=", 6) == 0){
+        opt->nbr.knn_k = atoi(arg + 6);
+        return opt->nbr.knn_k > 0 ? 0 : 1;
+    }
+    if(strcmp(arg, "--check-neighbors") == 0){
+        opt->check_neighbors = 1;
+        return 0;
+    }
+    if(strcmp(arg, "--no-cluster") == 0){
+        opt->no_cluster = 1;
+        return 0;
+    }
+    if(strncmp(arg, "--min-cluster-size=", 19) == 0){
+        opt->min_cluster_size = atoi(arg + 19);
+        return opt->min_cluster_size > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--max-cluster-size=", 19) == 0){
+        opt->max_cluster_size = atoi(arg + 19);
+        return opt->max_cluster_size >= 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--g6-mc-tol=", 12) == 0){
+        opt->g6_mc = 1;
+        opt->mc.tol = atof(arg + 12);
+        return opt->mc.tol > 0.0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--g6-mc-max=", 12) == 0){
+        opt->mc.max_samples = atol(arg + 12);
+        return opt->mc.max_samples > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--g6-conv-tol=", 14) == 0){
+        opt->g6_conv_tol = atof(arg + 14);
+        return opt->g6_conv_tol > 0.0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--g6-conv-every=", 16) == 0){
+        opt->g6_conv_every = atoi(arg + 16);
+        return opt->g6_conv_every > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--g6-conv-range=", 16) == 0){
+        if(sscanf(arg + 16, "%lf:%lf", &opt->g6_conv_rmin, &opt->g6_conv_rmax) != 2) return 1;
+        return opt->g6_conv_rmin >= 0.0 && opt->g6_conv_rmax > opt->g6_conv_rmin ? 0 : 1;
+    }
+    if(strncmp(arg, "--subsample=", 12) == 0){
+        const char *v = arg + 12;
+        if(strncmp(v, "auto", 4) == 0){
+            opt->subsample = -1;
+            if(v[4] == ':') opt->subsample_pilot = atoi(v + 5);
+            else if(v[4] != '\0') return 1;
+            return opt->subsample_pilot >= 10 ? 0 : 1;
         }
+        opt->subsample = atoi(v);
+        return opt->subsample > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--threads=", 10) == 0){
+        opt->threads = atoi(arg + 10);
+        return opt->threads > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--outputs=", 10) == 0){
+        return parse_outputs(arg + 10, &opt->outputs);
+    }
+    if(strncmp(arg, "--window=", 9) == 0){
+        char *end;
+        opt->window = (int)strtol(arg + 9, &end, 10);
+        opt->window_stride = opt->window;
+        if(*end == ':') opt->window_stride = (int)strtol(end + 1, &end, 10);
+        return *end == '\0' && opt->window > 0 && opt->window_stride > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--cache-dir=", 12) == 0){
+        opt->cache_dir = arg + 12;
+        return *opt->cache_dir ? 0 : 1;
+    }
+    if(strncmp(arg, "--cache-max=", 12) == 0){
+        return mem_parse_size(arg + 12, &opt->cache_max) == 0 && opt->cache_max > 0 ? 0 : 1;
     }
+    if(strcmp(arg, "--io-uring") == 0){
+        opt->io_uring = 32;
+        return 0;
+    }
+    if(strncmp(arg, "--io-uring=", 11) == 0){
+        opt->io_uring = atoi(arg + 11);
+        return opt->io_uring > 0 ? 0 : 1;
+    }
+    if(strcmp(arg, "--io-bench") == 0){
+        opt->io_bench = 1;
+        return 0;
+    }
+    if(strncmp(arg, "--trace=", 8) == 0){
+        opt->trace_path = arg + 8;
+        return *opt->trace_path ? 0 : 1;
+    }
+    if(strcmp(arg, "--perf-counters") == 0){
+        opt->perf_counters = 1;
+        return 0;
+    }
+    if(strcmp(arg, "--mem-stats") == 0){
+        opt->mem_stats = 1;
+        return 0;
+    }
+    if(strncmp(arg, "--mem-budget=", 13) == 0){
+        return mem_parse_size(arg + 13, &opt->mem_budget) == 0 && opt->mem_budget > 0 ? 0 : 1;
+    }
+    if(strcmp(arg, "--numa") == 0){
+        opt->numa = 1;
+        return 0;
+    }
+    if(strncmp(arg, "--g6-chunks=", 12) == 0){
+        opt->g6_chunks = atoi(arg + 12);
+        return opt->g6_chunks > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--fine-bins=", 12) == 0){
+        opt->fine_bins = atoi(arg + 12);
+        return opt->fine_bins > 0 ? 0 : 1;
+    }
+    if(strncmp(arg, "--out-dr=", 9) == 0 || strncmp(arg, "--out-log=", 10) == 0){
+        opt->out_binning = 1;
+        return g6_binning_parse(arg, &opt->out);
+    }
+    if(strncmp(arg, "--g6-mc-seed=", 13) == 0){
+        opt->mc.seed = strtoull(arg + 13, NULL, 10);
+        return 0;
+    }
+    return 1;
+}
 
-    if(start_idx > end_idx){
-        fprintf(stderr, "start index (%d) > end index (%d)\n", start_idx, end_idx);
+/* ------------------------- per-snapshot work ------------------------- */
+
+/* Pipeline stages timed per snapshot */
+enum { ST_READ, ST_CLUSTER, ST_COM, ST_NEIGHBORS, ST_PSI6, ST_G6, ST_GR, ST_CSD, NSTAGES };
+static const char *STAGE_NAMES[NSTAGES] = { "read", "cluster", "com", "neighbors", "psi6", "g6", "gr", "csd" };
+
+/* Monotonic seconds (the trace clock, so stage times and trace events agree) */
+static double now_sec(void){
+    return trace_now();
+}
+
+/* Start of the current stage: wall clock and (--perf-counters) thread counters */
+typedef struct {
+    double   t;
+    uint64_t ctr[PERFCTR_N];
+    long     frame;           /* snapshot index, for the trace */
+    int64_t  mem_base;        /* thread's live tracked bytes at the frame start */
+    int64_t  mem_nalloc, mem_bytes;   /* thread's allocation counters at the stage start */
+} StageClock;
+
+/* Blocks of consecutive snapshots sharing a measured cost-per-byte estimate */
+#define COST_BLOCKS 16
+
+/* Longest-first dispatch only looks LPT_WINDOW x threads snapshots past the
+   next one to commit, so the finished snapshots held for the in-order commit
+   (each with its accumulators and buffered log) stay bounded */
+#define LPT_WINDOW 4
+
+/* Results of one snapshot, merged into the run totals in snapshot order */
+typedef struct {
+    int       done;
+    int       ok;             /* every requested output ran (not skipped after an error) */
+    G6Accum  *acc;            /* this snapshot's g6 sums */
+    GrAccum  *gr;             /* --outputs=gr */
+    CsdAccum *csd;            /* --outputs=csd */
+    NeighborCheck check;
+    long      clusters_total, clusters_kept;
+    char     *out, *err;      /* buffered log (parallel runs) */
+    size_t    out_len, err_len;
+    double    stage[NSTAGES]; /* seconds per stage */
+    uint64_t  ctr[NSTAGES][PERFCTR_N];    /* --perf-counters: counts per stage */
+    int64_t   mem_peak[NSTAGES];          /* high-water of the frame's tracked bytes */
+    int64_t   mem_nalloc[NSTAGES], mem_bytes[NSTAGES];   /* allocations made */
+    long long rss[NSTAGES];               /* --mem-stats: RSS sampled at the stage end */
+    int       tid;            /* pool thread that ran it (owns acc) */
+    long      pages_local, pages_total;   /* --numa placement of the frame's buffers */
+} FrameResult;
+
+/* --window: a completed window waiting to be written (outside R->lock) */
+typedef struct {
+    G6Accum *acc;             /* copy of the window sum */
+    int      t0, t1;
+} DoneWindow;
+
+/* Shared state of the snapshot loop */
+typedef struct {
+    const Options *opt;
+    char  **paths;
+    size_t  nsel;
+    double  lbond, dr;
+    int     use_pbc;
+    double  box_x, box_y;
+    int     buffered;         /* 1: frames run concurrently, logs are buffered */
+    FrameResult *res;
+    /* ordered commit (lock) */
+    pthread_mutex_t lock;
+    size_t  next_commit;
+    unsigned outputs;         /* bit per OUTPUTS entry */
+    G6Accum *A;
+    GrAccum *gr;
+    CsdAccum *csd;
+    double  gr_rmax;
+    G6Window *win;            /* --window */
+    const char *out_dir;
+    long    nwindows;
+    DoneWindow *wq;           /* completed windows in order, not yet written (lock) */
+    size_t  wq_head, wq_n, wq_cap;
+    pthread_mutex_t win_lock; /* held while writing windows, so they go out in order */
+    G6Conv *conv;             /* --g6-conv-tol */
+    int     nrep;             /* replicas (DATA_DIR list); 1: none */
+    const int *rep_of;        /* replica of each snapshot (nrep > 1) */
+    G6Accum **rep_acc;        /* g6 of each replica (nrep > 1) */
+    int     stopped;          /* converged: later snapshots are not used */
+    size_t  stop_ip;          /* the snapshot it converged on */
+    NeighborCheck *check;
+    long    clusters_total, clusters_kept;
+    int     nthreads;
+    G6Accum **spare;          /* cleared per-frame accumulators for reuse, nsel per
+                                 thread: each thread reuses the ones it created, so
+                                 their pages stay on its NUMA node (first touch) */
+    size_t *nspare;
+    /* --numa: node of each pool thread, and page placement totals (lock) */
+    int    *thread_node;
+    long    pages_local, pages_total;
+    /* longest-first dispatch (lock): snapshots not yet started, their sizes,
+       and measured seconds / bytes per block of the trajectory */
+    int     perf;             /* --perf-counters */
+    FrameCache *cache;        /* --cache-dir */
+    FileLoader *loader;       /* --io-uring */
+    int     lpt;
+    size_t *left;
+    size_t  nleft;
+    size_t  ndispatched;
+    double  tail_t0, tail_idle0;  /* wall clock and pool idle when the last snapshot started */
+    double *bytes;
+    double  block_sec[COST_BLOCKS], block_bytes[COST_BLOCKS];
+    double  sum_sec, sum_bytes;
+    /* memory (lock): --mem-stats, and for --mem-budget the estimated bytes of
+       the snapshots running, the largest tracked peak per input byte seen so
+       far, and the time snapshots waited for room */
+    int     mem_stats;
+    int64_t mem_budget;
+    double  mem_rate, mem_inflight;
+    int     nrunning;
+    long    mem_waits;
+    double  mem_wait_sec;
+    pthread_cond_t mem_cv;
+} RunCtx;
+
+/* Estimated cost of snapshot ip: its file size times the measured seconds
+   per byte of its trajectory block (cluster counts, hence costs, drift with
+   time), or of the whole run until the block has a measurement (R->lock held) */
+static double frame_cost_estimate(const RunCtx *R, size_t ip){
+    int b = (int)(ip * COST_BLOCKS / R->nsel);
+    double rate = 1.0;
+    if(R->block_bytes[b] > 0.0) rate = R->block_sec[b] / R->block_bytes[b];
+    else if(R->sum_bytes > 0.0) rate = R->sum_sec / R->sum_bytes;
+    return R->bytes[ip] * rate;
+}
+
+/* Next snapshot to start: the most expensive one left within the window
+   past the next commit, or the earliest one left if the window has all
+   started (R->lock held) */
+static size_t next_frame_lpt(RunCtx *R){
+    const size_t lim = R->next_commit + (size_t)LPT_WINDOW * (size_t)R->nthreads;
+    size_t best = 0, first = 0;
+    double best_cost = -1.0;
+    for(size_t k=0;k<R->nleft;k++){
+        if(R->left[k] < R->left[first]) first = k;
+        if(R->left[k] >= lim) continue;
+        double c = frame_cost_estimate(R, R->left[k]);
+        if(c > best_cost){ best_cost = c; best = k; }
+    }
+    if(best_cost < 0.0) best = first;
+    size_t ip = R->left[best];
+    R->left[best] = R->left[--R->nleft];
+    return ip;
+}
+
+static void stage_start(const RunCtx *R, StageClock *c, long frame){
+    MemThreadStats m;
+    mem_thread_stats(&m);
+    mem_thread_mark();
+    c->mem_base = m.live;
+    c->mem_nalloc = m.nalloc;
+    c->mem_bytes = m.bytes;
+    c->t = now_sec();
+    c->frame = frame;
+    if(R->perf) perfctr_read(c->ctr);
+}
+
+/* Charge the time (and counts) since the clock's start to stage st, then restart it */
+static void stage_mark(const RunCtx *R, FrameResult *F, int st, StageClock *c){
+    double t1 = now_sec();
+    F->stage[st] += t1 - c->t;
+    trace_event(STAGE_NAMES[st], c->frame, c->t, t1);
+    c->t = t1;
+    if(R->perf){
+        uint64_t v[PERFCTR_N];
+        if(perfctr_read(v) == 0)
+            for(int k=0;k<PERFCTR_N;k++){ F->ctr[st][k] += v[k] - c->ctr[k]; c->ctr[k] = v[k]; }
+    }
+    MemThreadStats m;
+    mem_thread_stats(&m);
+    mem_thread_mark();
+    if(m.peak - c->mem_base > F->mem_peak[st]) F->mem_peak[st] = m.peak - c->mem_base;
+    F->mem_nalloc[st] += m.nalloc - c->mem_nalloc;
+    F->mem_bytes[st] += m.bytes - c->mem_bytes;
+    c->mem_nalloc = m.nalloc;
+    c->mem_bytes = m.bytes;
+    if(R->mem_stats){
+        long long rss = mem_rss_bytes();
+        if(rss > F->rss[st]) F->rss[st] = rss;
+    }
+}
+
+/* Largest tracked high-water of a snapshot over its stages, and that stage */
+static int64_t frame_mem_peak(const FrameResult *F, int *stage){
+    int64_t peak = 0;
+    if(stage) *stage = 0;
+    for(int k=0;k<NSTAGES;k++)
+        if(F->mem_peak[k] > peak){
+            peak = F->mem_peak[k];
+            if(stage) *stage = k;
+        }
+    return peak;
+}
+
+/* --mem-budget: wait until snapshot ip fits next to the running ones. Its
+   estimate is its file size times the largest peak per byte measured so far;
+   until a snapshot has finished there is no estimate and they run one at a
+   time. A snapshot that is too big alone still runs, alone. Returns the
+   estimate to release when it is done (R->lock held). */
+static double frame_mem_admit(RunCtx *R, size_t ip){
+    if(R->mem_budget <= 0) return 0.0;
+    double t0 = 0.0;
+    int waited = 0;
+    for(;;){
+        double est = R->bytes[ip] * R->mem_rate;
+        if(R->nrunning == 0 ||
+           (R->mem_rate > 0.0 && R->mem_inflight + est <= (double)R->mem_budget)){
+            R->nrunning++;
+            R->mem_inflight += est;
+            if(waited){
+                R->mem_waits++;
+                R->mem_wait_sec += now_sec() - t0;
+            }
+            return est;
+        }
+        if(!waited){
+            waited = 1;
+            t0 = now_sec();
+        }
+        pthread_cond_wait(&R->mem_cv, &R->lock);
+    }
+}
+
+/* Cache key of a snapshot: its bytes and every setting its COMs, neighbors
+   and psi6 depend on (not dr or the g6 options) */
+static uint64_t frame_cache_key(const RunCtx *R, const char *raw, size_t len){
+    const Options *opt = R->opt;
+    const int iparams[6] = { R->use_pbc, opt->no_cluster, opt->min_cluster_size,
+                             opt->max_cluster_size, (int)opt->nbr.engine, opt->nbr.knn_k };
+    const double dparams[3] = { R->lbond, R->box_x, R->box_y };
+    uint64_t h = fnv1a64(FNV1A64_INIT, "hexatic frame cache v1", 22);
+    h = fnv1a64(h, iparams, sizeof(iparams));
+    h = fnv1a64(h, dparams, sizeof(dparams));
+    h = fnv1a64(h, &len, sizeof(len));
+    return fnv1a64(h, raw, len);
+}
+
+/* State of one snapshot while its steps run; released by frame_release */
+typedef struct {
+    RunCtx      *R;
+    size_t       ip;
+    FrameResult *F;
+    FILE        *out, *err;
+    StageClock   clk;
+    unsigned     have;            /* IM_* made so far */
+    const char  *path;
+    char        *raw;             /* --cache-dir / --io-uring: file bytes, until parsed */
+    size_t       raw_len;
+    uint64_t     cache_key;
+    int          cache_tried;
+    Vec2Array    pos;
+    Vec2Array    coms_buf;        /* owned COM storage (unused on the singleton path) */
+    const Vec2Array *coms;        /* COMs fed to neighbors/psi6/g6: &coms_buf or &pos */
+    int         *cluster_id;
+    IntArray    *clusters;
+    int          nclusters;
+    IntArray    *neighbors;
+    int          M;
+    Complex     *psi6;
+} Frame;
+
+/* The snapshot's file bytes into fr->raw: from the --io-uring loader, else read whole */
+static int frame_read_raw(Frame *fr){
+    FileLoader *L = fr->R->loader;
+    const int ok = L ? loader_take(L, fr->ip, &fr->raw, &fr->raw_len)
+                     : read_file_bytes(fr->path, &fr->raw, &fr->raw_len);
+    if(!ok) fprintf(fr->err, "  ! failed to read %s (skipping)\n", fr->path);
+    else if(L) mem_thread_adopt(fr->raw);    /* allocated on the I/O thread */
+    return ok ? 0 : 1;
+}
+
+/* 1) Read snapshot positions (expects io.c to implement read_snapshot_xy) */
+static int step_read(Frame *fr){
+    if(!fr->raw && fr->R->loader && frame_read_raw(fr) != 0) return 1;
+    if(fr->raw){
+        const int ok = parse_snapshot_xy(fr->raw, fr->raw_len, &fr->pos);
+        mem_free(fr->raw);
+        fr->raw = NULL;
+        if(!ok){
+            fprintf(fr->err, "  ! failed to parse %s (skipping)\n", fr->path);
+            return 1;
+        }
+    } else if(!read_snapshot_xy(fr->path, &fr->pos)){
+        fprintf(fr->err, "  ! failed to read %s (skipping)\n", fr->path);
         return 1;
     }
+    stage_mark(fr->R, fr->F, ST_READ, &fr->clk);
+    fprintf(fr->out, "  read %zu particles\n", fr->pos.n);
 
-    ensure_output_dir(out_dir);
+    if(fr->pos.n == 0){
+        fprintf(fr->err, "  ! empty snapshot %s (skipping)\n", fr->path);
+        return 1;
+    }
+    return 0;
+}
 
-    /* Build glob pattern */
-    char pattern[4096];
-    snprintf(pattern, sizeof(pattern), "%stime_*.dat", data_dir);
+/* 2) Clustering (union-find) */
+static int step_cluster(Frame *fr){
+    const RunCtx *R = fr->R;
+    if(R->opt->no_cluster){
+        fr->nclusters = (int)fr->pos.n;
+        fprintf(fr->out, "  clustering disabled, nclusters = %d\n", fr->nclusters);
+    } else {
+        fprintf(fr->out, "  entering clustering\n");
+        fr->cluster_id = find_clusters_from_vec2array(&fr->pos, R->lbond, R->use_pbc, R->box_x, R->box_y, &fr->nclusters);
+        fprintf(fr->out, "  clustering done, nclusters = %d\n", fr->nclusters);
+        if (!fr->cluster_id) {
+            fprintf(fr->err, "  ! clustering failed (null cluster_id)\n");
+            return 1;
+        }
+    }
+    stage_mark(fr->R, fr->F, ST_CLUSTER, &fr->clk);
+    return 0;
+}
 
-    glob_t g;
-    memset(&g, 0, sizeof(g));
-    int glob_rc = glob(pattern, 0, NULL, &g);
-    if(glob_rc != 0){
-        fprintf(stderr, "No files match pattern: %s  (glob rc=%d)\n", pattern, glob_rc);
-        globfree(&g);
+/* 3) Cluster COMs, then the size filter */
+static int step_coms(Frame *fr){
+    const RunCtx *R = fr->R;
+    const Options *opt = R->opt;
+    const int size_filter = opt->min_cluster_size > 1 || opt->max_cluster_size > 0;
+    FILE *out = fr->out, *err = fr->err;
+    if(fr->nclusters == (int)fr->pos.n){
+        /* 3') Every particle is its own cluster: the COMs are the (wrapped) positions.
+         *     No cluster lists, no COM copy; cluster_id is the identity and not needed. */
+        mem_free(fr->cluster_id);
+        fr->cluster_id = NULL;
+        if(R->use_pbc) wrap_positions_in_place(&fr->pos, R->box_x, R->box_y);
+        /* size filter on singletons is all-or-nothing */
+        if(opt->min_cluster_size > 1) fr->pos.n = 0;
+        fr->coms = &fr->pos;
+        fprintf(out, "  all clusters are single particles: using positions as COMs\n");
+    } else {
+        /* DEBUG: check label range */
+        int max_id = -1, min_id = 1e9;
+        for (int i = 0; i < (int)fr->pos.n; i++) {
+            if (fr->cluster_id[i] < min_id) min_id = fr->cluster_id[i];
+            if (fr->cluster_id[i] > max_id) max_id = fr->cluster_id[i];
+        }
+        fprintf(out, "  cluster_id range: [%d, %d]\n", min_id, max_id);
+        if (min_id < 0 || max_id >= fr->nclusters) {
+            fprintf(err,
+                    "  !! ERROR: cluster_id out of range: min=%d max=%d nclusters=%d\n",
+                    min_id, max_id, fr->nclusters);
+            /* bail out so we see the message instead of segfault */
+            return 1;
+        }
+
+        /* Build IntArray clusters and compute COMs */
+        fprintf(out, "  building clusters (make_clusters_from_ids)\n");
+        fr->clusters = make_clusters_from_ids(fr->cluster_id, (int)fr->pos.n, fr->nclusters);
+        if (!fr->clusters) {
+            fprintf(err, "  ! make_clusters_from_ids returned NULL\n");
+            return 1;
+        }
+        fprintf(out, "  clusters built\n");
+
+        fprintf(out, "  computing COMs\n");
+        if(compute_cluster_coms(&fr->pos, fr->clusters, fr->nclusters, R->use_pbc, R->box_x, R->box_y, &fr->coms_buf) != 0){
+            fprintf(err, "  ! compute_cluster_coms failed (skipping)\n");
+            return 1;
+        }
+        if(size_filter && filter_coms_by_size(&fr->coms_buf, fr->clusters, fr->nclusters,
+                                              opt->min_cluster_size, opt->max_cluster_size) < 0){
+            fprintf(err, "  ! filter_coms_by_size failed (skipping)\n");
+            return 1;
+        }
+        fr->coms = &fr->coms_buf;
+    }
+    stage_mark(fr->R, fr->F, ST_COM, &fr->clk);
+    fprintf(out, "  COMs computed: %zu clusters\n", fr->coms->n);
+    if(size_filter){
+        fprintf(out, "  size filter [%d, %d]: kept %zu / %d clusters\n",
+               opt->min_cluster_size, opt->max_cluster_size, fr->coms->n, fr->nclusters);
+        fr->F->clusters_total += fr->nclusters;
+        fr->F->clusters_kept += (long)fr->coms->n;
+        if(fr->coms->n < 2){
+            fprintf(err, "  ! fewer than 2 clusters left after size filter (skipping)\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* 4) Delaunay neighbors (with PBC images) */
+static int step_neighbors(Frame *fr){
+    const RunCtx *R = fr->R;
+    fr->neighbors = compute_neighbors(fr->coms, R->use_pbc, R->box_x, R->box_y, &R->opt->nbr, &fr->M);
+    stage_mark(fr->R, fr->F, ST_NEIGHBORS, &fr->clk);
+    fprintf(fr->out, "  triangulation returned neighbors, M = %d\n", fr->M);
+    if(!fr->neighbors || fr->M != (int)fr->coms->n){
+        fprintf(fr->err, "  ! triangulate_get_neighbors failed (skipping)\n");
         return 1;
     }
+    return 0;
+}
 
-    /* Filter paths by index range */
-    char **paths = (char**)malloc(g.gl_pathc * sizeof(char*));
-    if(!paths){ fprintf(stderr,"OOM\n"); globfree(&g); return 1; }
-    size_t nsel = 0;
-    for(size_t i=0;i<g.gl_pathc;i++){
-        int ti = extract_time_index(g.gl_pathv[i]);
-        if(ti < 0) continue;
-        if(ti >= start_idx && ti <= end_idx){
-            paths[nsel++] = strdup(g.gl_pathv[i]);
+/* 5) psi6 (stored in the cache together with the COMs and neighbors) */
+static int step_psi6(Frame *fr){
+    const RunCtx *R = fr->R;
+    fprintf(fr->out, "  computing psi6\n");
+    fr->psi6 = compute_psi6_from_neighbors(fr->coms, fr->neighbors, R->use_pbc, R->box_x, R->box_y);
+    if(!fr->psi6){
+        fprintf(fr->err, "  ! compute_psi6 failed (skipping)\n");
+        return 1;
+    }
+    stage_mark(fr->R, fr->F, ST_PSI6, &fr->clk);
+    fprintf(fr->out, "  psi6 computed\n");
+    if(fr->cache_tried && framecache_store(R->cache, fr->cache_key, fr->coms, fr->neighbors, fr->psi6, fr->nclusters) != 0)
+        fprintf(fr->err, "  ! could not write the cache entry\n");
+    return 0;
+}
+
+/* The steps: what each makes and what it needs */
+static const struct { unsigned makes, needs; int (*run)(Frame *fr); } STEPS[] = {
+    { IM_POS,       0,                      step_read },
+    { IM_CLUSTERS,  IM_POS,                 step_cluster },
+    { IM_COMS,      IM_POS | IM_CLUSTERS,   step_coms },
+    { IM_NEIGHBORS, IM_COMS,                step_neighbors },
+    { IM_PSI6,      IM_COMS | IM_NEIGHBORS, step_psi6 },
+};
+
+/* --cache-dir: read the file whole and hash it; on a hit the COMs and psi6
+   (and the neighbors, if the check needs them) come from the cache and the
+   steps that make them never run. On a miss the bytes are kept for step_read. */
+static int frame_cache_lookup(Frame *fr){
+    const RunCtx *R = fr->R;
+    const Options *opt = R->opt;
+    fr->cache_tried = 1;
+    if(frame_read_raw(fr) != 0) return 1;
+    fr->cache_key = frame_cache_key(R, fr->raw, fr->raw_len);
+    const int want_nbr = opt->check_neighbors && opt->nbr.engine != NEIGHBOR_ENGINE_TRIANGLE;
+    if(framecache_load(R->cache, fr->cache_key, &fr->coms_buf, &fr->psi6,
+                       want_nbr ? &fr->neighbors : NULL, &fr->nclusters) != 0){
+        stage_mark(fr->R, fr->F, ST_READ, &fr->clk);
+        return 0;
+    }
+    stage_mark(fr->R, fr->F, ST_READ, &fr->clk);
+    fr->coms = &fr->coms_buf;
+    fr->M = (int)fr->coms->n;
+    fr->have |= IM_COMS | IM_PSI6 | (fr->neighbors ? IM_NEIGHBORS : 0);
+    fprintf(fr->out, "  cache hit: %zu COMs of %d clusters, neighbors and psi6\n", fr->coms->n, fr->nclusters);
+    if(opt->min_cluster_size > 1 || opt->max_cluster_size > 0){
+        fr->F->clusters_total += fr->nclusters;
+        fr->F->clusters_kept += (long)fr->coms->n;
+    }
+    return 0;
+}
+
+/* Make the intermediates in `what` that are missing, dependencies first.
+   Returns non-zero if a step failed (the snapshot is skipped). */
+static int frame_need(Frame *fr, unsigned what){
+    if(!fr->cache_tried && fr->R->cache && (what & ~fr->have & (IM_COMS | IM_PSI6)))
+        if(frame_cache_lookup(fr) != 0) return 1;
+    for(size_t k=0;k<sizeof(STEPS)/sizeof(STEPS[0]);k++){
+        if(!(what & STEPS[k].makes) || (fr->have & STEPS[k].makes)) continue;
+        if(frame_need(fr, STEPS[k].needs) != 0 || STEPS[k].run(fr) != 0) return 1;
+        fr->have |= STEPS[k].makes;
+    }
+    return 0;
+}
+
+/* 6) accumulate g6 */
+static int output_g6(Frame *fr){
+    const RunCtx *R = fr->R;
+    const Options *opt = R->opt;
+    int64_t helper = 0;
+    uint64_t ctr[PERFCTR_N] = { 0 };
+    if(opt->g6_mc){
+        G6MCParams mc = opt->mc;
+        mc.stream = (long)fr->ip;     /* RNG stream per snapshot, independent of scheduling */
+        G6MCStats mst;
+        if(g6accum_accumulate_mc(fr->F->acc, fr->coms, fr->psi6, R->use_pbc, R->box_x, R->box_y, &mc, &mst) != 0){
+            fprintf(fr->err, "  ! g6accum_accumulate_mc failed (skipping)\n");
+            return 1;
         }
+        if(mst.exact) fprintf(fr->out, "  g6 MC: small snapshot, all pairs used\n");
+        else fprintf(fr->out, "  g6 MC: %ld samples over %d bins (%d capped), min ESS %.1f\n",
+                    mst.samples, mst.nbins, mst.nbins_capped, mst.min_ess);
+    } else {
+        g6accum_accumulate(fr->F->acc, fr->coms, fr->psi6, R->use_pbc, R->box_x, R->box_y);
+        /* chunk buffers held by pool helpers are not in this thread's counters:
+           add them to its peak (an upper bound, the two need not coincide) */
+        helper = (int64_t)g6accum_helper_peak(fr->F->acc);
+        g6accum_helper_counts(fr->F->acc, ctr);
     }
-    globfree(&g);
+    stage_mark(fr->R, fr->F, ST_G6, &fr->clk);
+    fr->F->mem_peak[ST_G6] += helper;
+    /* likewise the counts of the chunks other threads stole */
+    for(int k=0;k<PERFCTR_N;k++) fr->F->ctr[ST_G6][k] += ctr[k];
+    return 0;
+}
 
-    if(nsel == 0){
-        fprintf(stderr, "No files found in range %d..%d\n", start_idx, end_idx);
-        free(paths);
+/* g(r) of the COMs */
+static int output_gr(Frame *fr){
+    const RunCtx *R = fr->R;
+    if(gr_accumulate(fr->F->gr, fr->coms, R->use_pbc, R->box_x, R->box_y) != 0){
+        fprintf(fr->err, "  ! gr_accumulate failed (skipping)\n");
         return 1;
     }
+    stage_mark(fr->R, fr->F, ST_GR, &fr->clk);
+    return 0;
+}
 
-    qsort(paths, nsel, sizeof(char*), cmp_paths_by_time);
-    if(VERBOSITY) printf("Found %zu files in range [%d, %d]\n", nsel, start_idx, end_idx);
+/* cluster size distribution (before the size filter) */
+static int output_csd(Frame *fr){
+    /* without labels every particle is a cluster (pos.n may be cut by the filter) */
+    const int N = fr->cluster_id ? (int)fr->pos.n : fr->nclusters;
+    if(csd_accumulate(fr->F->csd, fr->cluster_id, N, fr->nclusters) != 0){
+        fprintf(fr->err, "  ! csd_accumulate failed (skipping)\n");
+        return 1;
+    }
+    stage_mark(fr->R, fr->F, ST_CSD, &fr->clk);
+    return 0;
+}
 
-    /* Create accumulator */
-    G6Accum *A = g6accum_create(dr);
-    if(!A){ fprintf(stderr,"Failed to create g6 accumulator\n"); for(size_t i=0;i<nsel;i++) free(paths[i]); free(paths); return 1; }
+static int (*const OUTPUT_RUN[NOUTPUTS])(Frame *fr) = { output_g6, output_gr, output_csd };
 
-    /* Process snapshots */
-    for(size_t ip=0; ip<nsel; ip++){
-        const char *path = paths[ip];
-        int tindex = extract_time_index(path);
-        if(VERBOSITY) printf("[%zu/%zu] Processing %s (t=%d)\n", ip+1, nsel, path, tindex);
+/* Start snapshot ip with nothing made yet; its clock starts now */
+static void frame_init(Frame *fr, RunCtx *R, size_t ip, FrameResult *F, FILE *out, FILE *err){
+    memset(fr, 0, sizeof(*fr));
+    fr->R = R;
+    fr->ip = ip;
+    fr->F = F;
+    fr->out = out;
+    fr->err = err;
+    fr->path = R->paths[ip];
+    v2a_init(&fr->pos);
+    v2a_init(&fr->coms_buf);
+    stage_start(R, &fr->clk, (long)ip);
+}
 
+/* Free everything the snapshot's steps made */
+static void frame_free(Frame *fr){
+    mem_free(fr->raw);
+    mem_free(fr->psi6);
+    if(fr->neighbors) neighbors_free(fr->neighbors, fr->M);
+    v2a_free(&fr->coms_buf);
+    if(fr->clusters){
+        for(int k=0;k<fr->nclusters;k++) ia_free(&fr->clusters[k]);
+        mem_free(fr->clusters);
+    }
+    mem_free(fr->cluster_id);
+    v2a_free(&fr->pos);
+}
 
+/* One snapshot: make what the requested outputs need, then feed each output */
+static void process_frame(RunCtx *R, size_t ip, FrameResult *F, FILE *out, FILE *err){
+    const Options *opt = R->opt;
+    Frame fr;
+    frame_init(&fr, R, ip, F, out, err);
 
+    int tindex = extract_time_index(fr.path);
+    if(VERBOSITY) fprintf(out, "[%zu/%zu] Processing %s (t=%d)\n", ip+1, R->nsel, fr.path, tindex);
 
+    /* everything the requested outputs consume, each made once and shared */
+    unsigned needs = 0;
+    for(int o=0;o<NOUTPUTS;o++) if(R->outputs & (1u << o)) needs |= OUTPUTS[o].needs;
+    if(frame_need(&fr, needs) != 0) goto next_snapshot;
 
+    /* optional: compare the selected engine against Triangle neighbors and their psi6 */
+    if(opt->check_neighbors && opt->nbr.engine != NEIGHBOR_ENGINE_TRIANGLE){
+        if(frame_need(&fr, IM_COMS | IM_NEIGHBORS | IM_PSI6) != 0) goto next_snapshot;
+        check_neighbors_against_triangle(fr.coms, fr.neighbors, fr.psi6, fr.M, R->use_pbc,
+                                         R->box_x, R->box_y, opt->nbr.engine, &F->check, out, err);
+        stage_mark(R, F, ST_NEIGHBORS, &fr.clk);    /* the check counts as neighbor work */
+    }
 
-                /* 1) Read snapshot positions (expects io.c to implement read_snapshot_xy) */
-        Vec2Array pos;
-        v2a_init(&pos);
-        if(!read_snapshot_xy(path, &pos)){
-            fprintf(stderr, "  ! failed to read %s (skipping)\n", path);
-            v2a_free(&pos);
-            free((void*)path);
-            continue;
-        }
-        printf("  read %zu particles\n", pos.n);   // <-- ADD THIS
+    for(int o=0;o<NOUTPUTS;o++)
+        if((R->outputs & (1u << o)) && OUTPUT_RUN[o](&fr) != 0) goto next_snapshot;
+    F->ok = 1;
 
-        if(pos.n == 0){
-            fprintf(stderr, "  ! empty snapshot %s (skipping)\n", path);
-            v2a_free(&pos);
-            free((void*)path);
-            continue;
+    if(R->mem_stats){
+        int st;
+        int64_t peak = frame_mem_peak(F, &st), nalloc = 0, bytes = 0;
+        long long rss = 0;
+        for(int k=0;k<NSTAGES;k++){
+            nalloc += F->mem_nalloc[k];
+            bytes += F->mem_bytes[k];
+            if(F->rss[k] > rss) rss = F->rss[k];
         }
+        fprintf(out, "  memory: peak %.2f MB tracked (in %s), %lld allocations of %.2f MB, RSS %.2f MB\n",
+                peak / 1048576.0, STAGE_NAMES[st], (long long)nalloc, bytes / 1048576.0, rss / 1048576.0);
+    }
 
-        /* 2) Clustering (union-find) */
-        printf("  entering clustering\n");         // <-- ADD THIS
-        int nclusters = 0;
-        int *cluster_id = find_clusters_from_vec2array(&pos, lbond, use_pbc_flag ? 1 : 0, box_x, box_y, &nclusters);
-        printf("  clustering done, nclusters = %d\n", nclusters);   // <-- ADD THIS
+    /* --numa: where the frame's buffers ended up, relative to this thread's node */
+    if(R->thread_node){
+        int node = R->thread_node[F->tid];
+        numa_count_pages(fr.pos.data, fr.pos.n * sizeof(Vec2), node, &F->pages_local, &F->pages_total);
+        numa_count_pages(fr.coms_buf.data, fr.coms_buf.n * sizeof(Vec2), node, &F->pages_local, &F->pages_total);
+        numa_count_pages(fr.psi6, (size_t)fr.M * sizeof(Complex), node, &F->pages_local, &F->pages_total);
+    }
 
+next_snapshot:
+    frame_free(&fr);
+}
 
-        // /* 1) Read snapshot positions (expects io.c to implement read_snapshot_xy) */
-        // Vec2Array pos;
-        // v2a_init(&pos);
-        // if(!read_snapshot_xy(path, &pos)){
-        //     fprintf(stderr, "  ! failed to read %s (skipping)\n", path);
-        //     v2a_free(&pos);
-        //     free((void*)path);
-        //     continue;
-        // }
-        // if(pos.n == 0){
-        //     fprintf(stderr, "  ! empty snapshot %s (skipping)\n", path);
-        //     v2a_free(&pos);
-        //     free((void*)path);
-        //     continue;
-        // }
+/* --subsample=auto: pilot pass over the first snapshots of the run */
+typedef struct {
+    RunCtx      *R;
+    FrameResult *res;         /* scratch: the pilot's stage times are not reported */
+    FILE        *sink;        /* the pilot's per-snapshot log is dropped */
+    double      *psi6_global; /* |mean psi6| of each, NAN if the snapshot failed */
+} Pilot;
 
-        // /* 2) Clustering (union-find) */
-        // int nclusters = 0;
-        // int *cluster_id = find_clusters_from_vec2array(&pos, lbond, use_pbc_flag ? 1 : 0, box_x, box_y, &nclusters);
+static void pilot_task(void *arg, int task){
+    Pilot *P = (Pilot*)arg;
+    Frame fr;
+    frame_init(&fr, P->R, (size_t)task, &P->res[task], P->sink, stderr);
+    P->psi6_global[task] = NAN;
+    if(frame_need(&fr, IM_COMS | IM_PSI6) == 0 && fr.coms->n > 0){
+        double re = 0.0, im = 0.0;
+        for(size_t i=0;i<fr.coms->n;i++){ re += fr.psi6[i].re; im += fr.psi6[i].im; }
+        P->psi6_global[task] = sqrt(re*re + im*im) / (double)fr.coms->n;
+    }
+    frame_free(&fr);
+}
 
+/* --window: add one snapshot's g6 sums; a window ending with it is queued for
+   write_windows (R->lock held) */
+static void commit_window(RunCtx *R, const G6Accum *acc, int tindex){
+    int rc = g6window_add(R->win, acc, tindex);
+    if(rc < 0){
+        fprintf(stderr, "Failed to add snapshot t=%d to the g6 window\n", tindex);
+        return;
+    }
+    if(rc == 0) return;
+    DoneWindow D;
+    D.acc = g6accum_clone(g6window_sum(R->win, &D.t0, &D.t1));
+    if(!D.acc){
+        fprintf(stderr, "Failed to copy the g6 window t=%d..%d (not written)\n", D.t0, D.t1);
+        return;
+    }
+    if(R->wq_n == R->wq_cap){
+        size_t cap = R->wq_cap ? 2 * R->wq_cap : 8;
+        DoneWindow *q = (DoneWindow*)malloc(cap * sizeof(DoneWindow));
+        if(!q){
+            fprintf(stderr, "OOM queueing the g6 window t=%d..%d (not written)\n", D.t0, D.t1);
+            g6accum_free(D.acc);
+            return;
+        }
+        for(size_t k=0;k<R->wq_n;k++) q[k] = R->wq[(R->wq_head + k) % R->wq_cap];
+        free(R->wq);
+        R->wq = q;
+        R->wq_head = 0;
+        R->wq_cap = cap;
+    }
+    R->wq[(R->wq_head + R->wq_n++) % R->wq_cap] = D;
+}
 
-        /* 2) Clustering (union-find) */
+/* --window: write the queued windows in order (R->lock not held). The files
+   are written under win_lock only, so workers committing snapshots do not
+   wait for them. */
+static void write_windows(RunCtx *R){
+    if(!R->win) return;
+    pthread_mutex_lock(&R->win_lock);
+    for(;;){
+        pthread_mutex_lock(&R->lock);
+        DoneWindow D;
+        const int have = R->wq_n > 0;
+        if(have){
+            D = R->wq[R->wq_head];
+            R->wq_head = (R->wq_head + 1) % R->wq_cap;
+            R->wq_n--;
+        }
+        pthread_mutex_unlock(&R->lock);
+        if(!have) break;
 
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/g6_avg_time_%d_%d.dat", R->out_dir, D.t0, D.t1);
+        if(g6accum_write(D.acc, path, D.t0, D.t1, R->lbond, R->use_pbc, R->box_x, R->box_y) != 0){
+            fprintf(stderr, "Failed to write g6 window file %s\n", path);
+        } else {
+            snprintf(path, sizeof(path), "%s/g6_raw_time_%d_%d.dat", R->out_dir, D.t0, D.t1);
+            if(g6accum_write_raw(D.acc, path, D.t0, D.t1, R->lbond, R->use_pbc, R->box_x, R->box_y) != 0)
+                fprintf(stderr, "Failed to write g6 window raw file %s\n", path);
+            pthread_mutex_lock(&R->lock);
+            R->nwindows++;
+            pthread_mutex_unlock(&R->lock);
+            if(VERBOSITY) printf("  window t=%d..%d: wrote g6_avg_time_%d_%d.dat\n", D.t0, D.t1, D.t0, D.t1);
+        }
+        g6accum_free(D.acc);
+    }
+    pthread_mutex_unlock(&R->win_lock);
+}
 
-        if (!cluster_id) {
-            fprintf(stderr, "  ! clustering failed (null cluster_id)\n");
-            v2a_free(&pos);
-            free((void*)path);
+/* Merge finished snapshots into the run totals in snapshot order (R->lock held) */
+static void commit_frames(RunCtx *R){
+    while(R->next_commit < R->nsel && R->res[R->next_commit].done){
+        FrameResult *F = &R->res[R->next_commit];
+        if(R->stopped){
+            /* past convergence: started before the stop, dropped unseen */
+            free(F->out);
+            free(F->err);
+            F->out = F->err = NULL;
+            if(F->acc){
+                g6accum_clear(F->acc);
+                R->spare[(size_t)F->tid * R->nsel + R->nspare[F->tid]++] = F->acc;
+                F->acc = NULL;
+            }
+            gr_free(F->gr);
+            csd_free(F->csd);
+            F->gr = NULL;
+            F->csd = NULL;
+            R->next_commit++;
             continue;
         }
+        if(F->out){ fwrite(F->out, 1, F->out_len, stdout); fflush(stdout); }
+        if(F->err){ fwrite(F->err, 1, F->err_len, stderr); fflush(stderr); }
+        free(F->out);
+        free(F->err);
+        F->out = F->err = NULL;
+        /* a snapshot that failed in any output (F->ok == 0) goes into none of
+           them: not the pooled or replica g6, windows, convergence blocks,
+           g(r) or the cluster sizes, even if some outputs had already run */
+        if(F->acc){
+            if(F->ok){
+                g6accum_merge(R->A, F->acc);
+                if(R->win) commit_window(R, F->acc, extract_time_index(R->paths[R->next_commit]));
+                if(R->rep_acc) g6accum_merge(R->rep_acc[R->rep_of[R->next_commit]], F->acc);
+                if(R->conv && g6conv_add(R->conv, F->acc) == 1){
+                    R->stopped = 1;
+                    R->stop_ip = R->next_commit;
+                    if(VERBOSITY){
+                        G6ConvReport cr;
+                        g6conv_report(R->conv, &cr);
+                        printf("g6 converged after %ld processed snapshot(s), at %s; the rest are skipped\n",
+                               cr.frames, R->paths[R->next_commit]);
+                    }
+                }
+            }
+            g6accum_clear(F->acc);
+            R->spare[(size_t)F->tid * R->nsel + R->nspare[F->tid]++] = F->acc;
+            F->acc = NULL;
+        }
+        if(F->gr){
+            if(F->ok) gr_merge(R->gr, F->gr);
+            gr_free(F->gr);
+            F->gr = NULL;
+        }
+        if(F->csd){
+            if(F->ok) csd_merge(R->csd, F->csd);
+            csd_free(F->csd);
+            F->csd = NULL;
+        }
 
-        /* DEBUG: check label range */
-        int max_id = -1, min_id = 1e9;
-        for (int i = 0; i < (int)pos.n; i++) {
-            if (cluster_id[i] < min_id) min_id = cluster_id[i];
-            if (cluster_id[i] > max_id) max_id = cluster_id[i];
+        NeighborCheck *c = R->check, *f = &F->check;
+        c->frames += f->frames;
+        c->ref_entries += f->ref_entries;
+        c->test_entries += f->test_entries;
+        c->common_entries += f->common_entries;
+        c->points += f->points;
+        c->points_identical += f->points_identical;
+        c->sum_dpsi += f->sum_dpsi;
+        if(f->max_dpsi > c->max_dpsi) c->max_dpsi = f->max_dpsi;
+        R->clusters_total += F->clusters_total;
+        R->clusters_kept += F->clusters_kept;
+        R->pages_local += F->pages_local;
+        R->pages_total += F->pages_total;
+        R->next_commit++;
+    }
+}
+
+/* Pool task: one snapshot with a per-frame accumulator, then ordered commit.
+   Tasks take snapshots in order, or longest-first (within LPT_WINDOW) when
+   R->lpt is set. */
+static void frame_task(void *arg, int task){
+    RunCtx *R = (RunCtx*)arg;
+
+    pthread_mutex_lock(&R->lock);
+    size_t ip = R->lpt ? next_frame_lpt(R) : (size_t)task;
+    if(++R->ndispatched == R->nsel){
+        /* nothing left to start: idle time from here on is the tail */
+        R->tail_t0 = now_sec();
+        R->tail_idle0 = tpool_idle_seconds(NULL);
+    }
+    if(R->stopped){
+        R->res[ip].done = 1;
+        commit_frames(R);
+        pthread_mutex_unlock(&R->lock);
+        write_windows(R);
+        return;
+    }
+    const double mem_est = frame_mem_admit(R, ip);
+    FrameResult *F = &R->res[ip];
+    const int tid = tpool_thread_id();
+    G6Accum *acc = R->nspare[tid] > 0 ? R->spare[(size_t)tid * R->nsel + --R->nspare[tid]] : NULL;
+    pthread_mutex_unlock(&R->lock);
+    if(!acc && (R->outputs & (1u << OUT_G6))){
+        acc = g6accum_create_fine(R->dr, R->opt->fine_bins);
+        if(!acc){ fprintf(stderr,"Failed to create g6 accumulator\n"); exit(1); }
+        if(R->opt->g6_chunks > 0) g6accum_set_chunks(acc, R->opt->g6_chunks);
+    }
+    F->acc = acc;
+    F->tid = tid;
+    if(R->outputs & (1u << OUT_GR)){
+        F->gr = gr_create(R->dr, R->gr_rmax);
+        if(!F->gr){ fprintf(stderr,"Failed to create g(r) accumulator\n"); exit(1); }
+    }
+    if(R->outputs & (1u << OUT_CSD)){
+        F->csd = csd_create();
+        if(!F->csd){ fprintf(stderr,"Failed to create cluster size accumulator\n"); exit(1); }
+    }
+
+    FILE *out = stdout, *err = stderr;
+    if(R->buffered){
+        out = open_memstream(&F->out, &F->out_len);
+        err = open_memstream(&F->err, &F->err_len);
+        if(!out || !err){ fprintf(stderr,"open_memstream failed\n"); exit(1); }
+    }
+    double t0 = now_sec();
+    process_frame(R, ip, F, out, err);
+    double t1 = now_sec(), sec = t1 - t0;
+    trace_event("frame", (long)ip, t0, t1);
+    if(R->buffered){
+        fclose(out);
+        fclose(err);
+    }
+
+    pthread_mutex_lock(&R->lock);
+    int b = (int)(ip * COST_BLOCKS / R->nsel);
+    R->block_sec[b] += sec;
+    R->block_bytes[b] += R->bytes[ip];
+    R->sum_sec += sec;
+    R->sum_bytes += R->bytes[ip];
+    if(R->mem_budget > 0){
+        R->nrunning--;
+        R->mem_inflight -= mem_est;
+        if(R->bytes[ip] > 0.0){
+            double rate = (double)frame_mem_peak(F, NULL) / R->bytes[ip];
+            if(rate > R->mem_rate) R->mem_rate = rate;
         }
-        printf("  cluster_id range: [%d, %d]\n", min_id, max_id);
-        if (min_id < 0 || max_id >= nclusters) {
-            fprintf(stderr,
-                    "  !! ERROR: cluster_id out of range: min=%d max=%d nclusters=%d\n",
-                    min_id, max_id, nclusters);
-            /* bail out so we see the message instead of segfault */
-            free(cluster_id);
+        pthread_cond_broadcast(&R->mem_cv);
+    }
+    F->done = 1;
+    commit_frames(R);
+    pthread_mutex_unlock(&R->lock);
+    write_windows(R);
+}
+
+/* --io-bench: ask the kernel to drop the cached pages of the files (clean
+   pages only; a no-op on tmpfs) so every pass starts cold */
+static void io_bench_drop_cache(char *const *paths, size_t n){
+    for(size_t k=0;k<n;k++){
+        int fd = open(paths[k], O_RDONLY | O_CLOEXEC);
+        if(fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/*
+ * io_bench
+ *
+ * Read the n selected files four ways, each from a cold page cache, and
+ * print files/s and MB/s: read_snapshot_xy (the default path), whole-file
+ * read_file_bytes + parse_snapshot_xy, and the io_uring loader with and
+ * without the parse. The particle totals of the parsing passes must agree.
+ * Returns 0 on success.
+ */
+static int io_bench(char *const *paths, size_t n, int depth){
+    static const char *const NAMES[4] = { "read_snapshot_xy", "read_file_bytes+parse",
+                                          "io_uring+parse", "io_uring only" };
+    double sec[4] = {0}, bytes[4] = {0};
+    size_t particles[4] = {0}, failed[4] = {0};
+    long uring = 0, fallback = 0;
+    for(int pass=0;pass<4;pass++){
+        io_bench_drop_cache(paths, n);
+        FileLoader *L = NULL;
+        const double t0 = now_sec();
+        if(pass >= 2){
+            L = loader_open(paths, n, depth);
+            if(!L){ fprintf(stderr,"--io-bench: io_uring unavailable, loader passes skipped\n"); break; }
+        }
+        for(size_t k=0;k<n;k++){
+            Vec2Array pos;
+            v2a_init(&pos);
+            char *buf = NULL;
+            size_t len = 0;
+            int ok = 1;
+            if(pass == 0) ok = read_snapshot_xy(paths[k], &pos);
+            else if(pass == 1) ok = read_file_bytes(paths[k], &buf, &len);
+            else ok = loader_take(L, k, &buf, &len);
+            if(ok && buf && pass != 3) parse_snapshot_xy(buf, len, &pos);
+            if(ok){
+                particles[pass] += pos.n;
+                bytes[pass] += (double)len;
+            } else {
+                failed[pass]++;
+            }
+            mem_free(buf);
             v2a_free(&pos);
-            free((void*)path);
-            continue;
         }
+        if(L){
+            if(pass == 3) loader_stats(L, &uring, &fallback);
+            loader_close(L);
+        }
+        sec[pass] = now_sec() - t0;
+    }
+    /* read_snapshot_xy does not report bytes: the file sizes stand in */
+    bytes[0] = bytes[1];
+    printf("I/O benchmark: %zu files, io_uring depth %d\n", n, depth);
+    printf("  %-22s %10s %10s %10s %12s %7s\n", "reader", "seconds", "files/s", "MB/s", "particles", "failed");
+    int bad = 0;
+    for(int pass=0;pass<4;pass++){
+        if(sec[pass] <= 0.0) continue;
+        printf("  %-22s %10.4f %10.1f %10.1f %12zu %7zu\n", NAMES[pass], sec[pass], (double)n / sec[pass],
+               bytes[pass] / 1048576.0 / sec[pass], particles[pass], failed[pass]);
+        if(pass < 3 && particles[pass] != particles[0]) bad = 1;
+    }
+    if(sec[3] > 0.0) printf("  io_uring: %ld file(s) through the ring, %ld through the plain fallback\n", uring, fallback);
+    if(bad) fprintf(stderr,"--io-bench: the readers disagree on the particle count\n");
+    return bad;
+}
 
-        // if(!cluster_id){
-        //     fprintf(stderr, "  ! clustering failed (skipping)\n");
-        //     v2a_free(&pos);
-        //     free((void*)path);
-        //     continue;
-        // }
-        // if(nclusters < 2){
-        //     if(VERBOSITY) printf("  ! less than 2 clusters (%d) — skipping\n", nclusters);
-        //     free(cluster_id);
-        //     v2a_free(&pos);
-        //     free((void*)path);
-        //     continue;
-        // }
-
-        /* 3) Build IntArray clusters and compute COMs */
-        printf("  building clusters (make_clusters_from_ids)\n");
-        IntArray *clusters = make_clusters_from_ids(cluster_id, (int)pos.n, nclusters);
-        if (!clusters) {
-            fprintf(stderr, "  ! make_clusters_from_ids returned NULL\n");
-            free(cluster_id);
-            v2a_free(&pos);
-            free((void*)path);
+/* ------------------------------- main ---------------------------------- */
+int main(int argc, char **argv){
+    const char *data_dir = DEFAULT_DATA_DIR;
+    const char *out_dir  = DEFAULT_OUTPUT_DIR;
+    int start_idx = DEFAULT_START_IDX;
+    int end_idx   = DEFAULT_END_IDX;
+    double lbond  = DEFAULT_LBOND;
+    double dr     = DEFAULT_DR;
+    int use_pbc_flag = 1;
+    double box_x = 180.0, box_y = 180.0;
+
+    Options opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.nbr.engine = NEIGHBOR_ENGINE_TRIANGLE;
+    opt.nbr.knn_k = 6;
+    opt.min_cluster_size = 1;
+    opt.max_cluster_size = 0;
+    g6accum_mc_defaults(&opt.mc);
+    opt.threads = 1;
+    opt.g6_chunks = 0;
+    opt.fine_bins = G6ACCUM_DEFAULT_SUBDIV;
+    opt.outputs = 1u << OUT_G6;
+    opt.g6_conv_every = 20;
+    opt.subsample_pilot = 100;
+    NeighborCheck check;
+    memset(&check, 0, sizeof(check));
+
+    /* split --options from positional args */
+    char **args = (char**)malloc((size_t)argc * sizeof(char*));
+    if(!args){ fprintf(stderr,"OOM\n"); return 1; }
+    int nargs = 0;
+    args[nargs++] = argv[0];
+    for(int i=1;i<argc;i++){
+        if(strncmp(argv[i], "--", 2) == 0){
+            if(parse_option(argv[i], &opt) != 0){
+                fprintf(stderr, "Unknown or invalid option: %s\n", argv[i]);
+                usage(argv[0]);
+                free(args);
+                return 1;
+            }
             continue;
         }
-        printf("  clusters built\n");
-
-        
-        Vec2Array coms;
-        v2a_init(&coms);
-        printf("  computing COMs\n");
-        if(compute_cluster_coms(&pos, clusters, nclusters, use_pbc_flag ? 1 : 0, box_x, box_y, &coms) != 0){
-            fprintf(stderr, "  ! compute_cluster_coms failed (skipping)\n");
-            for(int k=0;k<nclusters;k++) ia_free(&clusters[k]);
-            free(clusters);
-            free(cluster_id);
-            v2a_free(&pos);
-            free((void*)path);
-            continue;
+        args[nargs++] = argv[i];
+    }
+
+    if(nargs < 5){
+        if(nargs == 1){
+            fprintf(stderr, "No args supplied — using defaults. To see usage, run with -h\n");
+        } else {
+            usage(argv[0]);
+            free(args);
+            return 1;
         }
-        printf("  COMs computed: %zu clusters\n", coms.n);
-        /* 4) Delaunay neighbors (with PBC images) */
-        int M;
-        IntArray *neighbors = triangulate_get_neighbors(&coms, use_pbc_flag ? 1 : 0, box_x, box_y, &M);
-        printf("  triangulation returned neighbors, M = %d\n", M);
-        if(!neighbors || M != (int)coms.n){
-            fprintf(stderr, "  ! triangulate_get_neighbors failed (skipping)\n");
-            if(neighbors) neighbors_free(neighbors, M);
-            v2a_free(&coms);
-            for(int k=0;k<nclusters;k++) ia_free(&clusters[k]);
-            free(clusters);
-            free(cluster_id);
-            v2a_free(&pos);
-            free((void*)path);
-            continue;
+    } else {
+        data_dir = args[1];
+        start_idx = atoi(args[2]);
+        end_idx   = atoi(args[3]);
+        out_dir   = args[4];
+        if(nargs >= 6) lbond = atof(args[5]);
+        if(nargs >= 7) dr    = atof(args[6]);
+        if(nargs >= 8) use_pbc_flag = atoi(args[7]);
+        if(nargs >= 10) {
+            box_x = atof(args[8]);
+            box_y = atof(args[9]);
         }
+    }
+    free(args);
 
-        /* 5) psi6 */
-        printf("  computing psi6\n");
-        Complex *psi6 = compute_psi6_from_neighbors(&coms, neighbors, use_pbc_flag ? 1 : 0, box_x, box_y);
-        if(!psi6){
-            fprintf(stderr, "  ! compute_psi6 failed (skipping)\n");
-            neighbors_free(neighbors, M);
-            v2a_free(&coms);
-            for(int k=0;k<nclusters;k++) ia_free(&clusters[k]);
-            free(clusters);
-            free(cluster_id);
-            v2a_free(&pos);
-            free((void*)path);
-            continue;
+    if(start_idx > end_idx){
+        fprintf(stderr, "start index (%d) > end index (%d)\n", start_idx, end_idx);
+        return 1;
+    }
+    if(opt.window > 0 && !(opt.outputs & (1u << OUT_G6))){
+        fprintf(stderr, "--window needs the g6 output (--outputs=g6,...)\n");
+        return 1;
+    }
+    if(opt.g6_conv_tol > 0.0 && !(opt.outputs & (1u << OUT_G6))){
+        fprintf(stderr, "--g6-conv-tol needs the g6 output (--outputs=g6,...)\n");
+        return 1;
+    }
+    if(opt.g6_conv_rmax == 0.0) opt.g6_conv_rmax = 10.0 * dr;
+
+    ensure_output_dir(out_dir);
+
+    /* Replicas: DATA_DIR may list several directories (comma list / glob) */
+    char **dirs = NULL;
+    const int nrep = expand_data_dirs(data_dir, &dirs);
+    if(nrep < 1){
+        fprintf(stderr, "No data directories match %s\n", data_dir);
+        return 1;
+    }
+    if(nrep > 1 && (opt.window > 0 || opt.g6_conv_tol > 0.0)){
+        fprintf(stderr, "--window and --g6-conv-tol take a single DATA_DIR\n");
+        return 1;
+    }
+
+    /* Snapshots in the index range, time-ordered within each replica and
+       replica after replica; rep_of[ip] is the replica of snapshot ip */
+    char **paths = NULL;
+    int *rep_of = NULL;
+    size_t nsel = 0;
+    for(int r=0;r<nrep;r++){
+        const size_t n0 = nsel;
+        if(collect_snapshots(dirs[r], start_idx, end_idx, &paths, &nsel) != 0) return 1;
+        if(nrep > 1){
+            int *nr = (int*)realloc(rep_of, (nsel > 0 ? nsel : 1) * sizeof(int));
+            if(!nr){ fprintf(stderr,"OOM\n"); return 1; }
+            rep_of = nr;
+            for(size_t ip=n0; ip<nsel; ip++) rep_of[ip] = r;
+            if(VERBOSITY) printf("Replica %d: %s, %zu files\n", r, dirs[r], nsel - n0);
+        }
+        if(nsel == n0){
+            fprintf(stderr, "No files found in range %d..%d in %s\n", start_idx, end_idx, dirs[r]);
+            return 1;
         }
-        printf("  psi6 computed\n");
-        /* 6) accumulate g6 */
-        g6accum_accumulate(A, &coms, psi6, use_pbc_flag ? 1 : 0, box_x, box_y);
+    }
+    if(VERBOSITY) printf("Found %zu files in range [%d, %d]\n", nsel, start_idx, end_idx);
 
-        /* cleanup per-snapshot */
-        free(psi6);
-        neighbors_free(neighbors, M);
+    if(opt.trace_path){
+        if(trace_open(opt.trace_path, 0) != 0) return 1;
+        trace_thread_name("main");
+    }
 
-        v2a_free(&coms);
-        for(int k=0;k<nclusters;k++) ia_free(&clusters[k]);
-        free(clusters);
+    /* Process-wide thread pool, used by every stage through tpool_default() */
+    const int nthreads = opt.threads;
+    TPool *pool = NULL;
+    if(nthreads > 1){
+        pool = tpool_create(nthreads);
+        if(!pool){ fprintf(stderr,"Failed to create thread pool\n"); return 1; }
+        tpool_set_default(pool);
+        if(VERBOSITY) printf("Using %d threads\n", tpool_size(pool));
+    }
+    int *thread_node = NULL;
+    if(opt.numa){
+        NumaTopo topo;
+        const int nt = tpool_size(pool);
+        int *cpus = (int*)malloc((size_t)nt * sizeof(int));
+        thread_node = (int*)malloc((size_t)nt * sizeof(int));
+        if(!cpus || !thread_node || numa_topo_read(&topo) != 0){
+            fprintf(stderr,"Failed to read the NUMA topology\n");
+            return 1;
+        }
+        numa_assign_cpus(&topo, nt, cpus, thread_node);
+        if(tpool_pin(pool, cpus) != 0) fprintf(stderr,"Warning: could not pin every thread\n");
+        if(VERBOSITY) printf("NUMA: %d node(s), %d thread(s) assigned round-robin\n", topo.nnodes, nt);
+        numa_topo_free(&topo);
+        free(cpus);
+    }
+
+    /* Create accumulator */
+    G6Accum *A = g6accum_create_fine(dr, opt.fine_bins);
+    if(A && opt.out_binning && g6accum_set_binning(A, &opt.out) != 0){
+        g6accum_free(A);
+        A = NULL;
+    }
+    if(!A){ fprintf(stderr,"Failed to create g6 accumulator\n"); for(size_t i=0;i<nsel;i++) free(paths[i]); free(paths); return 1; }
 
-        free(cluster_id);
-        v2a_free(&pos);
+    /* Cluster-size filter totals (kept-count is recorded in the output header) */
+    const int size_filter = opt.min_cluster_size > 1 || opt.max_cluster_size > 0;
 
-        free((void*)path);
+    /* Process snapshots: one pool task each, merged in snapshot order */
+    RunCtx run;
+    memset(&run, 0, sizeof(run));
+    run.opt = &opt;
+    run.paths = paths;
+    run.nsel = nsel;
+    run.lbond = lbond;
+    run.dr = dr;
+    run.use_pbc = use_pbc_flag ? 1 : 0;
+    run.box_x = box_x;
+    run.box_y = box_y;
+    run.buffered = tpool_size(pool) > 1;
+    run.A = A;
+    run.nrep = nrep;
+    run.rep_of = rep_of;
+    if(nrep > 1 && (opt.outputs & (1u << OUT_G6))){
+        run.rep_acc = (G6Accum**)calloc((size_t)nrep, sizeof(G6Accum*));
+        if(!run.rep_acc){ fprintf(stderr,"OOM\n"); return 1; }
+        for(int r=0;r<nrep;r++){
+            run.rep_acc[r] = g6accum_create_fine(dr, opt.fine_bins);
+            if(!run.rep_acc[r] || (opt.out_binning && g6accum_set_binning(run.rep_acc[r], &opt.out) != 0)){
+                fprintf(stderr,"Failed to create g6 accumulator\n");
+                return 1;
+            }
+        }
+    }
+    run.outputs = opt.outputs;
+    run.gr_rmax = 0.5 * (box_x < box_y ? box_x : box_y);
+    if(opt.outputs & (1u << OUT_GR)) run.gr = gr_create(dr, run.gr_rmax);
+    if(opt.outputs & (1u << OUT_CSD)) run.csd = csd_create();
+    if(((opt.outputs & (1u << OUT_GR)) && !run.gr) || ((opt.outputs & (1u << OUT_CSD)) && !run.csd)) return 1;
+    run.out_dir = out_dir;
+    if(opt.window > 0){
+        run.win = g6window_create(opt.window, opt.window_stride, dr, opt.fine_bins,
+                                  opt.out_binning ? &opt.out : NULL);
+        if(!run.win) return 1;
+        G6Accum *W = g6window_sum(run.win, NULL, NULL);
+        g6accum_add_note(W, "Window: %d snapshots, one every %d (of time_%d .. time_%d)",
+                         opt.window, opt.window_stride, start_idx, end_idx);
+        if(size_filter)
+            g6accum_add_note(W, "Cluster size filter: min = %d  max = %d (0 = no limit)",
+                             opt.min_cluster_size, opt.max_cluster_size);
+        if(opt.g6_mc)
+            g6accum_add_note(W, "MC params: tol = %.4g  min_samples = %ld  max_samples = %ld  seed = %llu",
+                             opt.mc.tol, opt.mc.min_samples, opt.mc.max_samples, opt.mc.seed);
+    }
+    if(opt.g6_conv_tol > 0.0){
+        run.conv = g6conv_create(opt.g6_conv_tol, opt.g6_conv_every, dr, opt.g6_conv_rmin, opt.g6_conv_rmax);
+        if(!run.conv) return 1;
+    }
+    run.check = &check;
+    run.res = (FrameResult*)calloc(nsel, sizeof(FrameResult));
+    run.nthreads = tpool_size(pool);
+    run.spare = (G6Accum**)calloc(nsel * (size_t)run.nthreads, sizeof(G6Accum*));
+    run.nspare = (size_t*)calloc((size_t)run.nthreads, sizeof(size_t));
+    run.thread_node = thread_node;
+    unsigned perf_mask = 0;
+    if(opt.perf_counters){
+        perf_mask = perfctr_enable();
+        run.perf = 1;
+        if(perf_mask == 0) fprintf(stderr, "Warning: no performance counters available (perf_event_open); timings only\n");
+    }
+    run.left = (size_t*)malloc(nsel * sizeof(size_t));
+    run.bytes = (double*)malloc(nsel * sizeof(double));
+    if(!run.res || !run.spare || !run.nspare || !run.left || !run.bytes){ fprintf(stderr,"OOM\n"); return 1; }
+    /* in order when stopping early, so no work goes past the stop point */
+    run.lpt = run.buffered && !run.conv;
+    run.mem_stats = opt.mem_stats;
+    run.mem_budget = opt.mem_budget;
+    if(opt.cache_dir){
+        ensure_output_dir(opt.cache_dir);
+        run.cache = framecache_open(opt.cache_dir, opt.cache_max);
+        if(!run.cache) return 1;
+        framecache_trim(run.cache);
     }
 
+    /* --subsample: keep every k-th snapshot; auto picks k = ceil(2 tau_int) of
+       the global |psi6| over a pilot of the first snapshots, so the frames
+       used are nearly independent */
+    const size_t nsel_all = nsel;
+    int stride = opt.subsample > 0 ? opt.subsample : 1, npilot = 0, tau_window = 0;
+    double tau = 0.0, ess = 0.0;
+    if(opt.subsample < 0){
+        /* the pilot series must not run across replicas (independent runs):
+           it uses the first replica only, whose snapshots come first */
+        size_t nfirst = nsel;
+        if(rep_of) for(nfirst = 0; nfirst < nsel && rep_of[nfirst] == rep_of[0]; nfirst++) ;
+        npilot = nfirst < (size_t)opt.subsample_pilot ? (int)nfirst : opt.subsample_pilot;
+        if(nrep > 1 && nfirst < (size_t)opt.subsample_pilot)
+            fprintf(stderr, "Warning: subsample pilot cut to the %zu snapshot(s) of the first replica %s "
+                    "(asked for %d)\n", nfirst, dirs[0], opt.subsample_pilot);
+        Pilot P;
+        P.R = &run;
+        P.res = (FrameResult*)calloc((size_t)npilot, sizeof(FrameResult));
+        P.sink = fopen("/dev/null", "w");
+        P.psi6_global = (double*)malloc((size_t)npilot * sizeof(double));
+        double *rho = (double*)malloc((size_t)npilot * sizeof(double));
+        if(!P.res || !P.sink || !P.psi6_global || !rho){ fprintf(stderr,"Subsample pilot: OOM\n"); return 1; }
+        tpool_run(pool, npilot, pilot_task, &P);
+        int n = 0;
+        for(int k=0;k<npilot;k++) if(!isnan(P.psi6_global[k])) P.psi6_global[n++] = P.psi6_global[k];
+        const int maxlag = n / 2;
+        if(n < 10 || autocorr_rho(P.psi6_global, n, maxlag, rho) != 0){
+            fprintf(stderr, "Warning: subsample pilot has no usable |psi6| series; all snapshots used\n");
+            tau = 0.5;
+            tau_window = 0;
+        } else {
+            tau = autocorr_tau_int(rho, maxlag, &tau_window);
+            stride = (int)ceil(2.0 * tau);
+            if(stride < 1) stride = 1;
+            if(tau_window < 0)
+                fprintf(stderr, "Warning: pilot of %d snapshots is too short for tau_int(|psi6|) = %.2f; "
+                        "it is a lower bound (use --subsample=auto:P with a larger P)\n", npilot, tau);
+        }
+        size_t nused = 0, len = 0;
+        for(size_t ip=0; ip<nsel; ip++){
+            len++;
+            if(ip + 1 == nsel || (rep_of && rep_of[ip+1] != rep_of[ip])){
+                nused += (len + (size_t)stride - 1) / (size_t)stride;
+                len = 0;
+            }
+        }
+        const double tau_k = tau_window > 0 ? autocorr_tau_strided(rho, tau_window, stride) : 0.5;
+        ess = (double)nused / (2.0 * tau_k);
+        if(VERBOSITY) printf("Subsample pilot: %d snapshots, tau_int(|psi6|) = %.3f (window %d), stride %d, "
+                             "%zu snapshots used, effective sample size %.1f\n",
+                             n, tau, tau_window, stride, nused, ess);
+        fclose(P.sink);
+        free(P.res);
+        free(P.psi6_global);
+        free(rho);
+    }
+    if(stride > 1){
+        /* every stride-th snapshot of each replica, counted from its first */
+        size_t n = 0, pos = 0;
+        for(size_t ip=0; ip<nsel; ip++){
+            if(ip > 0 && rep_of && rep_of[ip] != rep_of[ip-1]) pos = 0;
+            if(pos++ % (size_t)stride == 0){
+                if(rep_of) rep_of[n] = rep_of[ip];
+                paths[n++] = paths[ip];
+            } else {
+                free(paths[ip]);
+            }
+        }
+        nsel = run.nsel = n;
+        if(VERBOSITY && opt.subsample > 0) printf("Subsampling: stride %d, %zu of %zu snapshots used\n", stride, nsel, nsel_all);
+    }
+
+    if(opt.io_bench){
+        const int rc = io_bench(paths, nsel, opt.io_uring > 0 ? opt.io_uring : 32);
+        for(size_t i=0;i<nsel;i++) free(paths[i]);
+        free(paths);
+        return rc;
+    }
+    if(opt.io_uring > 0){
+        run.loader = loader_open(paths, nsel, opt.io_uring);
+        if(!run.loader) fprintf(stderr, "Warning: --io-uring unavailable; reading files directly\n");
+    }
+
+    /* up-front cost estimate: file size (particle count); with several threads
+       the most expensive snapshots start first so none is left for the end */
+    for(size_t ip=0; ip<nsel; ip++){
+        struct stat st;
+        run.bytes[ip] = stat(paths[ip], &st) == 0 ? (double)st.st_size : 0.0;
+        run.left[ip] = ip;
+    }
+    run.nleft = nsel;
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_mutex_init(&run.win_lock, NULL);
+    pthread_cond_init(&run.mem_cv, NULL);
+    double wall0 = now_sec();
+    tpool_run(pool, (int)nsel, frame_task, &run);
+    double wall = now_sec() - wall0, tail = now_sec() - run.tail_t0;
+    double idle = tpool_idle_seconds(pool) - run.tail_idle0;
+    pthread_mutex_destroy(&run.lock);
+    pthread_mutex_destroy(&run.win_lock);
+    pthread_cond_destroy(&run.mem_cv);
+
+    /* timing summary: stage totals over snapshots, and the thread time left
+       idle after the last snapshot started (the tail of the run; idle time
+       before it, e.g. waits on another thread's g6 chunks, is not counted) */
+    if(VERBOSITY){
+        double stage[NSTAGES] = {0}, busy = 0.0;
+        for(size_t ip=0; ip<nsel; ip++)
+            for(int k=0;k<NSTAGES;k++){ stage[k] += run.res[ip].stage[k]; busy += run.res[ip].stage[k]; }
+        printf("Timing: %.3f s wall on %d thread(s), %.3f s in stages\n", wall, tpool_size(pool), busy);
+        printf("  ");
+        for(int k=0;k<NSTAGES;k++) printf("%s %.3f s%s", STAGE_NAMES[k], stage[k], k + 1 < NSTAGES ? ", " : "\n");
+        if(tpool_size(pool) > 1)
+            printf("  tail idle %.3f thread-s in the last %.3f s (%.1f%% of %.3f thread-s)\n",
+                   idle, tail, 100.0 * idle / (wall * tpool_size(pool)), wall * tpool_size(pool));
+        if(perf_mask){
+            /* counted on the thread running the stage, which while it waits
+               runs only its own snapshot's psi6 / g6 chunks (tpool.h); chunks
+               taken by idle threads are not counted */
+            uint64_t ctr[NSTAGES][PERFCTR_N];
+            memset(ctr, 0, sizeof(ctr));
+            for(size_t ip=0; ip<nsel; ip++)
+                for(int k=0;k<NSTAGES;k++)
+                    for(int e=0;e<PERFCTR_N;e++) ctr[k][e] += run.res[ip].ctr[k][e];
+            printf("  %-10s", "counters");
+            for(int e=0;e<PERFCTR_N;e++) printf(" %14s", PERFCTR_NAMES[e]);
+            printf(" %6s\n", "IPC");
+            for(int k=0;k<NSTAGES;k++){
+                printf("  %-10s", STAGE_NAMES[k]);
+                for(int e=0;e<PERFCTR_N;e++){
+                    if(perf_mask & (1u << e)) printf(" %14llu", (unsigned long long)ctr[k][e]);
+                    else printf(" %14s", "n/a");
+                }
+                if((perf_mask & (1u << PERFCTR_CYCLES)) && (perf_mask & (1u << PERFCTR_INSTRUCTIONS)) && ctr[k][PERFCTR_CYCLES] > 0)
+                    printf(" %6.2f\n", (double)ctr[k][PERFCTR_INSTRUCTIONS] / (double)ctr[k][PERFCTR_CYCLES]);
+                else
+                    printf(" %6s\n", "n/a");
+            }
+        }
+    }
+    if(opt.mem_stats && VERBOSITY){
+        /* like the counters, charged to the thread running the stage; peak is
+           the high-water of the snapshot's live bytes above its start */
+        int64_t peak[NSTAGES] = {0}, nalloc[NSTAGES] = {0}, bytes[NSTAGES] = {0};
+        long long rss[NSTAGES] = {0};
+        for(size_t ip=0; ip<nsel; ip++)
+            for(int k=0;k<NSTAGES;k++){
+                const FrameResult *F = &run.res[ip];
+                if(F->mem_peak[k] > peak[k]) peak[k] = F->mem_peak[k];
+                if(F->rss[k] > rss[k]) rss[k] = F->rss[k];
+                nalloc[k] += F->mem_nalloc[k];
+                bytes[k] += F->mem_bytes[k];
+            }
+        printf("Memory: tracked peak %.2f MB, RSS peak %.2f MB\n",
+               mem_peak() / 1048576.0, mem_rss_peak_bytes() / 1048576.0);
+        printf("  %-10s %12s %14s %14s %12s\n", "stage", "allocations", "allocated MB", "max peak MB", "max RSS MB");
+        for(int k=0;k<NSTAGES;k++)
+            printf("  %-10s %12lld %14.2f %14.2f %12.2f\n", STAGE_NAMES[k], (long long)nalloc[k],
+                   bytes[k] / 1048576.0, peak[k] / 1048576.0, rss[k] / 1048576.0);
+    }
+    if(opt.mem_budget > 0 && VERBOSITY)
+        printf("Memory budget %.2f MB: %ld snapshot start(s) delayed, %.3f s waited\n",
+               opt.mem_budget / 1048576.0, run.mem_waits, run.mem_wait_sec);
+    if(run.cache){
+        long hits, misses, rejected;
+        framecache_stats(run.cache, &hits, &misses, &rejected);
+        framecache_close(run.cache);
+        if(VERBOSITY) printf("Cache %s: %ld hit(s), %ld miss(es), %ld rejected entr%s\n",
+                             opt.cache_dir, hits, misses, rejected, rejected == 1 ? "y" : "ies");
+    }
+    if(run.loader){
+        long uring, fallback;
+        loader_stats(run.loader, &uring, &fallback);
+        loader_close(run.loader);
+        if(VERBOSITY) printf("io_uring: %ld file(s) read through the ring, %ld through the plain fallback\n",
+                             uring, fallback);
+    }
+    if(run.win){
+        if(VERBOSITY) printf("Windows: wrote %ld g6 window(s) of %d snapshots every %d; %d trailing snapshot(s) not in a window\n",
+                             run.nwindows, opt.window, opt.window_stride, g6window_pending(run.win));
+        g6window_free(run.win);
+        free(run.wq);
+    }
+    if(opt.numa && VERBOSITY){
+        if(run.pages_total > 0)
+            printf("NUMA: %ld of %ld pages of snapshot buffers on the worker's node (remote ratio %.3f)\n",
+                   run.pages_local, run.pages_total,
+                   (double)(run.pages_total - run.pages_local) / (double)run.pages_total);
+        else
+            printf("NUMA: page placement not available\n");
+    }
+    free(thread_node);
+    free(run.left);
+    free(run.bytes);
+    for(int th=0;th<run.nthreads;th++)
+        for(size_t k=0;k<run.nspare[th];k++) g6accum_free(run.spare[(size_t)th * nsel + k]);
+    free(run.spare);
+    free(run.nspare);
+    free(run.res);
+    const long clusters_total = run.clusters_total, clusters_kept = run.clusters_kept;
+    /* time indices of the snapshots used (fewer after an early stop) */
+    int used_t0 = extract_time_index(paths[0]), used_t1 = extract_time_index(paths[nsel - 1]);
+    if(run.stopped) used_t1 = extract_time_index(paths[run.stop_ip]);
+    for(size_t ip=0; ip<nsel; ip++) free(paths[ip]);
+    tpool_free(pool);
     free(paths);
 
-    /* Write averaged file */
-    char outpath[4096];
-    snprintf(outpath, sizeof(outpath), "%s/g6_avg_time_%d_%d.dat", out_dir, start_idx, end_idx);
-    if(g6accum_write(A, outpath, start_idx, end_idx, lbond, use_pbc_flag ? 1 : 0, box_x, box_y) != 0){
-        fprintf(stderr, "Failed to write g6 average file\n");
-        g6accum_free(A);
-        return 1;
+    if(size_filter){
+        g6accum_add_note(A, "Cluster size filter: min = %d  max = %d (0 = no limit)",
+                         opt.min_cluster_size, opt.max_cluster_size);
+        g6accum_add_note(A, "Clusters kept: %ld of %ld", clusters_kept, clusters_total);
+        if(VERBOSITY) printf("Size filter kept %ld of %ld clusters\n", clusters_kept, clusters_total);
+    }
+
+    if(run.conv){
+        G6ConvReport cr;
+        g6conv_report(run.conv, &cr);
+        g6accum_add_note(A, "Convergence: tol = %.4g  r in [%.8g, %.8g)  checked every %d snapshots",
+                         opt.g6_conv_tol, opt.g6_conv_rmin, opt.g6_conv_rmax, opt.g6_conv_every);
+        g6accum_add_note(A, "Convergence: %s; used %ld of %zu snapshots (time_%d .. time_%d), "
+                         "max relative block error %.4e, max relative change %.4e",
+                         cr.converged ? "converged" : "not converged", cr.frames, nsel,
+                         used_t0, used_t1, cr.max_err, cr.max_change);
+        if(VERBOSITY) printf("Convergence: %s, %ld of %zu snapshots used, relative error %.3e, change %.3e\n",
+                             cr.converged ? "converged" : "not converged", cr.frames, nsel, cr.max_err, cr.max_change);
+        g6conv_free(run.conv);
+    }
+
+    if(opt.subsample < 0){
+        g6accum_add_note(A, "Subsampling: stride %d = ceil(2 tau_int) with tau_int(|psi6|) = %.4g "
+                         "from a pilot of %d snapshots%s (window %d)", stride, tau, npilot,
+                         nrep > 1 ? " of the first replica" : "", tau_window);
+        g6accum_add_note(A, "Subsampling: %zu of %zu snapshots used, effective sample size %.1f", nsel, nsel_all, ess);
+    } else if(stride > 1){
+        g6accum_add_note(A, "Subsampling: stride %d (fixed), %zu of %zu snapshots used", stride, nsel, nsel_all);
+    }
+
+    if(opt.g6_mc){
+        g6accum_add_note(A, "MC params: tol = %.4g  min_samples = %ld  max_samples = %ld  seed = %llu",
+                         opt.mc.tol, opt.mc.min_samples, opt.mc.max_samples, opt.mc.seed);
+    }
+
+    if(nrep > 1){
+        g6accum_add_note(A, "Replicas: %d data directories, pooled (per replica: g6_avg_repK_time_%d_%d.dat, "
+                         "spread: g6_ens_time_%d_%d.dat)", nrep, start_idx, end_idx, start_idx, end_idx);
+    }
+
+    /* Write averaged files of the requested outputs */
+    double tw0 = now_sec();
+    char outpath[4096] = "";
+    if(opt.outputs & (1u << OUT_G6)){
+        snprintf(outpath, sizeof(outpath), "%s/g6_avg_time_%d_%d.dat", out_dir, start_idx, end_idx);
+        if(g6accum_write(A, outpath, start_idx, end_idx, lbond, use_pbc_flag ? 1 : 0, box_x, box_y) != 0){
+            fprintf(stderr, "Failed to write g6 average file\n");
+            g6accum_free(A);
+            return 1;
+        }
+        char rawpath[4096];
+        snprintf(rawpath, sizeof(rawpath), "%s/g6_raw_time_%d_%d.dat", out_dir, start_idx, end_idx);
+        if(g6accum_write_raw(A, rawpath, start_idx, end_idx, lbond, use_pbc_flag ? 1 : 0, box_x, box_y) != 0){
+            fprintf(stderr, "Failed to write g6 raw file\n");
+        }
+        if(run.rep_acc){
+            /* one file per replica, then the pooled average with the replica spread */
+            for(int r=0;r<nrep;r++){
+                char reppath[4096];
+                snprintf(reppath, sizeof(reppath), "%s/g6_avg_rep%d_time_%d_%d.dat", out_dir, r, start_idx, end_idx);
+                g6accum_add_note(run.rep_acc[r], "Replica %d of %d: %s", r, nrep, dirs[r]);
+                if(g6accum_write(run.rep_acc[r], reppath, start_idx, end_idx, lbond, use_pbc_flag ? 1 : 0, box_x, box_y) != 0)
+                    fprintf(stderr, "Failed to write replica g6 file %s\n", reppath);
+            }
+            char enspath[4096];
+            snprintf(enspath, sizeof(enspath), "%s/g6_ens_time_%d_%d.dat", out_dir, start_idx, end_idx);
+            if(g6accum_write_ensemble(A, run.rep_acc, nrep, enspath, start_idx, end_idx, lbond,
+                                      use_pbc_flag ? 1 : 0, box_x, box_y) != 0)
+                fprintf(stderr, "Failed to write g6 ensemble file\n");
+            else if(VERBOSITY) printf("Wrote %s (%d replicas)\n", enspath, nrep);
+            for(int r=0;r<nrep;r++) g6accum_free(run.rep_acc[r]);
+            free(run.rep_acc);
+        }
     }
     g6accum_free(A);
+    for(int r=0;r<nrep;r++) free(dirs[r]);
+    free(dirs);
+    free(rep_of);
+    if(run.gr){
+        char grpath[4096];
+        snprintf(grpath, sizeof(grpath), "%s/gr_time_%d_%d.dat", out_dir, start_idx, end_idx);
+        if(gr_write(run.gr, grpath, start_idx, end_idx, use_pbc_flag ? 1 : 0, box_x, box_y) != 0){
+            fprintf(stderr, "Failed to write g(r) file\n");
+            return 1;
+        }
+        if(!outpath[0]) snprintf(outpath, sizeof(outpath), "%s", grpath);
+        else if(VERBOSITY) printf("Wrote %s\n", grpath);
+        gr_free(run.gr);
+    }
+    if(run.csd){
+        char csdpath[4096];
+        snprintf(csdpath, sizeof(csdpath), "%s/csd_time_%d_%d.dat", out_dir, start_idx, end_idx);
+        if(csd_write(run.csd, csdpath, start_idx, end_idx, lbond) != 0){
+            fprintf(stderr, "Failed to write cluster size file\n");
+            return 1;
+        }
+        if(!outpath[0]) snprintf(outpath, sizeof(outpath), "%s", csdpath);
+        else if(VERBOSITY) printf("Wrote %s\n", csdpath);
+        csd_free(run.csd);
+    }
+    trace_event("write", -1, tw0, now_sec());
+
+    if(check.frames > 0){
+        long uni = check.ref_entries + check.test_entries - check.common_entries;
+        printf("Neighbor check summary (%s vs triangle, %ld snapshots):\n"
+               "  entries %ld vs %ld, common %ld (Jaccard %.4f)\n"
+               "  identical neighbor sets: %ld / %ld points (%.2f%%)\n"
+               "  |psi6 - psi6_triangle|: mean %.4e, max %.4e\n",
+               neighbor_engine_name(opt.nbr.engine), check.frames,
+               check.test_entries, check.ref_entries, check.common_entries,
+               uni > 0 ? (double)check.common_entries / (double)uni : 1.0,
+               check.points_identical, check.points,
+               check.points > 0 ? 100.0 * (double)check.points_identical / (double)check.points : 0.0,
+               check.points > 0 ? check.sum_dpsi / (double)check.points : 0.0, check.max_dpsi);
+    }
 
+    if(trace_close() != 0) fprintf(stderr, "Failed to write trace file\n");
     if(VERBOSITY) printf("✓ Done. Wrote %s\n", outpath);
     return 0;
 }
@@ -0,0 +1,131 @@
+/*
+ * memacct.c
+ *
+ * Counting wrappers around malloc & co. (see memacct.h). Sizes are the
+ * allocator's usable sizes, so a free needs no header in front of the block
+ * and mixing with plain free() cannot corrupt anything.
+ */
+
+#define _GNU_SOURCE   /* malloc_usable_size */
+
+#include "memacct.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define MEM_SIZE(p) ((int64_t)malloc_usable_size(p))
+#else
+#define MEM_SIZE(p) ((int64_t)0)   /* no size query: nothing is counted */
+#endif
+
+static int64_t g_live = 0, g_peak = 0;   /* atomics */
+
+static __thread int64_t tl_live = 0, tl_peak = 0, tl_nalloc = 0, tl_bytes = 0;
+
+static void mem_count(int64_t delta){
+    if(delta == 0) return;
+    tl_live += delta;
+    if(tl_live > tl_peak) tl_peak = tl_live;
+    if(delta > 0){
+        tl_nalloc++;
+        tl_bytes += delta;
+    }
+    int64_t live = __atomic_add_fetch(&g_live, delta, __ATOMIC_RELAXED);
+    int64_t peak = __atomic_load_n(&g_peak, __ATOMIC_RELAXED);
+    while(live > peak &&
+          !__atomic_compare_exchange_n(&g_peak, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void *mem_malloc(size_t n){
+    void *p = malloc(n);
+    if(p) mem_count(MEM_SIZE(p));
+    return p;
+}
+
+void *mem_calloc(size_t n, size_t size){
+    void *p = calloc(n, size);
+    if(p) mem_count(MEM_SIZE(p));
+    return p;
+}
+
+void *mem_realloc(void *p, size_t n){
+    int64_t old = p ? MEM_SIZE(p) : 0;
+    void *q = realloc(p, n);
+    if(!q) return NULL;           /* p is untouched */
+    mem_count(MEM_SIZE(q) - old);
+    return q;
+}
+
+void mem_free(void *p){
+    if(!p) return;
+    mem_count(-MEM_SIZE(p));
+    free(p);
+}
+
+void mem_thread_stats(MemThreadStats *s){
+    s->live = tl_live;
+    s->peak = tl_peak;
+    s->nalloc = tl_nalloc;
+    s->bytes = tl_bytes;
+}
+
+void mem_thread_mark(void){
+    tl_peak = tl_live;
+}
+
+void mem_thread_adopt(const void *p){
+    if(!p) return;
+    tl_live += MEM_SIZE((void*)p);
+    if(tl_live > tl_peak) tl_peak = tl_live;
+}
+
+int64_t mem_live(void){
+    return __atomic_load_n(&g_live, __ATOMIC_RELAXED);
+}
+
+int64_t mem_peak(void){
+    return __atomic_load_n(&g_peak, __ATOMIC_RELAXED);
+}
+
+long long mem_rss_bytes(void){
+    FILE *f = fopen("/proc/self/statm", "r");
+    if(!f) return -1;
+    long long size, resident;
+    int ok = fscanf(f, "%lld %lld", &size, &resident) == 2;
+    fclose(f);
+    return ok ? resident * (long long)sysconf(_SC_PAGESIZE) : -1;
+}
+
+long long mem_rss_peak_bytes(void){
+    FILE *f = fopen("/proc/self/status", "r");
+    if(!f) return -1;
+    char line[256];
+    long long kb = -1;
+    while(fgets(line, sizeof(line), f))
+        if(strncmp(line, "VmHWM:", 6) == 0){
+            kb = atoll(line + 6);
+            break;
+        }
+    fclose(f);
+    return kb >= 0 ? kb * 1024 : -1;
+}
+
+int mem_parse_size(const char *s, int64_t *out){
+    char *end;
+    double v = strtod(s, &end);
+    if(end == s || v < 0.0) return 1;
+    switch(*end){
+        case 'k': case 'K': v *= 1024.0; end++; break;
+        case 'm': case 'M': v *= 1024.0 * 1024.0; end++; break;
+        case 'g': case 'G': v *= 1024.0 * 1024.0 * 1024.0; end++; break;
+        case 't': case 'T': v *= 1024.0 * 1024.0 * 1024.0 * 1024.0; end++; break;
+        default: break;
+    }
+    if(*end == 'B' || *end == 'b') end++;
+    if(*end != '\0') return 1;
+    *out = (int64_t)v;
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef MEMACCT_H
+#define MEMACCT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * memacct
+ *
+ * Allocation accounting for the per-snapshot pipeline. The project's
+ * allocators (v2a_push / ia_push growth, cluster lists, the Triangle input,
+ * neighbor lists, psi6, cell lists, ...) go through mem_malloc & co., which
+ * count bytes with malloc_usable_size: process-wide live bytes and their
+ * high-water mark, and per thread the same plus allocation counts, so a stage
+ * can be measured on the thread that runs it (as with perfctr). Memory from
+ * a mem_* call must be released with mem_free / mem_realloc; plain free()
+ * works but leaves it counted as live. Allocations made inside Triangle are
+ * not seen here; mem_rss_bytes samples the process RSS for those.
+ */
+
+void *mem_malloc(size_t n);
+void *mem_calloc(size_t n, size_t size);
+void *mem_realloc(void *p, size_t n);
+void  mem_free(void *p);
+
+/* Counters of the calling thread. live is bytes allocated minus bytes freed by
+   this thread (negative when it frees memory another thread allocated). */
+typedef struct {
+    int64_t live;
+    int64_t peak;       /* high-water of live since the last mem_thread_mark */
+    int64_t nalloc;     /* allocations, including reallocs that grow */
+    int64_t bytes;      /* bytes obtained by them */
+} MemThreadStats;
+
+void mem_thread_stats(MemThreadStats *s);
+
+/* Restart the calling thread's high-water mark at its current live bytes */
+void mem_thread_mark(void);
+
+/* Move block p, allocated by another thread, onto the calling thread's live
+   bytes (and its high-water mark), so that freeing it here nets to zero */
+void mem_thread_adopt(const void *p);
+
+/* Process-wide tracked bytes: currently live and the high-water mark */
+int64_t mem_live(void);
+int64_t mem_peak(void);
+
+/* Resident set size of the process in bytes (/proc/self/statm), and its
+   high-water mark (VmHWM in /proc/self/status); -1 if unavailable */
+long long mem_rss_bytes(void);
+long long mem_rss_peak_bytes(void);
+
+/* Parse a byte count with an optional K, M, G or T suffix (powers of 1024).
+   Returns 0 on success. */
+int mem_parse_size(const char *s, int64_t *out);
+
+#endif /* MEMACCT_H */
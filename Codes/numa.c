@@ -0,0 +1,135 @@
+/*
+ * numa.c
+ *
+ * NUMA topology from sysfs and page placement via move_pages(2) (query mode:
+ * nodes == NULL, so nothing is moved). See numa.h.
+ */
+
+#define _GNU_SOURCE
+
+#include "numa.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Parse a sysfs cpulist ("0-3,8,10-11") into a malloc'd array */
+static int parse_cpulist(const char *s, int **out){
+    int n = 0, cap = 16;
+    int *v = (int*)malloc((size_t)cap * sizeof(int));
+    if(!v) return -1;
+    while(*s && *s != '\n'){
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if(end == s) break;
+        s = end;
+        if(*s == '-'){
+            b = strtol(s + 1, &end, 10);
+            s = end;
+        }
+        for(long c=a;c<=b;c++){
+            if(n == cap){
+                int *nv = (int*)realloc(v, (size_t)(cap *= 2) * sizeof(int));
+                if(!nv){ free(v); return -1; }
+                v = nv;
+            }
+            v[n++] = (int)c;
+        }
+        if(*s == ',') s++;
+    }
+    *out = v;
+    return n;
+}
+
+static int read_line(const char *path, char *buf, size_t len){
+    FILE *f = fopen(path, "r");
+    if(!f) return 1;
+    int ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    return ok ? 0 : 1;
+}
+
+int numa_topo_read(NumaTopo *T){
+    if(!T) return 1;
+    memset(T, 0, sizeof(*T));
+    char buf[4096], path[256];
+    int *nodes = NULL;
+    int nn = 0;
+    if(read_line("/sys/devices/system/node/has_cpu", buf, sizeof(buf)) == 0)
+        nn = parse_cpulist(buf, &nodes);
+    if(nn <= 0){
+        /* no NUMA information: one node with every online CPU */
+        free(nodes);
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        T->nnodes = 1;
+        T->node_id = (int*)calloc(1, sizeof(int));
+        T->ncpus = (int*)malloc(sizeof(int));
+        T->cpus = (int**)malloc(sizeof(int*));
+        if(!T->node_id || !T->ncpus || !T->cpus){ numa_topo_free(T); return 1; }
+        T->ncpus[0] = ncpu > 0 ? (int)ncpu : 1;
+        T->cpus[0] = (int*)malloc((size_t)T->ncpus[0] * sizeof(int));
+        if(!T->cpus[0]){ numa_topo_free(T); return 1; }
+        for(int c=0;c<T->ncpus[0];c++) T->cpus[0][c] = c;
+        return 0;
+    }
+    T->nnodes = nn;
+    T->node_id = nodes;
+    T->ncpus = (int*)calloc((size_t)nn, sizeof(int));
+    T->cpus = (int**)calloc((size_t)nn, sizeof(int*));
+    if(!T->ncpus || !T->cpus){ numa_topo_free(T); return 1; }
+    for(int k=0;k<nn;k++){
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[k]);
+        if(read_line(path, buf, sizeof(buf)) != 0 || (T->ncpus[k] = parse_cpulist(buf, &T->cpus[k])) <= 0){
+            fprintf(stderr, "numa_topo_read: cannot read %s\n", path);
+            numa_topo_free(T);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void numa_topo_free(NumaTopo *T){
+    if(!T) return;
+    for(int k=0;k<T->nnodes;k++) if(T->cpus) free(T->cpus[k]);
+    free(T->cpus);
+    free(T->ncpus);
+    free(T->node_id);
+    memset(T, 0, sizeof(*T));
+}
+
+void numa_assign_cpus(const NumaTopo *T, int n, int *cpus, int *nodes){
+    for(int t=0;t<n;t++){
+        int k = t % T->nnodes;
+        int slot = (t / T->nnodes) % T->ncpus[k];
+        nodes[t] = T->node_id[k];
+        cpus[t] = T->cpus[k][slot];
+    }
+}
+
+int numa_count_pages(const void *addr, size_t bytes, int node, long *local, long *total){
+#ifdef SYS_move_pages
+    if(!addr || bytes == 0) return 0;
+    const uintptr_t psz = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t p0 = (uintptr_t)addr & ~(psz - 1);
+    uintptr_t p1 = ((uintptr_t)addr + bytes + psz - 1) & ~(psz - 1);
+    enum { BATCH = 256 };
+    void *pages[BATCH];
+    int status[BATCH];
+    for(uintptr_t p=p0;p<p1;){
+        int n = 0;
+        for(;n<BATCH && p<p1;n++, p+=psz) pages[n] = (void*)p;
+        if(syscall(SYS_move_pages, 0, (unsigned long)n, pages, NULL, status, 0) != 0) return 1;
+        for(int k=0;k<n;k++){
+            if(status[k] < 0) continue;       /* not present (never touched) */
+            (*total)++;
+            if(status[k] == node) (*local)++;
+        }
+    }
+    return 0;
+#else
+    (void)addr; (void)bytes; (void)node; (void)local; (void)total;
+    return 1;
+#endif
+}
@@ -0,0 +1,47 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stddef.h>
+
+/*
+ * numa
+ *
+ * Minimal NUMA helpers for --numa (no libnuma needed): the CPU -> node map is
+ * read from /sys/devices/system/node, page placement is queried with the
+ * move_pages(2) system call. On machines without NUMA information everything
+ * degrades to a single node 0.
+ */
+
+/* Topology: nodes with CPUs, and the CPUs (ascending) of each */
+typedef struct {
+    int  nnodes;
+    int *node_id;     /* nnodes: kernel node numbers */
+    int *ncpus;       /* nnodes: CPUs per node */
+    int **cpus;       /* nnodes arrays of CPU ids */
+} NumaTopo;
+
+/* Read the topology. Returns 0 on success (a single node 0 holding every
+   online CPU if the sysfs node directory is missing); on error T is left empty.
+   Free with numa_topo_free. */
+int numa_topo_read(NumaTopo *T);
+void numa_topo_free(NumaTopo *T);
+
+/*
+ * numa_assign_cpus
+ *
+ * CPU for each of n threads, spread round-robin over the nodes (thread t on
+ * node t % nnodes, then the next free CPU of that node; CPUs are reused once a
+ * node runs out). Fills cpus[n] and nodes[n] (kernel node numbers).
+ */
+void numa_assign_cpus(const NumaTopo *T, int n, int *cpus, int *nodes);
+
+/*
+ * numa_count_pages
+ *
+ * Node placement of the pages of [addr, addr + bytes): adds the number of
+ * pages found to *total and those on `node` to *local. Pages never touched are
+ * not counted. Returns 0 on success, non-zero if placement cannot be queried.
+ */
+int numa_count_pages(const void *addr, size_t bytes, int node, long *local, long *total);
+
+#endif /* NUMA_H */
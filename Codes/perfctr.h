@@ -0,0 +1,50 @@
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdint.h>
+
+/*
+ * perfctr
+ *
+ * Per-thread hardware counters through Linux perf_event_open (--perf-counters).
+ * Each thread opens its own counters on first use (user space only, this
+ * thread only), so a stage can be measured by reading before and after it on
+ * the thread that runs it. Events the kernel or the virtual machine does not
+ * provide are reported as unavailable; the others keep working. Counts are
+ * scaled when the kernel multiplexes counters.
+ */
+
+enum {
+    PERFCTR_CYCLES,
+    PERFCTR_INSTRUCTIONS,
+    PERFCTR_CACHE_MISSES,
+    PERFCTR_BRANCH_MISSES,
+    PERFCTR_PAGE_FAULTS,
+    PERFCTR_N
+};
+
+/* Short event names, indexed as above */
+extern const char *const PERFCTR_NAMES[PERFCTR_N];
+
+/*
+ * perfctr_enable
+ *
+ * Turn counting on for the process and probe the events on the calling
+ * thread. Returns a bit mask of the events that can be counted (bit k for
+ * event k); 0 means no counters at all, and perfctr_read then fails.
+ */
+unsigned perfctr_enable(void);
+
+/*
+ * perfctr_read
+ *
+ * Current counts of the calling thread (opened on the first call). Events
+ * that are unavailable read as 0. Returns 0 on success, non-zero if counting
+ * is off or no counter could be opened for this thread.
+ */
+int perfctr_read(uint64_t v[PERFCTR_N]);
+
+/* Close the calling thread's counters (optional; they close at exit) */
+void perfctr_thread_close(void);
+
+#endif /* PERFCTR_H */
@@ -6,27 +6,29 @@
  */
 
 #include "psi6.h"
+#include "memacct.h"
+#include "tpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 
-Complex *compute_psi6_from_neighbors(const Vec2Array *coms,
-                                     const IntArray *neighbors,
-                                     bool use_pbc,
-                                     double box_x, double box_y)
-{
-    if(!coms || !neighbors){ 
+typedef struct {
+    const Vec2Array *coms;
+    const IntArray  *neighbors;
+    bool   use_pbc;
+    double box_x, box_y;
+    Complex *psi;
+} Psi6Job;
 
-        fprintf(stderr,"compute_psi6: invalid args\n");
-        return NULL; 
-    }
-    int M = (int)coms->n;
-    if(M <= 0) return NULL;
+/* psi6 of points lo..hi-1 (one parallel-for chunk) */
+static void psi6_range(void *arg, long lo, long hi){
+    const Psi6Job *J = (const Psi6Job*)arg;
+    const Vec2Array *coms = J->coms;
+    const IntArray *neighbors = J->neighbors;
+    Complex *psi = J->psi;
+    const int M = (int)coms->n;
 
-    Complex *psi = (Complex*)calloc((size_t)M, sizeof(Complex));
-    if(!psi){ fprintf(stderr,"compute_psi6: OOM\n"); return NULL; }
-
-    for(int i=0;i<M;i++){
+    for(int i=(int)lo;i<(int)hi;i++){
         int nc = (int)neighbors[i].n;
         if(nc <= 0){ 
             psi[i].re = 0.0; 
@@ -43,9 +45,9 @@ Complex *compute_psi6_from_neighbors(const Vec2Array *coms,
 
             double dx = coms->data[j].x - coms->data[i].x;
             double dy = coms->data[j].y - coms->data[i].y;
-            if(use_pbc){
-                dx = mic_delta(dx, box_x);
-                dy = mic_delta(dy, box_y);
+            if(J->use_pbc){
+                dx = mic_delta(dx, J->box_x);
+                dy = mic_delta(dy, J->box_y);
             }
 
             double theta = atan2(dy, dx);
@@ -57,6 +59,27 @@ Complex *compute_psi6_from_neighbors(const Vec2Array *coms,
         psi[i].re = sx / (double)nc;
         psi[i].im = sy / (double)nc;
     }
+}
+
+/* Points are independent: chunks of 4096 run on the default thread pool */
+Complex *compute_psi6_from_neighbors(const Vec2Array *coms,
+                                     const IntArray *neighbors,
+                                     bool use_pbc,
+                                     double box_x, double box_y)
+{
+    if(!coms || !neighbors){ 
+
+        fprintf(stderr,"compute_psi6: invalid args\n");
+        return NULL; 
+    }
+    int M = (int)coms->n;
+    if(M <= 0) return NULL;
+
+    Complex *psi = (Complex*)mem_calloc((size_t)M, sizeof(Complex));
+    if(!psi){ fprintf(stderr,"compute_psi6: OOM\n"); return NULL; }
+
+    Psi6Job J = { coms, neighbors, use_pbc, box_x, box_y, psi };
+    tpool_parallel_for(NULL, M, 4096, psi6_range, &J);
 
     return psi;
 }
@@ -17,8 +17,8 @@ typedef struct { double re, im; } Complex;
  *   - use_pbc, box_x, box_y: for angle calculation (apply minimum image if use_pbc true)
  *
  * Returns:
- *   - malloc'd Complex array of length M where psi6[i] holds the normalized local psi6.
- *     Caller must free() the result.
+ *   - mem_malloc'd Complex array of length M where psi6[i] holds the normalized local psi6.
+ *     Caller must mem_free() the result.
  *   - On failure: returns NULL.
  *
  * Behavior:
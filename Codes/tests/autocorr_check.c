@@ -0,0 +1,95 @@
+/*
+ * autocorr_check.c
+ *
+ * --subsample=auto rests on these estimates. For an AR(1) series
+ * x_t = phi x_{t-1} + e_t the autocorrelation is rho(t) = phi^t, so
+ * tau_int = (1 + phi) / (2 (1 - phi)). Checked: tau_int from the exact rho
+ * is the truncated sum at the smallest window meeting Sokal's rule; from
+ * simulated series it is within four standard errors of the analytic value
+ * (Sokal's estimate tau sqrt(2 (2W + 1) / n)); and
+ * autocorr_tau_strided on the exact rho matches the AR(1) with phi^stride,
+ * agrees with tau_int at stride 1 and never drops below 1/2. A constant
+ * series is reported as uncorrelated.
+ *
+ * Exit status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "autocorr.h"
+#include "testutil.h"
+
+#define NSAMP  200000
+#define MAXLAG 400
+
+static int bad = 0;
+
+static void expect(int ok, const char *what, double phi, double got, double want){
+    if(ok) return;
+    fprintf(stderr,"autocorr_check: phi %g: %s: got %.12g, expected %.12g\n", phi, what, got, want);
+    bad++;
+}
+
+int main(void){
+    double *x = (double*)malloc(NSAMP * sizeof(double));
+    double *rho = (double*)malloc((MAXLAG + 1) * sizeof(double));
+    if(!x || !rho){ fprintf(stderr,"autocorr_check: OOM\n"); return 1; }
+
+    const double phis[4] = { 0.0, 0.5, 0.8, 0.9 };
+    uint64_t seed = 11;
+    int nchecks = 0;
+    for(int p=0;p<4;p++){
+        const double phi = phis[p], tau = (1.0 + phi) / (2.0 * (1.0 - phi));
+
+        /* exact rho: the truncated sum at Sokal's window, which is the first that fits */
+        for(int t=0;t<=MAXLAG;t++) rho[t] = pow(phi, t);
+        int W = 0;
+        const double te = autocorr_tau_int(rho, MAXLAG, &W);
+        double sum = 0.5, prev = 0.5;
+        for(int t=1;t<=W;t++){ prev = sum; sum += rho[t]; }
+        expect(W > 0 && te == sum, "exact tau_int", phi, te, sum);
+        expect(W >= AUTOCORR_SOKAL_C * te && (W == 1 || W - 1 < AUTOCORR_SOKAL_C * prev),
+               "Sokal window", phi, W, AUTOCORR_SOKAL_C * te);
+        expect(fabs(te - tau) < 0.02 * tau, "exact tau_int vs analytic", phi, te, tau);
+
+        /* stride s: the series of every s-th sample is AR(1) with phi^s */
+        for(int s=1;s<=5;s+=2){
+            const double ps = pow(phi, s), want = (1.0 + ps) / (2.0 * (1.0 - ps));
+            const double ts = autocorr_tau_strided(rho, MAXLAG, s);
+            expect(fabs(ts - want) < 1e-9 * want, "tau_strided", phi, ts, want);
+        }
+        expect(autocorr_tau_strided(rho, W, 1) == te, "tau_strided at stride 1", phi,
+               autocorr_tau_strided(rho, W, 1), te);
+
+        /* simulated series: uniform innovations, scaled to keep the variance stationary */
+        x[0] = rng_uniform(&seed) - 0.5;
+        for(int i=1;i<NSAMP;i++) x[i] = phi * x[i-1] + sqrt(1.0 - phi * phi) * (rng_uniform(&seed) - 0.5);
+        int ws = 0;
+        const int rc = autocorr_rho(x, NSAMP, MAXLAG, rho);
+        const double tm = autocorr_tau_int(rho, MAXLAG, &ws);
+        expect(rc == 0 && ws > 0, "window found", phi, ws, 0);
+        const double se = tau * sqrt(2.0 * (2.0 * ws + 1.0) / NSAMP);
+        expect(fabs(tm - tau) < 4.0 * se, "tau_int of the series", phi, tm, tau);
+        nchecks += 9;
+    }
+
+    /* anticorrelated: the strided sum goes below 1/2 and is held there */
+    for(int t=0;t<=MAXLAG;t++) rho[t] = pow(-0.9, t);
+    expect(autocorr_tau_strided(rho, MAXLAG, 1) == 0.5, "tau_strided floor", -0.9,
+           autocorr_tau_strided(rho, MAXLAG, 1), 0.5);
+
+    /* constant series: rho left as uncorrelated, tau_int 1/2 */
+    for(int i=0;i<NSAMP;i++) x[i] = 3.0;
+    int wc = 0;
+    const int rc = autocorr_rho(x, NSAMP, MAXLAG, rho);
+    const double tc = autocorr_tau_int(rho, MAXLAG, &wc);
+    expect(rc == 1 && tc == 0.5, "constant series", 1.0, tc, 0.5);
+    nchecks += 2;
+
+    free(x);
+    free(rho);
+    printf("autocorr_check: %d checks on AR(1) series and exact rho, %d failure(s)\n", nchecks, bad);
+    return bad != 0;
+}
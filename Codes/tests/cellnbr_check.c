@@ -0,0 +1,163 @@
+/*
+ * cellnbr_check.c
+ *
+ * The cell-list engines must select exactly what SANN and kNN select from
+ * the full sorted list of minimum-image distances to all other points, in the
+ * same order. Checked with and without PBC, on boxes that hold only a few
+ * cells (so gather rings wrap or cover the grid), elongated boxes, lattices
+ * (distance ties), coincident points and points outside the box. The radius
+ * celllist_gather reports is checked on its own: every point closer than it
+ * must have been gathered, and no point twice.
+ *
+ * Exit status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "cellnbr.h"
+#include "celllist.h"
+#include "memacct.h"
+#include "testutil.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NSETS 48
+
+typedef struct { double r; int j; } DistIdx;
+
+static int cmp_dist(const void *a, const void *b){
+    const DistIdx *da = (const DistIdx*)a, *db = (const DistIdx*)b;
+    if(da->r < db->r) return -1;
+    if(da->r > db->r) return 1;
+    return (da->j > db->j) - (da->j < db->j);
+}
+
+/* All other points of i sorted by (distance, index); returns their number */
+static int all_dists(const Vec2Array *p, int i, int pbc, double bx, double by, DistIdx *d){
+    int n = 0;
+    for(int j=0;j<(int)p->n;j++){
+        if(j == i) continue;
+        double dx = p->data[j].x - p->data[i].x, dy = p->data[j].y - p->data[i].y;
+        if(pbc){ dx = mic_delta(dx, bx); dy = mic_delta(dy, by); }
+        d[n].r = sqrt(dx*dx + dy*dy);
+        d[n].j = j;
+        n++;
+    }
+    qsort(d, (size_t)n, sizeof(DistIdx), cmp_dist);
+    return n;
+}
+
+/* SANN over the complete list */
+static int sann_count(const DistIdx *d, int n){
+    for(int m=3;m<n;m++){
+        if(d[m].r <= 0.0) continue;
+        double sum = 0.0;
+        for(int j=0;j<m;j++) sum += acos(d[j].r / d[m].r);
+        if(sum > M_PI) return m;
+    }
+    return n;
+}
+
+static void free_lists(IntArray *nb, int M){
+    if(!nb) return;
+    for(int i=0;i<M;i++) ia_free(&nb[i]);
+    mem_free(nb);
+}
+
+/* 0 if engine (0 SANN, else kNN with k = engine) matches the brute force */
+static int check_engine(const Vec2Array *p, int engine, int pbc, double bx, double by, DistIdx *d, int set){
+    int M = 0;
+    IntArray *nb = engine == 0 ? sann_neighbors(p, pbc, bx, by, &M)
+                               : knn_neighbors(p, engine, pbc, bx, by, &M);
+    if(!nb || M != (int)p->n){
+        fprintf(stderr,"cellnbr_check: set %d: engine %d failed\n", set, engine);
+        free_lists(nb, M);
+        return 1;
+    }
+    int bad = 0;
+    for(int i=0;i<M && !bad;i++){
+        const int n = all_dists(p, i, pbc, bx, by, d);
+        const int m = engine == 0 ? sann_count(d, n) : (n < engine ? n : engine);
+        bad = nb[i].n != (size_t)m;
+        for(int q=0;q<m && !bad;q++) bad = nb[i].data[q] != d[q].j;
+        if(bad)
+            fprintf(stderr,"cellnbr_check: set %d (%zu points, pbc %d, box %g x %g): engine %d, point %d: %zu neighbor(s), brute force %d\n",
+                    set, p->n, pbc, bx, by, engine, i, nb[i].n, m);
+    }
+    free_lists(nb, M);
+    return bad;
+}
+
+/* 0 if every point closer than the reported radius was gathered, once */
+static int check_gather(const Vec2Array *p, int pbc, double bx, double by, uint64_t *seed, int set){
+    CellList cl;
+    if(celllist_build(&cl, p, 0.0, pbc, bx, by) != 0) return 1;
+    int *seen = (int*)calloc(p->n, sizeof(int));
+    IntArray out;
+    ia_init(&out);
+    int bad = !seen;
+    for(int q=0;q<8 && !bad;q++){
+        const double x = rng_uniform(seed) * bx, y = rng_uniform(seed) * by;
+        for(int ring=1;ring<=4 && !bad;ring++){
+            out.n = 0;
+            const double rc = celllist_gather(&cl, x, y, ring, &out);
+            memset(seen, 0, p->n * sizeof(int));
+            for(size_t k=0;k<out.n;k++)
+                if(seen[out.data[k]]++ && pbc) bad = 1;
+            for(int j=0;j<(int)p->n && !bad;j++){
+                double dx = p->data[j].x - x, dy = p->data[j].y - y;
+                if(pbc){ dx = mic_delta(dx, bx); dy = mic_delta(dy, by); }
+                if(sqrt(dx*dx + dy*dy) < rc && !seen[j]) bad = 1;
+            }
+            if(bad)
+                fprintf(stderr,"cellnbr_check: set %d: gather ring %d (%d x %d cells) radius %g incomplete or repeated\n",
+                        set, ring, cl.ncx, cl.ncy, rc);
+        }
+    }
+    ia_free(&out);
+    free(seen);
+    celllist_free(&cl);
+    return bad;
+}
+
+int main(void){
+    static const int sizes[] = { 1, 2, 3, 4, 5, 7, 12, 30, 200, 1500 };
+    const int nsizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    uint64_t seed = 23;
+    int bad = 0, nchecks = 0;
+    for(int k=0;k<NSETS;k++){
+        const int n = sizes[k % nsizes];
+        const int pbc = (k / nsizes) % 2 == 0;
+        const int shape = k % 3;                     /* 0 square, 1 elongated, 2 lattice */
+        const double bx = shape == 1 ? 40.0 : 10.0 + 0.25 * n;
+        const double by = shape == 1 ? 3.0 : bx;
+        Vec2Array p;
+        v2a_init(&p);
+        const int side = (int)ceil(sqrt((double)n));
+        for(int i=0;i<n;i++){
+            Vec2 v;
+            if(shape == 2) v = (Vec2){ (i % side) * bx / side, (i / side) * by / side };
+            else v = (Vec2){ rng_uniform(&seed) * bx, rng_uniform(&seed) * by };
+            /* some coincident points and some outside the box */
+            if(i > 0 && rng_next(&seed) % 10 == 0) v = p.data[rng_next(&seed) % (uint64_t)i];
+            else if(rng_next(&seed) % 25 == 0) v.x += (rng_next(&seed) % 2 ? bx : -bx) * 0.5;
+            if(v2a_push(&p, v) != 0){ fprintf(stderr,"cellnbr_check: OOM\n"); return 1; }
+        }
+        DistIdx *d = (DistIdx*)malloc(((size_t)n + 1) * sizeof(DistIdx));
+        if(!d){ fprintf(stderr,"cellnbr_check: OOM\n"); return 1; }
+        const int engines[4] = { 0, 1, 6, 12 };
+        for(int e=0;e<4;e++) bad += check_engine(&p, engines[e], pbc, bx, by, d, k);
+        bad += check_gather(&p, pbc, bx, by, &seed, k);
+        nchecks += 5;
+        free(d);
+        v2a_free(&p);
+    }
+    printf("cellnbr_check: SANN, kNN and gather radius on %d point sets (%d checks), %d mismatch(es)\n", NSETS, nchecks, bad);
+    return bad != 0;
+}
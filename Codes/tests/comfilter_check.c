@@ -0,0 +1,83 @@
+/*
+ * comfilter_check.c
+ *
+ * filter_coms_by_size must keep exactly the COMs of clusters with
+ * min_size <= size <= max_size (max_size <= 0: no upper limit), in their
+ * original order, and return how many it kept; inconsistent arguments give
+ * -1 and leave the COMs alone. Each COM here carries its cluster's index in
+ * x, so the kept list can be compared with the expected one.
+ *
+ * The all-singleton path of the pipeline, which bypasses this function, is
+ * checked end to end in pipeline_check.
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* dup, dup2 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "com.h"
+
+#define NCL 8
+
+static const int SIZES[NCL] = { 1, 2, 3, 5, 1, 4, 2, 7 };
+
+/* Fresh COMs and clusters of SIZES (members are not looked at) */
+static void setup(Vec2Array *coms, IntArray *cl){
+    for(int c=0;c<NCL;c++){
+        coms->data[c].x = c;
+        coms->data[c].y = -c;
+        cl[c].data = NULL;
+        cl[c].n = (size_t)SIZES[c];
+        cl[c].cap = 0;
+    }
+    coms->n = NCL;
+}
+
+int main(void){
+    Vec2 buf[NCL];
+    Vec2Array coms = { buf, NCL, NCL };
+    IntArray cl[NCL];
+    static const int lim[][2] = { { 1, 0 }, { 0, 0 }, { 2, 0 }, { 2, 4 }, { 1, 1 }, { 8, 0 }, { 3, 3 }, { 5, 100 } };
+    const int nlim = (int)(sizeof(lim) / sizeof(lim[0]));
+    int bad = 0;
+
+    for(int k=0;k<nlim;k++){
+        const int lo = lim[k][0], hi = lim[k][1];
+        setup(&coms, cl);
+        const int kept = filter_coms_by_size(&coms, cl, NCL, lo, hi);
+        int want = 0, order_ok = 1;
+        for(int c=0;c<NCL;c++){
+            if(SIZES[c] < lo || (hi > 0 && SIZES[c] > hi)) continue;
+            if(want >= (int)coms.n || coms.data[want].x != c || coms.data[want].y != -c) order_ok = 0;
+            want++;
+        }
+        if(kept != want || coms.n != (size_t)want || !order_ok){
+            fprintf(stderr,"comfilter_check: sizes [%d, %d]: kept %d (n %zu), expected %d%s\n",
+                    lo, hi, kept, coms.n, want, order_ok ? "" : ", wrong COMs");
+            bad++;
+        }
+    }
+
+    /* a count that does not match the COMs is rejected untouched (the
+       expected error messages go to /dev/null) */
+    setup(&coms, cl);
+    fflush(stderr);
+    const int errfd = dup(STDERR_FILENO), nullfd = open("/dev/null", O_WRONLY);
+    if(nullfd >= 0){ dup2(nullfd, STDERR_FILENO); close(nullfd); }
+    const int rejected = filter_coms_by_size(&coms, cl, NCL - 1, 2, 0) == -1 && coms.n == NCL &&
+                         filter_coms_by_size(NULL, cl, NCL, 2, 0) == -1 &&
+                         filter_coms_by_size(&coms, NULL, NCL, 2, 0) == -1;
+    fflush(stderr);
+    if(errfd >= 0){ dup2(errfd, STDERR_FILENO); close(errfd); }
+    if(!rejected){
+        fprintf(stderr,"comfilter_check: invalid arguments not rejected\n");
+        bad++;
+    }
+    printf("comfilter_check: %d size ranges over %d clusters and invalid arguments, %d failure(s)\n",
+           nlim, NCL, bad);
+    return bad != 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * dt2d_vs_triangle.c
+ *
+ * dt2d_edges must give the exact Delaunay edge set, the same one Triangle
+ * finds. Checked on random point sets in general position, with some points
+ * duplicated, and on tiny inputs. Of a group of duplicates only one copy gets
+ * edges and the engines may keep different copies, so edge ends are mapped to
+ * the lowest index at the same position before comparing. Grids
+ * are left out: cocircular quadruples have several valid triangulations and
+ * the two engines may break the ties differently.
+ *
+ * Exit status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define REAL double
+#include "triangle.h"
+#include "dt2d.h"
+#include "memacct.h"
+#include "testutil.h"
+
+#define NSETS 40
+
+static int cmp_key(const void *a, const void *b){
+    const int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static const double *sort_xy;
+
+static int cmp_pos(const void *a, const void *b){
+    const int i = *(const int*)a, j = *(const int*)b;
+    const double *p = &sort_xy[2*i], *q = &sort_xy[2*j];
+    if(p[0] != q[0]) return p[0] < q[0] ? -1 : 1;
+    if(p[1] != q[1]) return p[1] < q[1] ? -1 : 1;
+    return (i > j) - (i < j);
+}
+
+/* rep[i]: lowest index at the same position as point i (malloc'd) */
+static int *dup_rep(const double *xy, int n){
+    int *ord = (int*)malloc(((size_t)n + 1) * sizeof(int));
+    int *rep = (int*)malloc(((size_t)n + 1) * sizeof(int));
+    if(!ord || !rep){ free(ord); free(rep); return NULL; }
+    for(int i=0;i<n;i++) ord[i] = i;
+    sort_xy = xy;
+    qsort(ord, (size_t)n, sizeof(int), cmp_pos);
+    for(int a=0;a<n;a++){
+        const int i = ord[a], f = a > 0 ? ord[a-1] : -1;
+        rep[i] = (f >= 0 && xy[2*f] == xy[2*i] && xy[2*f+1] == xy[2*i+1]) ? rep[f] : i;
+    }
+    free(ord);
+    return rep;
+}
+
+/* Edges as sorted keys min * n + max over representatives (malloc'd) */
+static int64_t *edge_keys(const int *e, int ne, int n, const int *rep){
+    int64_t *k = (int64_t*)malloc(((size_t)ne + 1) * sizeof(int64_t));
+    if(!k) return NULL;
+    for(int i=0;i<ne;i++){
+        const int a = rep[e[2*i]], b = rep[e[2*i+1]];
+        const int u = a < b ? a : b, v = a < b ? b : a;
+        k[i] = (int64_t)u * n + v;
+    }
+    qsort(k, (size_t)ne, sizeof(int64_t), cmp_key);
+    return k;
+}
+
+/* 0 if both engines give the same edge set for xy[0..2n-1] */
+static int compare(const double *xy, int n, const char *what){
+    struct triangulateio in, out;
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+    in.numberofpoints = n;
+    in.pointlist = (double*)xy;
+    char sw[] = "zeQ";
+    int ntri = 0, *tri = NULL;
+    if(n >= 3){
+        triangulate(sw, &in, &out, NULL);
+        tri = out.edgelist;
+        ntri = out.numberofedges;
+        trifree(out.pointlist);
+        trifree(out.trianglelist);
+    }
+    int *dt = NULL, ndt = 0;
+    if(dt2d_edges(xy, n, &dt, &ndt) != 0){
+        fprintf(stderr,"dt2d_vs_triangle: dt2d_edges failed on %s\n", what);
+        trifree(tri);
+        return 1;
+    }
+    int *rep = dup_rep(xy, n);
+    int64_t *a = rep ? edge_keys(tri, ntri, n, rep) : NULL, *b = rep ? edge_keys(dt, ndt, n, rep) : NULL;
+    int bad = !a || !b || ntri != ndt || (ntri > 0 && memcmp(a, b, (size_t)ntri * sizeof(int64_t)) != 0);
+    /* Triangle needs 3 points; two distinct ones make a single edge */
+    if(n < 3) bad = !b || ndt != (n == 2 && (xy[0] != xy[2] || xy[1] != xy[3]));
+    if(bad) fprintf(stderr,"dt2d_vs_triangle: %s: triangle %d edges, dt2d %d\n", what, ntri, ndt);
+    free(rep);
+    free(a);
+    free(b);
+    trifree(tri);
+    mem_free(dt);
+    return bad;
+}
+
+int main(void){
+    uint64_t seed = 3;
+    int bad = 0;
+    for(int k=0;k<NSETS;k++){
+        const int n = 3 + (int)(rng_next(&seed) % (k < NSETS / 2 ? 50 : 5000));
+        double *xy = (double*)malloc(2 * (size_t)n * sizeof(double));
+        if(!xy){ fprintf(stderr,"dt2d_vs_triangle: OOM\n"); return 1; }
+        for(int i=0;i<2*n;i++) xy[i] = rng_uniform(&seed) * 100.0;
+        /* every 4th set: copy some points onto others */
+        if(k % 4 == 3)
+            for(int i=0;i<n/10;i++){
+                const int s = (int)(rng_next(&seed) % (uint64_t)n), d = (int)(rng_next(&seed) % (uint64_t)n);
+                xy[2*d] = xy[2*s];
+                xy[2*d+1] = xy[2*s+1];
+            }
+        char what[64];
+        snprintf(what, sizeof(what), "set %d (%d points%s)", k, n, k % 4 == 3 ? ", duplicates" : "");
+        bad += compare(xy, n, what);
+        free(xy);
+    }
+    const double two[4] = { 0.0, 0.0, 1.0, 2.0 };
+    bad += compare(two, 0, "no points");
+    bad += compare(two, 1, "one point");
+    bad += compare(two, 2, "two points");
+    printf("dt2d_vs_triangle: %d random sets and 3 tiny inputs, %d mismatch(es)\n", NSETS, bad);
+    return bad != 0;
+}
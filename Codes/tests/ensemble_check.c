@@ -0,0 +1,107 @@
+/*
+ * ensemble_check.c
+ *
+ * g6accum_write_ensemble on two replicas with known contents. Every snapshot
+ * is one pair with psi6 = (1, z), adding Re = Re z, Im = -Im z at its
+ * distance. Replica 0 holds one pair in coarse bin 1 and one in bin 3,
+ * replica 1 two pairs in bin 1. The file must list exactly bins 1 and 3:
+ * the pooled (pair-weighted) average and count, and as errors the standard
+ * deviation of the replica averages over sqrt(nrep) -- |x0 - x1| / 2 in
+ * bin 1, 0 with nrep 1 in bin 3.
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* mkdtemp */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "g6accum.h"
+#include "testutil.h"
+
+#define DR 0.5
+
+/* Add one snapshot: a pair at distance r with psi6 (1, z) */
+static void add_pair(G6Accum *A, double r, Complex z){
+    Vec2 pts[2] = { { 0.0, 0.0 }, { r, 0.0 } };
+    Vec2Array coms = { pts, 2, 2 };
+    Complex psi[2] = { { 1.0, 0.0 }, z };
+    g6accum_accumulate(A, &coms, psi, false, 0.0, 0.0);
+}
+
+static int close_to(double a, double b){
+    return fabs(a - b) <= 1e-9 * (fabs(b) > 1.0 ? fabs(b) : 1.0);
+}
+
+int main(void){
+    char dir[] = "/tmp/ensemble_checkXXXXXX";
+    if(!mkdtemp(dir)){ perror("ensemble_check: mkdtemp"); return 1; }
+    char path[256];
+    snprintf(path, sizeof(path), "%s/g6_ensemble.dat", dir);
+
+    G6Accum *R[2] = { g6accum_create(DR), g6accum_create(DR) };
+    G6Accum *P = g6accum_create(DR);
+    if(!R[0] || !R[1] || !P){ fprintf(stderr,"ensemble_check: OOM\n"); return 1; }
+    const Complex z0 = { 0.2, 0.4 }, z0far = { -0.5, 0.1 }, z1a = { 0.6, 0.0 }, z1b = { 0.8, 0.2 };
+    add_pair(R[0], 0.75, z0);
+    add_pair(R[0], 1.75, z0far);
+    add_pair(R[1], 0.75, z1a);
+    add_pair(R[1], 0.75, z1b);
+    g6accum_merge(P, R[0]);
+    g6accum_merge(P, R[1]);
+
+    int bad = 0;
+    if(g6accum_write_ensemble(P, R, 2, path, 0, 9, 0.6, false, 0.0, 0.0) != 0){
+        fprintf(stderr,"ensemble_check: write failed\n");
+        bad++;
+    }
+
+    /* expected rows: bin 1 (r 0.75) from both replicas, bin 3 (r 1.75) from replica 0 */
+    const double re0 = z0.re, im0 = -z0.im;
+    const double re1 = (z1a.re + z1b.re) / 2, im1 = -(z1a.im + z1b.im) / 2;
+    const double pre = (z0.re + z1a.re + z1b.re) / 3, pim = -(z0.im + z1a.im + z1b.im) / 3;
+    const double want[2][9] = {
+        { 0.75, pre, pim, hypot(pre, pim), 3,
+          fabs(re0 - re1) / 2, fabs(im0 - im1) / 2, fabs(hypot(re0, im0) - hypot(re1, im1)) / 2, 2 },
+        { 1.75, z0far.re, -z0far.im, hypot(z0far.re, z0far.im), 1, 0.0, 0.0, 0.0, 1 },
+    };
+
+    FILE *f = bad ? NULL : fopen(path, "r");
+    char line[1024];
+    int nrow = 0, header_ok = 0;
+    while(f && fgets(line, sizeof(line), f)){
+        if(line[0] == '#'){
+            if(strstr(line, "time_0 .. time_9 of 2 replicas")) header_ok = 1;
+            continue;
+        }
+        double v[9];
+        if(sscanf(line, "%lf %lf %lf %lf %lf %lf %lf %lf %lf",
+                  &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) != 9 || nrow >= 2){
+            fprintf(stderr,"ensemble_check: unexpected line: %s", line);
+            bad++;
+            continue;
+        }
+        for(int q=0;q<9;q++){
+            if(!close_to(v[q], want[nrow][q])){
+                fprintf(stderr,"ensemble_check: row %d column %d: got %.12g, expected %.12g\n",
+                        nrow, q + 1, v[q], want[nrow][q]);
+                bad++;
+            }
+        }
+        nrow++;
+    }
+    if(f) fclose(f);
+    if(!bad && (nrow != 2 || !header_ok)){
+        fprintf(stderr,"ensemble_check: %d data row(s), header %s\n", nrow, header_ok ? "ok" : "missing");
+        bad++;
+    }
+
+    g6accum_free(R[0]);
+    g6accum_free(R[1]);
+    g6accum_free(P);
+    remove_dir(dir);
+    printf("ensemble_check: spread file of 2 replicas (%d rows), %d failure(s)\n", nrow, bad);
+    return bad != 0;
+}
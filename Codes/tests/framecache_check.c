@@ -0,0 +1,153 @@
+/*
+ * framecache_check.c
+ *
+ * framecache_load must hand back exactly what framecache_store wrote (COMs,
+ * CSR neighbor lists, psi6, cluster count), and must reject, count and remove
+ * an entry whose file has been damaged: every single-byte flip and a
+ * truncation have to be caught by the header, size or checksum checks.
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* mkdtemp */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "framecache.h"
+#include "memacct.h"
+#include "testutil.h"
+
+#define M 40
+
+static void free_neighbors(IntArray *nb, int n){
+    if(!nb) return;
+    for(int i=0;i<n;i++) ia_free(&nb[i]);
+    mem_free(nb);
+}
+
+static long file_size(const char *path){
+    FILE *f = fopen(path, "rb");
+    if(!f) return -1;
+    fseek(f, 0, SEEK_END);
+    const long n = ftell(f);
+    fclose(f);
+    return n;
+}
+
+static int flip_byte(const char *path, long at){
+    FILE *f = fopen(path, "r+b");
+    if(!f) return 1;
+    int c = -1;
+    if(fseek(f, at, SEEK_SET) == 0) c = fgetc(f);
+    int rc = c < 0 || fseek(f, at, SEEK_SET) != 0 || fputc(c ^ 0x40, f) == EOF;
+    return fclose(f) != 0 || rc;
+}
+
+/* 0 if the loaded entry equals what was stored */
+static int same(const Vec2Array *c0, const IntArray *nb0, const Complex *p0,
+                const Vec2Array *c1, const IntArray *nb1, const Complex *p1){
+    if(c1->n != c0->n) return 1;
+    if(memcmp(c0->data, c1->data, c0->n * sizeof(Vec2)) != 0) return 1;
+    if(memcmp(p0, p1, c0->n * sizeof(Complex)) != 0) return 1;
+    for(size_t i=0;nb1 && i<c0->n;i++)
+        if(nb1[i].n != nb0[i].n || (nb0[i].n > 0 && memcmp(nb0[i].data, nb1[i].data, nb0[i].n * sizeof(int)) != 0))
+            return 1;
+    return 0;
+}
+
+int main(void){
+    char dir[] = "/tmp/framecache_checkXXXXXX";
+    if(!mkdtemp(dir)){ perror("framecache_check: mkdtemp"); return 1; }
+    FrameCache *C = framecache_open(dir, 0);
+    if(!C){ remove_dir(dir); return 1; }
+
+    /* one snapshot: random COMs, psi6 and neighbor lists (some empty) */
+    uint64_t seed = 11;
+    Vec2Array coms;
+    v2a_init(&coms);
+    Complex p6[M];
+    IntArray nb[M];
+    int bad = 0;
+    for(int i=0;i<M;i++){
+        Vec2 v = { rng_uniform(&seed) * 50.0, rng_uniform(&seed) * 50.0 };
+        bad |= v2a_push(&coms, v) != 0;
+        p6[i].re = rng_uniform(&seed) - 0.5;
+        p6[i].im = rng_uniform(&seed) - 0.5;
+        ia_init(&nb[i]);
+        const int deg = i % 7 == 0 ? 0 : 3 + (int)(rng_next(&seed) % 5);
+        for(int k=0;k<deg;k++) bad |= ia_push(&nb[i], (int)(rng_next(&seed) % M)) != 0;
+    }
+    if(bad){ fprintf(stderr,"framecache_check: OOM\n"); return 1; }
+
+    const uint64_t key = 0x0123456789abcdefULL;
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/%016llx.bin", dir, (unsigned long long)key);
+
+    /* round trip, with and without the neighbor lists */
+    Vec2Array c1;
+    Complex *p1 = NULL;
+    IntArray *nb1 = NULL;
+    int nc = 0;
+    if(framecache_store(C, key, &coms, nb, p6, 57) != 0 ||
+       framecache_load(C, key, &c1, &p1, &nb1, &nc) != 0 ||
+       nc != 57 || same(&coms, nb, p6, &c1, nb1, p1)){
+        fprintf(stderr,"framecache_check: round trip failed\n");
+        bad++;
+    }else{
+        free_neighbors(nb1, M);
+        v2a_free(&c1);
+        mem_free(p1);
+        if(framecache_load(C, key, &c1, &p1, NULL, &nc) != 0 || same(&coms, nb, p6, &c1, NULL, p1)){
+            fprintf(stderr,"framecache_check: load without neighbors failed\n");
+            bad++;
+        }else{
+            v2a_free(&c1);
+            mem_free(p1);
+        }
+    }
+    if(framecache_load(C, key + 1, &c1, &p1, &nb1, &nc) != 1){
+        fprintf(stderr,"framecache_check: missing key was found\n");
+        bad++;
+    }
+
+    /* damaged entries: each byte flipped in turn, then a truncated file */
+    const long size = file_size(path);
+    long hits0, misses0, rej0, hits, misses, rej;
+    framecache_stats(C, &hits0, &misses0, &rej0);
+    int nflip = 0, missed = 0;
+    for(long at=0;at<=size;at++){
+        if(framecache_store(C, key, &coms, nb, p6, 57) != 0){ bad++; break; }
+        if(at < size){
+            if(flip_byte(path, at) != 0){ bad++; break; }
+        }else if(truncate(path, size - 1) != 0){
+            bad++;
+            break;
+        }
+        nflip++;
+        if(framecache_load(C, key, &c1, &p1, &nb1, &nc) == 0){
+            if(missed++ == 0) fprintf(stderr,"framecache_check: damage at byte %ld of %ld not detected\n", at, size);
+            free_neighbors(nb1, M);
+            v2a_free(&c1);
+            mem_free(p1);
+        }else if(access(path, F_OK) == 0){
+            fprintf(stderr,"framecache_check: rejected entry was not removed\n");
+            bad++;
+        }
+    }
+    framecache_stats(C, &hits, &misses, &rej);
+    if(rej - rej0 != nflip - missed || hits != hits0 + missed){
+        fprintf(stderr,"framecache_check: %ld rejected for %d damaged entries\n", rej - rej0, nflip);
+        bad++;
+    }
+    bad += missed;
+
+    framecache_close(C);
+    remove_dir(dir);
+    for(int i=0;i<M;i++) ia_free(&nb[i]);
+    v2a_free(&coms);
+    printf("framecache_check: round trip and %d damaged entries (file %ld bytes), %d failure(s)\n", nflip, size, bad);
+    return bad != 0;
+}
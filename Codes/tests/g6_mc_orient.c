@@ -0,0 +1,75 @@
+/*
+ * g6_mc_orient.c
+ *
+ * The Monte Carlo g6 estimator must estimate the same quantity as the
+ * all-pairs kernel. Im(psi_i conj psi_j) changes sign with the pair's
+ * orientation, and the exact kernel takes it for i < j. Here one bin holds a
+ * single pair (a point 0.25 from point 0 of a lattice of spacing 2), so the MC
+ * estimate of that bin must equal the exact value whichever way round the
+ * sampler draws the pair.
+ *
+ * Exit status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "g6accum.h"
+#include "testutil.h"
+
+#define SIDE 4
+#define SPACING 2.0
+#define DR 0.5
+
+/* Re, Im and pair count of coarse bin 0 after one snapshot */
+static int bin0(int mc, const Vec2Array *coms, const Complex *psi6, double box, double out[3]){
+    G6Accum *A = g6accum_create(DR);
+    if(!A) return 1;
+    int rc = 0;
+    if(mc){
+        G6MCParams p;
+        g6accum_mc_defaults(&p);
+        p.tol = 0.005;
+        p.min_samples = 1;          /* sample even this small snapshot */
+        p.max_samples = 200000;
+        G6MCStats st;
+        rc = g6accum_accumulate_mc(A, coms, psi6, true, box, box, &p, &st);
+        if(rc == 0 && st.exact){ fprintf(stderr,"g6_mc_orient: snapshot too small for sampling\n"); rc = 1; }
+    } else {
+        g6accum_accumulate(A, coms, psi6, true, box, box);
+    }
+    g6accum_coarse_sums(A, 1, &out[0], &out[1], &out[2]);
+    g6accum_free(A);
+    return rc;
+}
+
+int main(void){
+    const int M = SIDE * SIDE + 1;
+    const double box = SIDE * SPACING;
+    Vec2Array coms;
+    v2a_init(&coms);
+    for(int k=0;k<SIDE*SIDE;k++) v2a_push(&coms, (Vec2){ (k % SIDE) * SPACING, (k / SIDE) * SPACING });
+    v2a_push(&coms, (Vec2){ 0.25, 0.0 });     /* the only pair closer than DR: (0, M-1) */
+
+    Complex *psi6 = (Complex*)malloc((size_t)M * sizeof(Complex));
+    if(!psi6 || coms.n != (size_t)M){ fprintf(stderr,"g6_mc_orient: OOM\n"); return 1; }
+    uint64_t seed = 11;
+    for(int i=0;i<M;i++){
+        const double a = 6.283185307179586 * rng_uniform(&seed);
+        psi6[i] = (Complex){ cos(a), sin(a) };
+    }
+
+    double ex[3], mc[3];
+    if(bin0(0, &coms, psi6, box, ex) != 0 || bin0(1, &coms, psi6, box, mc) != 0) return 1;
+    const double ex_re = ex[0] / ex[2], ex_im = ex[1] / ex[2];
+    const double mc_re = mc[0] / mc[2], mc_im = mc[1] / mc[2];
+    printf("g6_mc_orient: bin 0 exact (%.6f, %.6f) from %.0f pair(s), MC (%.6f, %.6f)\n",
+           ex_re, ex_im, ex[2], mc_re, mc_im);
+    const int ok = ex[2] == 1.0 && mc[2] > 0.0 && fabs(mc_re - ex_re) < 1e-9 && fabs(mc_im - ex_im) < 1e-9;
+    if(!ok) fprintf(stderr,"g6_mc_orient: MC and exact disagree\n");
+    v2a_free(&coms);
+    free(psi6);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+/*
+ * g6bin_check.c
+ *
+ * The r^2 edge table (g6_edge2 / g6accum_build_lookup) must bin every
+ * squared distance exactly as the reference rule on r = sqrt(r2): coarse bin
+ * floor(r / dr), then the fine bin within it. Swept over every fine and
+ * coarse edge and the nextafter neighbours on both sides, plus random values,
+ * for several dr / subdiv. A raw dump read back with g6accum_read_raw must
+ * write the same dump again. The lane-split all-pairs kernel must give the
+ * fine histogram of a plain scalar loop over the pairs i < j: pair counts
+ * exactly, Re and Im sums to within rounding.
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* mkstemp */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "g6accum.h"
+#include "utils.h"
+#include "testutil.h"
+
+#define RMAX   40.0
+#define NSTEPS 4          /* nextafter steps on each side of an edge */
+
+/* Reference: sqrt, coarse floor(r / dr), then the sub-bin (as g6accum.c documents) */
+static int ref_bin(double dr, int subdiv, double r2){
+    const double r = sqrt(r2), inv_fine = subdiv / dr;
+    const int b = (int)floor(r / dr);
+    int s = (int)((r - b * dr) * inv_fine);
+    if(s < 0) s = 0;
+    if(s >= subdiv) s = subdiv - 1;
+    return b * subdiv + s;
+}
+
+/* Mismatches of the table lookup around r2 */
+static int sweep(G6Accum *A, double dr, int subdiv, double r2, long *n){
+    int bad = 0;
+    double lo = r2, hi = r2;
+    for(int k=0;k<NSTEPS;k++){
+        lo = nextafter(lo, 0.0);
+        hi = nextafter(hi, INFINITY);
+    }
+    for(double x = lo; x <= hi; x = nextafter(x, INFINITY)){
+        const int f = g6accum_bin_of_r2(A, x), g = ref_bin(dr, subdiv, x);
+        (*n)++;
+        if(f != g){
+            if(bad++ == 0) fprintf(stderr,"g6bin_check: dr %g subdiv %d: r2 %.17g binned %d, reference %d\n", dr, subdiv, x, f, g);
+        }
+    }
+    return bad;
+}
+
+static int check_edges(double dr, int subdiv, uint64_t *seed, long *n){
+    G6Accum *A = g6accum_create_fine(dr, subdiv);
+    if(!A) return 1;
+    g6accum_bin_of_r2(A, RMAX * RMAX);     /* size the tables once */
+    const int nfine = (int)(RMAX / dr) * subdiv;
+    const double w = dr / subdiv;
+    int bad = 0;
+    for(int f=0;f<=nfine;f++){
+        const double r = f * w, rs = (f / subdiv) * dr + (f % subdiv) * w;
+        bad += sweep(A, dr, subdiv, r * r, n);
+        if(rs != r) bad += sweep(A, dr, subdiv, rs * rs, n);
+    }
+    for(int k=0;k<20000;k++){
+        const double r2 = rng_uniform(seed) * (RMAX - dr) * (RMAX - dr);
+        bad += g6accum_bin_of_r2(A, r2) != ref_bin(dr, subdiv, r2);
+        (*n)++;
+    }
+    g6accum_free(A);
+    return bad;
+}
+
+static int file_bytes(const char *path, char **buf, long *len){
+    FILE *f = fopen(path, "rb");
+    if(!f) return 1;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    *buf = (char*)malloc((size_t)*len + 1);
+    const int rc = !*buf || fread(*buf, 1, (size_t)*len, f) != (size_t)*len;
+    fclose(f);
+    return rc;
+}
+
+/* write_raw -> read_raw -> write_raw gives the same file */
+static int check_raw_roundtrip(uint64_t *seed){
+    const double box = 30.0;
+    Vec2Array coms;
+    v2a_init(&coms);
+    Complex *p6 = (Complex*)malloc(600 * sizeof(Complex));
+    if(!p6) return 1;
+    for(int i=0;i<600;i++){
+        v2a_push(&coms, (Vec2){ rng_uniform(seed) * box, rng_uniform(seed) * box });
+        const double a = 6.283185307179586 * rng_uniform(seed);
+        p6[i] = (Complex){ cos(a), sin(a) };
+    }
+    G6Accum *A = g6accum_create(0.5);
+    if(!A) return 1;
+    g6accum_accumulate(A, &coms, p6, true, box, box);
+    g6accum_add_note(A, "round trip");
+
+    char p1[] = "/tmp/g6bin_checkXXXXXX", p2[] = "/tmp/g6bin_checkXXXXXX";
+    const int fd1 = mkstemp(p1), fd2 = mkstemp(p2);
+    int bad = fd1 < 0 || fd2 < 0;
+    if(fd1 >= 0) close(fd1);
+    if(fd2 >= 0) close(fd2);
+    G6Accum *B = NULL;
+    char *b1 = NULL, *b2 = NULL;
+    long l1 = 0, l2 = 0;
+    bad = bad || g6accum_write_raw(A, p1, 3, 9, 1.5, true, box, box) != 0;
+    bad = bad || (B = g6accum_read_raw(p1, NULL)) == NULL;
+    bad = bad || g6accum_write_raw(B, p2, 3, 9, 1.5, true, box, box) != 0;
+    bad = bad || file_bytes(p1, &b1, &l1) != 0 || file_bytes(p2, &b2, &l2) != 0;
+    bad = bad || l1 != l2 || memcmp(b1, b2, (size_t)l1) != 0;
+    if(bad) fprintf(stderr,"g6bin_check: raw dump changed through read_raw\n");
+    free(b1);
+    free(b2);
+    remove(p1);
+    remove(p2);
+    g6accum_free(A);
+    g6accum_free(B);
+    free(p6);
+    v2a_free(&coms);
+    return bad;
+}
+
+/* Fine sums of a raw dump: re, im, count per bin (malloc'd, 3 per bin) */
+static double *raw_sums(const char *path, int *nbins){
+    FILE *f = fopen(path, "r");
+    if(!f) return NULL;
+    char line[4096];
+    int cap = 0;
+    double *v = NULL;
+    *nbins = 0;
+    while(fgets(line, sizeof(line), f)){
+        int b;
+        double re, im, cnt, ess;
+        if(line[0] == '#' || sscanf(line, "%d %lf %lf %lf %lf", &b, &re, &im, &cnt, &ess) != 5) continue;
+        if(b >= cap){
+            const int nc = 2 * b + 64;
+            double *t = (double*)realloc(v, (size_t)nc * 3 * sizeof(double));
+            if(!t){ free(v); fclose(f); return NULL; }
+            memset(t + 3 * (size_t)cap, 0, (size_t)(nc - cap) * 3 * sizeof(double));
+            v = t;
+            cap = nc;
+        }
+        v[3*b] = re; v[3*b+1] = im; v[3*b+2] = cnt;
+        if(b + 1 > *nbins) *nbins = b + 1;
+    }
+    fclose(f);
+    return v;
+}
+
+/* Lane-split kernel on T chunks = scalar loop over i < j */
+static int check_lanes(int M, bool pbc, int T, uint64_t *seed){
+    const double box = 25.0, dr = 0.25;
+    Vec2Array coms;
+    v2a_init(&coms);
+    Complex *p6 = (Complex*)malloc((size_t)M * sizeof(Complex));
+    if(!p6) return 1;
+    for(int i=0;i<M;i++){
+        Vec2 v = { rng_uniform(seed) * box, rng_uniform(seed) * box };
+        if(i > 0 && rng_next(seed) % 20 == 0) v = coms.data[rng_next(seed) % (uint64_t)i];
+        else if(rng_next(seed) % 30 == 0) v.x += box;        /* outside the box */
+        v2a_push(&coms, v);
+        const double a = 6.283185307179586 * rng_uniform(seed);
+        p6[i] = (Complex){ 0.3 + 0.7 * cos(a), 0.7 * sin(a) };
+    }
+
+    /* reference histogram: re, im, count and sum |re| + |im| per fine bin */
+    G6Accum *R = g6accum_create(dr);
+    const double dmax = pbc ? box : 2.0 * box;
+    const int nref = R ? g6accum_bin_of_r2(R, 2.0 * dmax * dmax) + 1 : 0;
+    double *ref = (double*)calloc((size_t)nref * 4 + 4, sizeof(double));
+    if(!R || !ref) return 1;
+    for(int i=0;i<M;i++)
+        for(int j=i+1;j<M;j++){
+            double xi = coms.data[i].x, yi = coms.data[i].y, xj = coms.data[j].x, yj = coms.data[j].y;
+            if(pbc){
+                if(xi < 0.0 || xi >= box) xi = wrap_pos(xi, box);
+                if(yi < 0.0 || yi >= box) yi = wrap_pos(yi, box);
+                if(xj < 0.0 || xj >= box) xj = wrap_pos(xj, box);
+                if(yj < 0.0 || yj >= box) yj = wrap_pos(yj, box);
+            }
+            double dx = xj - xi, dy = yj - yi;
+            if(pbc){
+                if(dx > 0.5 * box) dx -= box; else if(dx < -0.5 * box) dx += box;
+                if(dy > 0.5 * box) dy -= box; else if(dy < -0.5 * box) dy += box;
+            }
+            const int f = g6accum_bin_of_r2(R, dx*dx + dy*dy);
+            if(f < 0 || f >= nref) continue;
+            const double re = p6[i].re * p6[j].re + p6[i].im * p6[j].im;
+            const double im = p6[i].im * p6[j].re - p6[i].re * p6[j].im;
+            ref[4*f] += re;
+            ref[4*f+1] += im;
+            ref[4*f+2] += 1.0;
+            ref[4*f+3] += fabs(re) + fabs(im);
+        }
+
+    G6Accum *A = g6accum_create(dr);
+    char path[] = "/tmp/g6bin_checkXXXXXX";
+    const int fd = mkstemp(path);
+    int bad = !A || fd < 0, nb = 0;
+    if(fd >= 0) close(fd);
+    double *got = NULL;
+    if(!bad){
+        g6accum_set_chunks(A, T);
+        g6accum_accumulate(A, &coms, p6, pbc, box, box);
+        bad = g6accum_write_raw(A, path, 0, 0, 1.0, pbc, box, box) != 0 || (got = raw_sums(path, &nb)) == NULL;
+    }
+    int ndiff = 0;
+    for(int f=0;!bad && f<(nb > nref ? nb : nref);f++){
+        const double gre = f < nb ? got[3*f] : 0.0, gim = f < nb ? got[3*f+1] : 0.0, gcnt = f < nb ? got[3*f+2] : 0.0;
+        const double *r = f < nref ? &ref[4*f] : ref + 4 * (size_t)nref;
+        const double tol = 1e-12 * r[3];
+        if(gcnt != r[2] || fabs(gre - r[0]) > tol || fabs(gim - r[1]) > tol){
+            if(ndiff++ == 0)
+                fprintf(stderr,"g6bin_check: %d points, pbc %d, %d chunk(s): bin %d count %.0f re %.17g im %.17g, scalar %.0f %.17g %.17g\n",
+                        M, (int)pbc, T, f, gcnt, gre, gim, r[2], r[0], r[1]);
+        }
+    }
+    remove(path);
+    free(got);
+    free(ref);
+    g6accum_free(A);
+    g6accum_free(R);
+    free(p6);
+    v2a_free(&coms);
+    return bad + ndiff;
+}
+
+int main(void){
+    static const struct { double dr; int subdiv; } cfg[] = {
+        { 0.5, 8 }, { 0.1, 8 }, { 0.3, 5 }, { 1.0 / 3.0, 3 }, { 0.05, 1 }, { 2.0, 16 }
+    };
+    const int ncfg = (int)(sizeof(cfg) / sizeof(cfg[0]));
+    uint64_t seed = 41;
+    long n = 0;
+    int bad = 0;
+    for(int k=0;k<ncfg;k++) bad += check_edges(cfg[k].dr, cfg[k].subdiv, &seed, &n);
+    bad += check_raw_roundtrip(&seed);
+    static const int sizes[3] = { 37, 700, 1900 };
+    for(int k=0;k<3;k++)
+        for(int pbc=0;pbc<2;pbc++)
+            for(int T=1;T<=5;T+=2) bad += check_lanes(sizes[k], pbc, T, &seed);
+    printf("g6bin_check: %ld squared distances on %d grids, raw round trip, 18 kernel runs vs the scalar loop, %d mismatch(es)\n",
+           n, ncfg, bad);
+    return bad != 0;
+}
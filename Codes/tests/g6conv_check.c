@@ -0,0 +1,83 @@
+/*
+ * g6conv_check.c
+ *
+ * The --g6-conv-tol monitor must stop a run whose g6 average is stationary and
+ * keep going while it drifts. Each snapshot here is one pair at r = 0.75
+ * (coarse bin 1 of dr = 0.5) with psi6 = (1, a_t), so it adds exactly a_t to
+ * Re g6 in that bin:
+ *   - a_t = 1: converged at the first check with G6CONV_MIN_BLOCKS blocks,
+ *     never earlier;
+ *   - a_t = 1 + small noise: converged at a block end, within 10 blocks;
+ *   - a_t growing 10% per snapshot, or alternating blocks of 1 and 3: never
+ *     converged, with one check per block.
+ *
+ * Exit status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "g6conv.h"
+#include "testutil.h"
+
+#define DR     0.5
+#define EVERY  5
+#define NFRAME 200
+#define TOL    0.05
+
+enum { SERIES_CONST, SERIES_NOISE, SERIES_GROW, SERIES_STEP };
+static const char *const SERIES_NAMES[] = { "constant", "noisy", "growing", "alternating" };
+
+static double series(int kind, int t, uint64_t *seed){
+    switch(kind){
+    case SERIES_CONST: return 1.0;
+    case SERIES_NOISE: return 1.0 + 0.02 * (rng_uniform(seed) - 0.5);
+    case SERIES_GROW:  return pow(1.1, t);
+    default:           return (t / EVERY) % 2 ? 3.0 : 1.0;
+    }
+}
+
+/* Feed NFRAME snapshots; the frame (1-based) g6conv_add first returned 1, or 0 */
+static long run(int kind, G6ConvReport *rep){
+    G6Conv *C = g6conv_create(TOL, EVERY, DR, DR, 2.0 * DR);
+    G6Accum *F = g6accum_create(DR);
+    Vec2 pts[2] = { { 0.0, 0.0 }, { 0.75, 0.0 } };
+    Vec2Array coms = { pts, 2, 2 };
+    Complex psi[2] = { { 1.0, 0.0 }, { 0.0, 0.0 } };
+    uint64_t seed = 21;
+    long first = 0;
+    if(!C || !F){ fprintf(stderr,"g6conv_check: OOM\n"); exit(1); }
+    for(int t=0;t<NFRAME;t++){
+        psi[1].re = series(kind, t, &seed);
+        g6accum_clear(F);
+        g6accum_accumulate(F, &coms, psi, false, 0.0, 0.0);
+        if(g6conv_add(C, F) && !first) first = t + 1;
+    }
+    g6conv_report(C, rep);
+    g6conv_free(C);
+    g6accum_free(F);
+    return first;
+}
+
+int main(void){
+    int bad = 0;
+    for(int kind=0;kind<4;kind++){
+        G6ConvReport rep;
+        const long first = run(kind, &rep);
+        int ok = rep.frames == NFRAME && rep.checks == (first ? first : NFRAME) / EVERY;
+        if(kind == SERIES_CONST) ok = ok && first == G6CONV_MIN_BLOCKS * EVERY;
+        else if(kind == SERIES_NOISE) ok = ok && first >= G6CONV_MIN_BLOCKS * EVERY && first <= 10 * EVERY
+                                             && first % EVERY == 0 && rep.converged;
+        else ok = ok && first == 0 && !rep.converged;
+        if(!ok){
+            fprintf(stderr,"g6conv_check: %s series: converged at frame %ld after %ld check(s) of %ld frames "
+                    "(max error %.3g, max change %.3g)\n",
+                    SERIES_NAMES[kind], first, rep.checks, rep.frames, rep.max_err, rep.max_change);
+            bad++;
+        }
+    }
+    printf("g6conv_check: stationary and drifting block data (4 series of %d snapshots), %d failure(s)\n",
+           NFRAME, bad);
+    return bad != 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * parse_check.c
+ *
+ * The chunked parse (parse_snapshot_xy, and read_snapshot_xy on a mapped
+ * file) must give exactly the points of the original fgets loop. Linked
+ * against io.c built with IO_PARSE_CHUNK=64, so even small inputs are cut
+ * into many chunks whose boundaries land on every kind of line: comments,
+ * blank lines, CRLF endings, embedded NULs, malformed lines, lines longer
+ * than the 4095-byte fgets buffer, and a missing final newline. Run without
+ * a pool and on pools of 1 and 4 threads.
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* mkstemp */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "tpool.h"
+#include "memacct.h"
+#include "testutil.h"
+
+#define NINPUTS 12
+
+typedef struct {
+    char  *b;
+    size_t n, cap;
+} Buf;
+
+static int put(Buf *B, const char *s, size_t n){
+    if(B->n + n > B->cap){
+        size_t cap = B->cap ? B->cap : 4096;
+        while(cap < B->n + n) cap *= 2;
+        char *t = (char*)realloc(B->b, cap);
+        if(!t) return 1;
+        B->b = t;
+        B->cap = cap;
+    }
+    memcpy(B->b + B->n, s, n);
+    B->n += n;
+    return 0;
+}
+
+static int puts_(Buf *B, const char *s){ return put(B, s, strlen(s)); }
+
+static int pad(Buf *B, char c, size_t n){
+    int rc = 0;
+    for(size_t i=0;i<n && !rc;i++) rc = put(B, &c, 1);
+    return rc;
+}
+
+/* One random line of a pathological snapshot file */
+static int add_line(Buf *B, uint64_t *seed){
+    char num[128];
+    const uint64_t r = rng_next(seed);
+    snprintf(num, sizeof(num), "%.17g %.9g %d", (double)(r >> 11) * 0x1p-53 * 100.0,
+             (double)(int)(r % 20000) * 0.01 - 100.0, (int)(r % 3));
+    switch((r >> 40) % 14){
+    case 0:  return puts_(B, "# comment 1.0 2.0 3.0\n");
+    case 1:  return puts_(B, "\n");
+    case 2:  return puts_(B, num) || puts_(B, "\r\n");
+    case 3:  return puts_(B, "   ") || puts_(B, num) || puts_(B, " extra columns\n");
+    case 4:  return puts_(B, "1.5 2.5\n");                               /* too few columns */
+    case 5:  return puts_(B, "nan-ish x y z\n");
+    case 6:  return puts_(B, num) || put(B, "\0 9 9 9\n", 8);           /* NUL mid-line */
+    case 7:  return put(B, "\0", 1) || puts_(B, num) || puts_(B, "\n");  /* NUL first */
+    case 8:  return pad(B, ' ', 4000 + (size_t)(r % 300)) || puts_(B, num) || puts_(B, "\n");
+    case 9:  return puts_(B, num) || pad(B, ' ', 4090 + (size_t)(r % 12)) || puts_(B, "7 8 9\n");
+    case 10: return pad(B, '#', 4095 * (1 + (size_t)(r % 2))) || puts_(B, num) || puts_(B, "\n");
+    case 11: return puts_(B, "\t") || puts_(B, num) || puts_(B, "\n");
+    default: return puts_(B, num) || puts_(B, "\n");
+    }
+}
+
+/* The original reader: fgets into a 4096-byte line, three numbers per line */
+static int ref_parse(const char *path, Vec2Array *pos){
+    FILE *fp = fopen(path, "rb");
+    if(!fp) return 1;
+    char line[4096];
+    while(fgets(line, sizeof(line), fp)){
+        if(line[0] == '#' || line[0] == '\n') continue;
+        double x, y, z;
+        if(sscanf(line, "%lf %lf  %lf", &x, &y, &z) == 3) v2a_push(pos, (Vec2){x, y});
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int same(const Vec2Array *a, const Vec2Array *b){
+    return a->n == b->n && (a->n == 0 || memcmp(a->data, b->data, a->n * sizeof(Vec2)) == 0);
+}
+
+int main(void){
+    uint64_t seed = 17;
+    int bad = 0, ncmp = 0;
+    for(int k=0;k<NINPUTS;k++){
+        Buf B = { NULL, 0, 0 };
+        const int nlines = k == 0 ? 0 : k == 1 ? 1 : 50 + (int)(rng_next(&seed) % 3000);
+        int rc = 0;
+        for(int i=0;i<nlines && !rc;i++) rc = add_line(&B, &seed);
+        /* odd inputs end without a final newline */
+        if(!rc && k % 2 == 1) rc = puts_(&B, "3.25 4.5 0");
+        if(rc){ fprintf(stderr,"parse_check: OOM\n"); return 1; }
+
+        char path[] = "/tmp/parse_checkXXXXXX";
+        const int fd = mkstemp(path);
+        if(fd < 0 || (B.n > 0 && write(fd, B.b, B.n) != (ssize_t)B.n)){
+            perror("parse_check: temp file");
+            return 1;
+        }
+        close(fd);
+
+        Vec2Array ref;
+        v2a_init(&ref);
+        if(ref_parse(path, &ref) != 0){ perror("parse_check: reference"); return 1; }
+
+        /* exact-size copy: parse_snapshot_xy must not read past len */
+        char *exact = (char*)malloc(B.n ? B.n : 1);
+        if(!exact){ fprintf(stderr,"parse_check: OOM\n"); return 1; }
+        if(B.n) memcpy(exact, B.b, B.n);
+
+        const int sizes[3] = { 0, 1, 4 };
+        for(int s=0;s<3;s++){
+            TPool *P = sizes[s] ? tpool_create(sizes[s]) : NULL;
+            if(sizes[s] && !P){ fprintf(stderr,"parse_check: tpool_create failed\n"); return 1; }
+            tpool_set_default(P);
+            Vec2Array a, b;
+            v2a_init(&a);
+            v2a_init(&b);
+            if(parse_snapshot_xy(exact, B.n, &a) != 1 || !same(&ref, &a)){
+                fprintf(stderr,"parse_check: input %d (%zu bytes), %d thread(s): parse_snapshot_xy %zu points, fgets %zu\n",
+                        k, B.n, sizes[s], a.n, ref.n);
+                bad++;
+            }
+            if(read_snapshot_xy(path, &b) != 1 || !same(&ref, &b)){
+                fprintf(stderr,"parse_check: input %d (%zu bytes), %d thread(s): read_snapshot_xy %zu points, fgets %zu\n",
+                        k, B.n, sizes[s], b.n, ref.n);
+                bad++;
+            }
+            ncmp += 2;
+            v2a_free(&a);
+            v2a_free(&b);
+            tpool_set_default(NULL);
+            if(P) tpool_free(P);
+        }
+        v2a_free(&ref);
+        free(exact);
+        free(B.b);
+        remove(path);
+    }
+    printf("parse_check: %d comparisons with the fgets parse over %d inputs, %d mismatch(es)\n", ncmp, NINPUTS, bad);
+    return bad != 0;
+}
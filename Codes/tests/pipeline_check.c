@@ -0,0 +1,239 @@
+/*
+ * pipeline_check.c
+ *
+ * End-to-end checks of hexatic_g6_avg and g6_rebin on synthetic snapshots
+ * (a noisy triangular lattice under PBC): results that the options promise to
+ * be equal are compared value by value, ignoring the '#' header lines.
+ *   - g6_rebin with --out-dr / --out-log on the raw dump of a run gives the
+ *     same file as a run made with that binning.
+ *   - g6 does not depend on --threads: snapshots large enough for several
+ *     chunks of the pair loop give the same raw sums on 1 and 3 threads,
+ *     with the default chunk count and a given --g6-chunks.
+ *   - --window: the raw dump of a sliding window equals that of a separate
+ *     run over the window's snapshots, bit for bit.
+ *   - the size filter on snapshots of single particles: the cluster counts in
+ *     the header keep none with --min-cluster-size=2, all with
+ *     --max-cluster-size=1.
+ * Runs the binaries built in the current directory (make test runs it from
+ * Codes/).
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* mkdtemp */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "testutil.h"
+
+#define PROG  "./hexatic_g6_avg"
+#define REBIN "./g6_rebin"
+
+#define LBOND "0.6"
+#define DR    "0.5"
+
+/* Snapshots of a noisy triangular lattice of nx columns and ny rows (ny even,
+   so the lattice tiles the box under PBC) */
+typedef struct {
+    const char *dir;
+    double box_x, box_y;
+} DataSet;
+
+static char base[] = "/tmp/pipeline_checkXXXXXX";
+
+/* base/name, in a static buffer per call slot */
+static const char *sub(int slot, const char *fmt, ...){
+    static char buf[8][4096];
+    char name[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(name, sizeof(name), fmt, ap);
+    va_end(ap);
+    snprintf(buf[slot], sizeof(buf[slot]), "%s/%s", base, name);
+    return buf[slot];
+}
+
+/* Snapshots time_t0 .. time_t1 of D (dir created) */
+static int write_snapshots(DataSet *D, const char *dir, int nx, int ny, int t0, int t1, uint64_t seed){
+    const double h = 0.5 * sqrt(3.0);
+    D->dir = dir;
+    D->box_x = nx;
+    D->box_y = ny * h;
+    if(mkdir(dir, 0700) != 0) return 1;
+    for(int t=t0;t<=t1;t++){
+        char path[4200];
+        snprintf(path, sizeof(path), "%s/time_%d.dat", dir, t);
+        FILE *f = fopen(path, "w");
+        if(!f) return 1;
+        fprintf(f, "# snapshot\n");
+        const double amp = 0.04 + 0.08 * rng_uniform(&seed);
+        for(int j=0;j<ny;j++)
+            for(int i=0;i<nx;i++){
+                const double x = i + 0.5 * (j % 2) + amp * (rng_uniform(&seed) - 0.5);
+                const double y = j * h + amp * (rng_uniform(&seed) - 0.5);
+                fprintf(f, "%.9f %.9f 0.0\n", x, y);
+            }
+        if(fclose(f) != 0) return 1;
+    }
+    return 0;
+}
+
+/* Run hexatic_g6_avg on D over t0..t1 into out (created), extra options appended */
+static int run(const DataSet *D, int t0, int t1, const char *out, const char *opts){
+    char cmd[16384];
+    if(mkdir(out, 0700) != 0) return 1;
+    snprintf(cmd, sizeof(cmd), PROG " '%s/' %d %d '%s' " LBOND " " DR " 1 %.17g %.17g %s >/dev/null 2>&1",
+             D->dir, t0, t1, out, D->box_x, D->box_y, opts);
+    return system(cmd) != 0;
+}
+
+/* Numbers of the non-comment lines of a file (malloc'd) */
+static double *read_values(const char *path, size_t *n){
+    FILE *f = fopen(path, "r");
+    if(!f) return NULL;
+    size_t cap = 1024;
+    double *v = (double*)malloc(cap * sizeof(double));
+    char line[4096];
+    *n = 0;
+    while(v && fgets(line, sizeof(line), f)){
+        if(line[0] == '#') continue;
+        char *p = line, *end;
+        for(double x = strtod(p, &end); end != p; x = strtod(p, &end)){
+            if(*n == cap){
+                double *t = (double*)realloc(v, 2 * cap * sizeof(double));
+                if(!t){ free(v); v = NULL; break; }
+                v = t;
+                cap *= 2;
+            }
+            v[(*n)++] = x;
+            p = end;
+        }
+    }
+    fclose(f);
+    return v;
+}
+
+/* 0 if the data of the two files agree to a relative tol (0: exactly) */
+static int same_data(const char *what, const char *a, const char *b, double tol){
+    size_t na = 0, nb = 0;
+    double *va = read_values(a, &na), *vb = read_values(b, &nb);
+    int bad = !va || !vb || na != nb || na == 0;
+    size_t ndiff = 0;
+    for(size_t k=0;!bad && k<na;k++)
+        if(fabs(va[k] - vb[k]) > tol * fmax(fabs(va[k]), fabs(vb[k]))) ndiff++;
+    if(bad) fprintf(stderr,"pipeline_check: %s: %s (%zu values) vs %s (%zu values)\n", what, a, na, b, nb);
+    else if(ndiff) fprintf(stderr,"pipeline_check: %s: %zu of %zu values differ\n", what, ndiff, na);
+    free(va);
+    free(vb);
+    return bad || ndiff;
+}
+
+/* g6_rebin on the raw dump = a run with that binning */
+static int check_rebin(const DataSet *data){
+    static const char *bins[2] = { "--out-dr=1.0", "--out-log=0.5:8" };
+    int bad = run(data, 0, 5, sub(0, "rebin_fine"), "");
+    for(int k=0;k<2 && !bad;k++){
+        bad = run(data, 0, 5, sub(1, "rebin_direct%d", k), bins[k]);
+        char cmd[16384];
+        snprintf(cmd, sizeof(cmd), REBIN " '%s' '%s' %s >/dev/null 2>&1",
+                 sub(2, "rebin_fine/g6_raw_time_0_5.dat"), sub(3, "rebin_tool%d.dat", k), bins[k]);
+        bad = bad || system(cmd) != 0;
+        bad = bad || same_data(bins[k], sub(2, "rebin_direct%d/g6_avg_time_0_5.dat", k), sub(3, "rebin_tool%d.dat", k), 0.0);
+    }
+    if(bad) fprintf(stderr,"pipeline_check: g6_rebin differs from a direct run\n");
+    return bad;
+}
+
+/* --threads=1 and --threads=3 give the same raw sums */
+static int check_threads(const DataSet *big){
+    static const char *chunks[2] = { "", "--g6-chunks=5" };
+    int bad = 0;
+    for(int k=0;k<2 && !bad;k++){
+        char o1[256], o3[256];
+        snprintf(o1, sizeof(o1), "--threads=1 %s", chunks[k]);
+        snprintf(o3, sizeof(o3), "--threads=3 %s", chunks[k]);
+        bad = run(big, 0, 2, sub(0, "threads1_%d", k), o1) || run(big, 0, 2, sub(1, "threads3_%d", k), o3);
+        bad = bad || same_data(o3, sub(0, "threads1_%d/g6_raw_time_0_2.dat", k), sub(1, "threads3_%d/g6_raw_time_0_2.dat", k), 0.0);
+    }
+    if(bad) fprintf(stderr,"pipeline_check: g6 depends on the number of threads\n");
+    return bad;
+}
+
+/* --window=4:2 raw dumps = separate runs over the same snapshots */
+static int check_window(const DataSet *data){
+    static const int t0s[3] = { 0, 2, 8 };
+    int bad = run(data, 0, 11, sub(0, "window"), "--window=4:2 --threads=2");
+    for(int k=0;k<3 && !bad;k++){
+        const int t0 = t0s[k], t1 = t0 + 3;
+        bad = run(data, t0, t1, sub(1, "window_direct%d", k), "");
+        bad = bad || same_data("--window=4:2", sub(2, "window/g6_raw_time_%d_%d.dat", t0, t1),
+                               sub(3, "window_direct%d/g6_raw_time_%d_%d.dat", k, t0, t1), 0.0);
+    }
+    if(bad) fprintf(stderr,"pipeline_check: a g6 window differs from a separate run\n");
+    return bad;
+}
+
+/* The lattice snapshots are all single particles at lbond 0.6, the path that
+   skips filter_coms_by_size: --min-cluster-size=2 must keep none of them (and
+   skip every snapshot), --max-cluster-size=1 all of them; the header records
+   the counts */
+static int check_singletons(const DataSet *data, long per_frame){
+    static const char *opts[2] = { "--min-cluster-size=2", "--max-cluster-size=1" };
+    const long total = 6 * per_frame, want[2] = { 0, total };
+    int bad = 0;
+    for(int k=0;k<2 && !bad;k++){
+        bad = run(data, 0, 5, sub(0, "singletons%d", k), opts[k]);
+        FILE *f = bad ? NULL : fopen(sub(1, "singletons%d/g6_avg_time_0_5.dat", k), "r");
+        char line[4096];
+        long kept = -1, seen = -1;
+        while(f && fgets(line, sizeof(line), f))
+            if(sscanf(line, "# Clusters kept: %ld of %ld", &kept, &seen) == 2) break;
+        if(f) fclose(f);
+        if(!bad && (kept != want[k] || seen != total)){
+            fprintf(stderr,"pipeline_check: %s: kept %ld of %ld clusters, expected %ld of %ld\n",
+                    opts[k], kept, seen, want[k], total);
+            bad = 1;
+        }
+    }
+    if(bad) fprintf(stderr,"pipeline_check: the size filter miscounts all-singleton snapshots\n");
+    return bad;
+}
+
+int main(void){
+    if(!mkdtemp(base)){ perror("pipeline_check: mkdtemp"); return 1; }
+    int bad = 0, nchecks = 0;
+    DataSet data, big;
+    if(write_snapshots(&data, sub(7, "data"), 16, 18, 0, 11, 31) != 0 ||
+       write_snapshots(&big, sub(6, "big"), 64, 64, 0, 2, 37) != 0){
+        perror("pipeline_check: snapshots");
+        bad++;
+    } else {
+        bad += check_rebin(&data); nchecks++;
+        bad += check_threads(&big); nchecks++;
+        bad += check_window(&data); nchecks++;
+        bad += check_singletons(&data, 16 * 18); nchecks++;
+    }
+
+    /* every run writes into its own directory under base */
+    DIR *d = opendir(base);
+    if(d){
+        struct dirent *e;
+        while((e = readdir(d)) != NULL){
+            if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", base, e->d_name);
+            struct stat st;
+            if(stat(path, &st) == 0 && S_ISDIR(st.st_mode)) remove_dir(path);
+            else remove(path);
+        }
+        closedir(d);
+    }
+    rmdir(base);
+    printf("pipeline_check: %d end-to-end comparison(s), %d failure(s)\n", nchecks, bad);
+    return bad != 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * testutil.h
+ *
+ * Helpers shared by the checks in tests/: a portable random stream and
+ * temporary-directory cleanup. Header-only; every function is static.
+ */
+
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+/* splitmix64: the same inputs on every platform */
+static inline uint64_t rng_next(uint64_t *s){
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Uniform double in [0,1) with 53 random bits */
+static inline double rng_uniform(uint64_t *s){
+    return (double)(rng_next(s) >> 11) * 0x1p-53;
+}
+
+/* Remove every file in dir, then dir itself */
+static inline void remove_dir(const char *dir){
+    DIR *d = opendir(dir);
+    if(d){
+        struct dirent *e;
+        char path[4096];
+        while((e = readdir(d)) != NULL){
+            if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            remove(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+#endif /* TESTUTIL_H */
@@ -0,0 +1,134 @@
+/*
+ * tpool_check.c
+ *
+ * The task pool must run every task exactly once, also when tasks submit
+ * nested jobs of their own (frames x intra-frame chunks in the pipeline); a
+ * thread waiting inside one outer task may help only that task's nested jobs,
+ * never another outer task's; and tpool_parallel_reduce with a fixed grain must combine the chunks in index
+ * order, so an order-sensitive reduction gives the same bits on 1 and on 4
+ * threads as without a pool.
+ *
+ * Exit status 0 on success.
+ */
+
+#define _DEFAULT_SOURCE    /* usleep */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tpool.h"
+
+#define NOUTER 24
+#define NINNER 100
+#define NRED   100003L
+#define GRAIN  1000L
+
+typedef struct {
+    TPool *P;
+    int *hits;   /* NOUTER * NINNER, one slot per inner task */
+} NestCtx;
+
+typedef struct {
+    int *hits;
+    int outer;
+} InnerCtx;
+
+/* outer task the calling thread is inside of (-1: none) */
+static __thread int tl_outer = -1;
+static int foreign = 0;     /* inner tasks run by a thread waiting in another outer task */
+
+static void inner_task(void *ctx, int task){
+    InnerCtx *C = (InnerCtx*)ctx;
+    C->hits[C->outer * NINNER + task]++;
+    if(tl_outer >= 0 && tl_outer != C->outer) __atomic_add_fetch(&foreign, 1, __ATOMIC_RELAXED);
+    if(task % 10 == 0) usleep(20);      /* let other threads steal and wait meanwhile */
+}
+
+static void outer_task(void *ctx, int task){
+    NestCtx *C = (NestCtx*)ctx;
+    InnerCtx I = { C->hits, task };
+    const int saved = tl_outer;
+    tl_outer = task;
+    tpool_run(C->P, NINNER, inner_task, &I);
+    tl_outer = saved;
+}
+
+/* Nested tpool_run: 0 if every inner task ran exactly once, on a thread not
+   waiting in another outer task */
+static int check_nested(TPool *P, int nthreads){
+    int *hits = (int*)calloc((size_t)NOUTER * NINNER, sizeof(int));
+    if(!hits){ fprintf(stderr,"tpool_check: OOM\n"); return 1; }
+    NestCtx C = { P, hits };
+    int bad = 0;
+    for(int rep=0;rep<20;rep++){
+        memset(hits, 0, (size_t)NOUTER * NINNER * sizeof(int));
+        tpool_run(P, NOUTER, outer_task, &C);
+        for(int i=0;i<NOUTER*NINNER;i++) bad += hits[i] != 1;
+    }
+    if(bad) fprintf(stderr,"tpool_check: %d thread(s): %d nested task(s) not run exactly once\n", nthreads, bad);
+    if(foreign) fprintf(stderr,"tpool_check: %d thread(s): %d nested task(s) run inside another outer task\n", nthreads, foreign);
+    bad += foreign;
+    foreign = 0;
+    return bad != 0;
+}
+
+/* Chunk sum of 1/(i+1) in index order, plus the chunk's first index */
+typedef struct {
+    double s;
+    long lo;
+} RedAcc;
+
+typedef struct {
+    double s;      /* sum of chunk sums in combine order (not associative) */
+    long next_lo;  /* expected first index of the next chunk */
+    int order_bad;
+} RedRes;
+
+static void red_body(void *ctx, long lo, long hi, void *acc){
+    (void)ctx;
+    RedAcc *a = (RedAcc*)acc;
+    a->lo = lo;
+    for(long i=lo;i<hi;i++) a->s += 1.0 / (double)(i + 1);
+}
+
+static void red_combine(void *ctx, void *result, const void *acc){
+    (void)ctx;
+    RedRes *r = (RedRes*)result;
+    const RedAcc *a = (const RedAcc*)acc;
+    if(a->lo != r->next_lo) r->order_bad++;
+    r->next_lo = a->lo + GRAIN;
+    r->s = r->s * 0.5 + a->s;
+}
+
+static int reduce(TPool *P, RedRes *r){
+    memset(r, 0, sizeof(*r));
+    return tpool_parallel_reduce(P, NRED, GRAIN, sizeof(RedAcc), red_body, red_combine, NULL, r);
+}
+
+int main(void){
+    int bad = 0;
+    RedRes ref;
+    if(reduce(NULL, &ref) != 0 || ref.order_bad){
+        fprintf(stderr,"tpool_check: serial reduce failed\n");
+        return 1;
+    }
+    const int sizes[2] = { 1, 4 };
+    for(int k=0;k<2;k++){
+        TPool *P = tpool_create(sizes[k]);
+        if(!P){ fprintf(stderr,"tpool_check: tpool_create(%d) failed\n", sizes[k]); return 1; }
+        bad += check_nested(P, sizes[k]);
+        for(int rep=0;rep<20;rep++){
+            RedRes r;
+            if(reduce(P, &r) != 0 || r.order_bad || memcmp(&r.s, &ref.s, sizeof(double)) != 0){
+                fprintf(stderr,"tpool_check: %d thread(s): reduce %.17g (%d chunk(s) out of order), serial %.17g\n",
+                        sizes[k], r.s, r.order_bad, ref.s);
+                bad++;
+                break;
+            }
+        }
+        tpool_free(P);
+    }
+    printf("tpool_check: nested run and ordered reduce on 1 and 4 threads, %d failure(s)\n", bad);
+    return bad != 0;
+}
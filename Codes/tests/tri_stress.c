@@ -0,0 +1,103 @@
+/*
+ * tri_stress.c
+ *
+ * Reentrancy check for the Triangle library path (triangle.c built with
+ * -DTRILIBRARY): triangulates NSETS random point sets serially, then again
+ * from NTHREADS threads at once, several rounds each, and requires every
+ * concurrent edge list to equal the serial one exactly (same edges, same
+ * order). Run it under ThreadSanitizer (make test CFLAGS+=-fsanitize=thread)
+ * to also catch races that happen not to change the output.
+ *
+ * Exit status 0 on success.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define REAL double
+#include "triangle.h"
+#include "testutil.h"
+
+#define NSETS    48
+#define NTHREADS 4
+#define NROUNDS  3
+
+typedef struct {
+    double *xy;
+    int     n;
+    int    *edges;            /* serial result */
+    int     nedges;
+} PointSet;
+
+static PointSet sets[NSETS];
+
+/* Edge list of set k (malloc'd by Triangle, release with trifree) */
+static int triangulate_set(int k, int **edges, int *nedges){
+    struct triangulateio in, out;
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+    in.numberofpoints = sets[k].n;
+    in.pointlist = sets[k].xy;
+    char sw[] = "zeQ";
+    triangulate(sw, &in, &out, NULL);
+    trifree(out.pointlist);
+    trifree(out.trianglelist);
+    *edges = out.edgelist;
+    *nedges = out.numberofedges;
+    return *edges ? 0 : 1;
+}
+
+static void *worker(void *arg){
+    const long id = (long)arg;
+    long bad = 0;
+    for(int r=0;r<NROUNDS;r++)
+        for(int k=(int)id;k<NSETS;k+=NTHREADS){
+            int *e, ne;
+            if(triangulate_set(k, &e, &ne) != 0 || ne != sets[k].nedges ||
+               memcmp(e, sets[k].edges, 2 * (size_t)ne * sizeof(int)) != 0) bad++;
+            trifree(e);
+        }
+    return (void*)bad;
+}
+
+int main(void){
+    uint64_t seed = 7;
+    for(int k=0;k<NSETS;k++){
+        const int n = 200 + (int)(rng_next(&seed) % 3000);
+        sets[k].n = n;
+        sets[k].xy = (double*)malloc(2 * (size_t)n * sizeof(double));
+        if(!sets[k].xy){ fprintf(stderr,"tri_stress: OOM\n"); return 1; }
+        /* a coarse grid for some sets: duplicates and cocircular points */
+        const int grid = k % 4 == 0;
+        for(int i=0;i<2*n;i++)
+            sets[k].xy[i] = grid ? (double)(rng_next(&seed) % 40) * 0.5 : (double)(rng_next(&seed) % 100000) * 0.001;
+        if(triangulate_set(k, &sets[k].edges, &sets[k].nedges) != 0){
+            fprintf(stderr,"tri_stress: serial triangulation of set %d failed\n", k);
+            return 1;
+        }
+    }
+
+    pthread_t th[NTHREADS];
+    long bad = 0;
+    for(long t=0;t<NTHREADS;t++)
+        if(pthread_create(&th[t], NULL, worker, (void*)t) != 0){
+            fprintf(stderr,"tri_stress: cannot start thread\n");
+            return 1;
+        }
+    for(int t=0;t<NTHREADS;t++){
+        void *r;
+        pthread_join(th[t], &r);
+        bad += (long)r;
+    }
+
+    for(int k=0;k<NSETS;k++){
+        free(sets[k].xy);
+        trifree(sets[k].edges);
+    }
+    printf("tri_stress: %d sets x %d rounds on %d threads, %ld mismatch(es) vs serial\n",
+           NSETS, NROUNDS, NTHREADS, bad);
+    return bad != 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * tpool.c
+ *
+ * Work-stealing task pool (see tpool.h). Deques hold jobs, not single tasks:
+ * a job's tasks are claimed one by one under the deque's lock, so one push
+ * makes a whole parallel loop available to every thread. Completion and
+ * sleeping go through the pool lock; `epoch` is bumped whenever new work
+ * appears or a job completes, so waiters cannot miss a wakeup.
+ */
+
+#define _GNU_SOURCE   /* clock_gettime, pthread_setaffinity_np */
+
+#include "tpool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+
+typedef struct TPJob {
+    void (*fn)(void *ctx, int task);
+    void  *ctx;
+    int    ntasks;
+    int    next;      /* next unclaimed task (owner deque lock) */
+    int    done;      /* finished tasks (pool lock) */
+    const struct TPJob *parent;   /* job of the submitting task (NULL at top level) */
+} TPJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    TPJob **jobs;     /* jobs[0] oldest ... jobs[n-1] newest; all have unclaimed tasks */
+    int    n, cap;
+} TPDeque;
+
+struct TPool {
+    int        nthreads;
+    pthread_t *threads;   /* workers 1..nthreads-1 */
+    TPDeque   *dq;        /* one per thread; 0 belongs to the creating thread */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    unsigned long   epoch;
+    int        stop;
+    double     idle;      /* seconds threads slept waiting for work (pool lock) */
+    int        nsleep;    /* threads asleep now, and the sum of their start times */
+    double     sleep_t0;
+};
+
+typedef struct {
+    TPool *P;
+    int    id;
+} TPWorkerArg;
+
+static TPool *tp_default = NULL;
+
+/* calling thread's pool, deque index and the job whose task it is running */
+static __thread TPool *tl_pool = NULL;
+static __thread int    tl_id = 0;
+static __thread const TPJob *tl_job = NULL;
+
+static double tp_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* idle-time bookkeeping around a sleep (pool lock held) */
+static double tp_sleep_begin(TPool *P){
+    double t0 = tp_now();
+    P->nsleep++;
+    P->sleep_t0 += t0;
+    return t0;
+}
+
+static void tp_sleep_end(TPool *P, double t0){
+    P->nsleep--;
+    P->sleep_t0 -= t0;
+    P->idle += tp_now() - t0;
+}
+
+static int tp_self(const TPool *P){
+    return tl_pool == P ? tl_id : 0;
+}
+
+static void tp_signal(TPool *P){
+    pthread_mutex_lock(&P->lock);
+    P->epoch++;
+    pthread_cond_broadcast(&P->cond);
+    pthread_mutex_unlock(&P->lock);
+}
+
+/* 1 if J is root or nested below it. The chain is alive: a job with unclaimed
+   tasks has its submitter waiting in tpool_run, inside a task of the parent. */
+static int tp_below(const TPJob *J, const TPJob *root){
+    for(;J;J=J->parent)
+        if(J == root) return 1;
+    return 0;
+}
+
+/* Claim one task from deque d of a job below root (any job if root is NULL),
+   newest job first for the owner, oldest first for thieves. Returns 1 and
+   fills job and task, or 0. */
+static int tp_claim(TPool *P, int d, const TPJob *root, int newest, TPJob **job, int *task){
+    TPDeque *D = &P->dq[d];
+    int found = 0;
+    pthread_mutex_lock(&D->lock);
+    for(int k=0;k<D->n;k++){
+        int s = newest ? D->n - 1 - k : k;
+        TPJob *J = D->jobs[s];
+        if(root && !tp_below(J, root)) continue;
+        *job = J;
+        *task = J->next++;
+        if(J->next == J->ntasks){
+            memmove(D->jobs + s, D->jobs + s + 1, (size_t)(D->n - s - 1) * sizeof(TPJob*));
+            D->n--;
+        }
+        found = 1;
+        break;
+    }
+    pthread_mutex_unlock(&D->lock);
+    return found;
+}
+
+static int tp_find(TPool *P, int self, const TPJob *root, TPJob **job, int *task){
+    if(tp_claim(P, self, root, 1, job, task)) return 1;
+    for(int k=1;k<P->nthreads;k++){
+        if(tp_claim(P, (self + k) % P->nthreads, root, 0, job, task)) return 1;
+    }
+    return 0;
+}
+
+static void tp_exec(TPool *P, TPJob *J, int task){
+    const TPJob *saved = tl_job;
+    tl_job = J;
+    J->fn(J->ctx, task);
+    tl_job = saved;
+    pthread_mutex_lock(&P->lock);
+    if(++J->done == J->ntasks){
+        P->epoch++;
+        pthread_cond_broadcast(&P->cond);
+    }
+    pthread_mutex_unlock(&P->lock);
+}
+
+static void *tp_worker(void *arg){
+    TPWorkerArg *W = (TPWorkerArg*)arg;
+    TPool *P = W->P;
+    tl_pool = P;
+    tl_id = W->id;
+    free(W);
+    for(;;){
+        pthread_mutex_lock(&P->lock);
+        if(P->stop){
+            pthread_mutex_unlock(&P->lock);
+            break;
+        }
+        unsigned long e = P->epoch;
+        pthread_mutex_unlock(&P->lock);
+
+        TPJob *J;
+        int task;
+        if(tp_find(P, tl_id, NULL, &J, &task)){
+            tp_exec(P, J, task);
+            continue;
+        }
+        pthread_mutex_lock(&P->lock);
+        if(!P->stop && P->epoch == e){
+            double t0 = tp_sleep_begin(P);
+            while(!P->stop && P->epoch == e) pthread_cond_wait(&P->cond, &P->lock);
+            tp_sleep_end(P, t0);
+        }
+        pthread_mutex_unlock(&P->lock);
+    }
+    return NULL;
+}
+
+TPool *tpool_create(int nthreads){
+    if(nthreads < 1){
+        fprintf(stderr,"tpool_create: need at least one thread\n");
+        return NULL;
+    }
+    TPool *P = (TPool*)calloc(1, sizeof(TPool));
+    if(!P){
+        fprintf(stderr,"tpool_create: OOM\n");
+        return NULL;
+    }
+    P->nthreads = nthreads;
+    P->threads = (pthread_t*)calloc((size_t)nthreads, sizeof(pthread_t));
+    P->dq = (TPDeque*)calloc((size_t)nthreads, sizeof(TPDeque));
+    if(!P->threads || !P->dq){
+        fprintf(stderr,"tpool_create: OOM\n");
+        free(P->threads);
+        free(P->dq);
+        free(P);
+        return NULL;
+    }
+    pthread_mutex_init(&P->lock, NULL);
+    pthread_cond_init(&P->cond, NULL);
+    for(int i=0;i<nthreads;i++) pthread_mutex_init(&P->dq[i].lock, NULL);
+    tl_pool = P;
+    tl_id = 0;
+
+    for(int i=1;i<nthreads;i++){
+        TPWorkerArg *W = (TPWorkerArg*)malloc(sizeof(TPWorkerArg));
+        if(W){
+            W->P = P;
+            W->id = i;
+        }
+        if(!W || pthread_create(&P->threads[i], NULL, tp_worker, W) != 0){
+            /* run with the workers started so far */
+            fprintf(stderr,"tpool_create: could only start %d of %d threads\n", i, nthreads);
+            free(W);
+            P->nthreads = i;
+            break;
+        }
+    }
+    return P;
+}
+
+void tpool_free(TPool *P){
+    if(!P) return;
+    pthread_mutex_lock(&P->lock);
+    P->stop = 1;
+    pthread_cond_broadcast(&P->cond);
+    pthread_mutex_unlock(&P->lock);
+    for(int i=1;i<P->nthreads;i++) pthread_join(P->threads[i], NULL);
+    for(int i=0;i<P->nthreads;i++){
+        pthread_mutex_destroy(&P->dq[i].lock);
+        free(P->dq[i].jobs);
+    }
+    pthread_mutex_destroy(&P->lock);
+    pthread_cond_destroy(&P->cond);
+    if(tp_default == P) tp_default = NULL;
+    if(tl_pool == P) tl_pool = NULL;
+    free(P->threads);
+    free(P->dq);
+    free(P);
+}
+
+void tpool_set_default(TPool *P){
+    tp_default = P;
+}
+
+TPool *tpool_default(void){
+    return tp_default;
+}
+
+int tpool_size(const TPool *P){
+    if(!P) P = tp_default;
+    return P ? P->nthreads : 1;
+}
+
+int tpool_thread_id(void){
+    return tl_pool && tl_pool == tp_default ? tl_id : 0;
+}
+
+int tpool_pin(TPool *P, const int *cpus){
+    if(!cpus) return 1;
+    if(!P) P = tp_default;
+    if(!P){
+        /* no pool: the calling thread is the only one */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[0], &set);
+        return sched_setaffinity(0, sizeof(set), &set) != 0;
+    }
+    int rc = 0;
+    for(int i=0;i<P->nthreads;i++){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[i], &set);
+        pthread_t th = i == 0 ? pthread_self() : P->threads[i];
+        if(pthread_setaffinity_np(th, sizeof(set), &set) != 0) rc = 1;
+    }
+    return rc;
+}
+
+double tpool_idle_seconds(TPool *P){
+    if(!P) P = tp_default;
+    if(!P) return 0.0;
+    pthread_mutex_lock(&P->lock);
+    double t = P->idle + P->nsleep * tp_now() - P->sleep_t0;   /* sleeps still in progress count too */
+    pthread_mutex_unlock(&P->lock);
+    return t;
+}
+
+void tpool_run(TPool *P, int ntasks, void (*fn)(void *ctx, int task), void *ctx){
+    if(ntasks <= 0) return;
+    if(!P) P = tp_default;
+    if(!P || P->nthreads == 1 || ntasks == 1){
+        for(int t=0;t<ntasks;t++) fn(ctx, t);
+        return;
+    }
+
+    const int self = tp_self(P);
+    TPJob job = { fn, ctx, ntasks, 0, 0, tl_job };
+    TPDeque *D = &P->dq[self];
+    pthread_mutex_lock(&D->lock);
+    if(D->n == D->cap){
+        int cap = D->cap ? 2 * D->cap : 8;
+        TPJob **nj = (TPJob**)realloc(D->jobs, (size_t)cap * sizeof(TPJob*));
+        if(!nj){
+            pthread_mutex_unlock(&D->lock);
+            fprintf(stderr,"tpool_run: OOM, running serially\n");
+            for(int t=0;t<ntasks;t++) fn(ctx, t);
+            return;
+        }
+        D->jobs = nj;
+        D->cap = cap;
+    }
+    D->jobs[D->n++] = &job;
+    pthread_mutex_unlock(&D->lock);
+    tp_signal(P);
+
+    /* help until the job is done: only this job or jobs nested below it */
+    for(;;){
+        pthread_mutex_lock(&P->lock);
+        if(job.done == ntasks){
+            pthread_mutex_unlock(&P->lock);
+            break;
+        }
+        unsigned long e = P->epoch;
+        pthread_mutex_unlock(&P->lock);
+
+        TPJob *J;
+        int task;
+        if(tp_find(P, self, &job, &J, &task)){
+            tp_exec(P, J, task);
+            continue;
+        }
+        pthread_mutex_lock(&P->lock);
+        if(job.done < ntasks && P->epoch == e){
+            double t0 = tp_sleep_begin(P);
+            while(job.done < ntasks && P->epoch == e) pthread_cond_wait(&P->cond, &P->lock);
+            tp_sleep_end(P, t0);
+        }
+        pthread_mutex_unlock(&P->lock);
+    }
+}
+
+/* ----------------------- parallel for / reduce ----------------------- */
+
+typedef struct {
+    long   n, grain;
+    void (*body)(void *ctx, long lo, long hi);
+    void (*rbody)(void *ctx, long lo, long hi, void *acc);
+    void  *ctx;
+    char  *accs;
+    size_t acc_size;
+} TPRange;
+
+static void tp_range_task(void *arg, int task){
+    TPRange *R = (TPRange*)arg;
+    long lo = (long)task * R->grain;
+    long hi = lo + R->grain < R->n ? lo + R->grain : R->n;
+    if(R->body) R->body(R->ctx, lo, hi);
+    else R->rbody(R->ctx, lo, hi, R->accs + (size_t)task * R->acc_size);
+}
+
+static long tp_grain(TPool *P, long n, long grain){
+    if(grain > 0) return grain;
+    long chunks = 4L * tpool_size(P);
+    grain = (n + chunks - 1) / chunks;
+    return grain > 0 ? grain : 1;
+}
+
+void tpool_parallel_for(TPool *P, long n, long grain,
+                        void (*body)(void *ctx, long lo, long hi), void *ctx)
+{
+    if(n <= 0) return;
+    grain = tp_grain(P, n, grain);
+    TPRange R = { n, grain, body, NULL, ctx, NULL, 0 };
+    tpool_run(P, (int)((n + grain - 1) / grain), tp_range_task, &R);
+}
+
+int tpool_parallel_reduce(TPool *P, long n, long grain, size_t acc_size,
+                          void (*body)(void *ctx, long lo, long hi, void *acc),
+                          void (*combine)(void *ctx, void *result, const void *acc),
+                          void *ctx, void *result)
+{
+    if(n <= 0) return 0;
+    grain = tp_grain(P, n, grain);
+    const int nchunks = (int)((n + grain - 1) / grain);
+    char *accs = (char*)calloc((size_t)nchunks, acc_size);
+    if(!accs){
+        fprintf(stderr,"tpool_parallel_reduce: OOM\n");
+        return 1;
+    }
+    TPRange R = { n, grain, NULL, body, ctx, accs, acc_size };
+    tpool_run(P, nchunks, tp_range_task, &R);
+    for(int c=0;c<nchunks;c++) combine(ctx, result, accs + (size_t)c * acc_size);
+    free(accs);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef TPOOL_H
+#define TPOOL_H
+
+#include <stddef.h>
+
+/*
+ * TPool
+ *
+ * Process-wide work-stealing task pool. main creates one pool (sized by
+ * --threads) and installs it with tpool_set_default; modules submit work with
+ * P == NULL, meaning "the default pool", and fall back to running it serially
+ * on the calling thread when there is none.
+ *
+ *   - every worker owns a deque of jobs; a job is a batch of independent tasks
+ *     0..ntasks-1, claimed one at a time by any thread that holds it;
+ *   - the submitting thread pushes the job on its own deque and works on it;
+ *     idle workers steal the oldest job of another worker's deque;
+ *   - a thread waiting for its job keeps executing tasks of that job or of
+ *     jobs submitted from its tasks, recursively (never an outer task, nor
+ *     work of a sibling such as another frame's chunks), so nested
+ *     parallelism (frames x intra-frame chunks) runs on the same fixed set of
+ *     threads without oversubscription or unbounded leapfrogging, and work a
+ *     waiting frame does is that frame's own.
+ *
+ * Task order is not deterministic; results are, as long as tasks write
+ * disjoint outputs (tpool_parallel_reduce combines partials in chunk order).
+ */
+typedef struct TPool TPool;
+
+/* Pool of nthreads threads: the caller plus nthreads-1 workers. NULL on error. */
+TPool *tpool_create(int nthreads);
+
+/* Stop the workers and free the pool (no job may be running) */
+void tpool_free(TPool *P);
+
+/* Default pool used when NULL is passed (NULL: no default, run serially) */
+void tpool_set_default(TPool *P);
+TPool *tpool_default(void);
+
+/* Threads of P (or of the default pool); 1 if there is none */
+int tpool_size(const TPool *P);
+
+/* Index (0..size-1) of the calling thread in the default pool; 0 for threads
+ * outside it (the creating thread is 0 too).
+ */
+int tpool_thread_id(void);
+
+/* Pin thread i of P (0 = the creating thread) to CPU cpus[i]; without P and
+ * without a default pool, pin the calling thread to cpus[0]. Returns 0 if
+ * every thread could be pinned.
+ */
+int tpool_pin(TPool *P, const int *cpus);
+
+/* Thread-seconds the pool's threads have spent asleep for lack of work so far
+ * (idle workers plus callers waiting on a job); 0 without a pool. Take the
+ * difference around a tpool_run to get the idle time of that job.
+ */
+double tpool_idle_seconds(TPool *P);
+
+/*
+ * tpool_run
+ *
+ * Runs fn(ctx, task) for task = 0..ntasks-1 and returns when all are done.
+ * May be called from inside a task (nested).
+ */
+void tpool_run(TPool *P, int ntasks, void (*fn)(void *ctx, int task), void *ctx);
+
+/*
+ * tpool_parallel_for
+ *
+ * Calls body(ctx, lo, hi) over [0, n) in chunks of `grain` indices
+ * (grain <= 0: about 4 chunks per thread).
+ */
+void tpool_parallel_for(TPool *P, long n, long grain,
+                        void (*body)(void *ctx, long lo, long hi), void *ctx);
+
+/*
+ * tpool_parallel_reduce
+ *
+ * Like tpool_parallel_for, but every chunk gets its own zeroed accumulator of
+ * acc_size bytes; afterwards combine(ctx, result, acc) is called for the
+ * chunks in index order on the calling thread. With a fixed grain the result
+ * does not depend on the number of threads.
+ * Returns 0 on success, non-zero on error (OOM).
+ */
+int tpool_parallel_reduce(TPool *P, long n, long grain, size_t acc_size,
+                          void (*body)(void *ctx, long lo, long hi, void *acc),
+                          void (*combine)(void *ctx, void *result, const void *acc),
+                          void *ctx, void *result);
+
+#endif /* TPOOL_H */
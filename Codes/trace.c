@@ -0,0 +1,160 @@
+/*
+ * trace.c
+ *
+ * Per-thread ring buffers of complete ("X") events, dumped as Chrome trace
+ * JSON (see trace.h).
+ */
+
+#define _GNU_SOURCE   /* clock_gettime */
+
+#include "trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define TRACE_DEFAULT_EVENTS 65536
+
+typedef struct {
+    const char *name;
+    long   frame;
+    double t0, t1;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent *ev;
+    size_t      cap;
+    size_t      n;        /* events recorded so far (ring index n % cap) */
+    int         tid;      /* registration order, shown as the thread id */
+    char        name[32];
+} TraceBuf;
+
+static int    tr_on = 0;
+static char  *tr_path = NULL;
+static size_t tr_cap = TRACE_DEFAULT_EVENTS;
+static double tr_t0 = 0.0;
+static pthread_mutex_t tr_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuf **tr_bufs = NULL;   /* registered buffers (tr_lock) */
+static int    tr_nbufs = 0;
+
+static __thread TraceBuf *tl_buf = NULL;
+
+double trace_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+int trace_open(const char *path, size_t events_per_thread){
+    if(!path || !*path){
+        fprintf(stderr,"trace_open: empty path\n");
+        return 1;
+    }
+    tr_path = strdup(path);
+    if(!tr_path){
+        fprintf(stderr,"trace_open: OOM\n");
+        return 1;
+    }
+    if(events_per_thread > 0) tr_cap = events_per_thread;
+    tr_t0 = trace_now();
+    tr_on = 1;
+    return 0;
+}
+
+int trace_enabled(void){
+    return tr_on;
+}
+
+/* The calling thread's buffer, registered on first use (NULL on OOM) */
+static TraceBuf *trace_buf(void){
+    if(tl_buf) return tl_buf;
+    TraceBuf *B = (TraceBuf*)calloc(1, sizeof(TraceBuf));
+    if(B) B->ev = (TraceEvent*)malloc(tr_cap * sizeof(TraceEvent));
+    if(!B || !B->ev){
+        free(B);
+        return NULL;
+    }
+    B->cap = tr_cap;
+    pthread_mutex_lock(&tr_lock);
+    TraceBuf **nb = (TraceBuf**)realloc(tr_bufs, (size_t)(tr_nbufs + 1) * sizeof(TraceBuf*));
+    if(nb){
+        tr_bufs = nb;
+        B->tid = tr_nbufs;
+        tr_bufs[tr_nbufs++] = B;
+    }
+    pthread_mutex_unlock(&tr_lock);
+    if(!nb){
+        free(B->ev);
+        free(B);
+        return NULL;
+    }
+    snprintf(B->name, sizeof(B->name), "thread %d", B->tid);
+    tl_buf = B;
+    return B;
+}
+
+void trace_event(const char *name, long frame, double t0, double t1){
+    if(!tr_on) return;
+    TraceBuf *B = trace_buf();
+    if(!B) return;
+    TraceEvent *e = &B->ev[B->n % B->cap];
+    e->name = name;
+    e->frame = frame;
+    e->t0 = t0;
+    e->t1 = t1;
+    B->n++;
+}
+
+void trace_thread_name(const char *name){
+    if(!tr_on) return;
+    TraceBuf *B = trace_buf();
+    if(B) snprintf(B->name, sizeof(B->name), "%s", name);
+}
+
+int trace_close(void){
+    if(!tr_on) return 0;
+    tr_on = 0;
+    int rc = 0;
+    FILE *f = fopen(tr_path, "w");
+    if(!f){
+        fprintf(stderr,"trace_close: cannot open %s\n", tr_path);
+        rc = 1;
+    } else {
+        long dropped = 0;
+        int first = 1;
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for(int b=0;b<tr_nbufs;b++){
+            const TraceBuf *B = tr_bufs[b];
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", B->tid, B->name);
+            first = 0;
+            size_t k0 = B->n > B->cap ? B->n - B->cap : 0;
+            dropped += (long)k0;
+            for(size_t k=k0;k<B->n;k++){
+                const TraceEvent *e = &B->ev[k % B->cap];
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                        e->name, B->tid, 1e6 * (e->t0 - tr_t0), 1e6 * (e->t1 - e->t0));
+                if(e->frame >= 0) fprintf(f, ",\"args\":{\"frame\":%ld}", e->frame);
+                fprintf(f, "}");
+            }
+        }
+        fprintf(f, "\n]}\n");
+        if(fclose(f) != 0){
+            fprintf(stderr,"trace_close: write error on %s\n", tr_path);
+            rc = 1;
+        }
+        if(dropped > 0) fprintf(stderr,"trace: %ld oldest events dropped (ring buffers full)\n", dropped);
+    }
+    for(int b=0;b<tr_nbufs;b++){
+        free(tr_bufs[b]->ev);
+        free(tr_bufs[b]);
+    }
+    free(tr_bufs);
+    tr_bufs = NULL;
+    tr_nbufs = 0;
+    tl_buf = NULL;
+    free(tr_path);
+    tr_path = NULL;
+    return rc;
+}
@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+
+/*
+ * trace
+ *
+ * Optional timeline of the run (--trace=FILE) in Chrome trace JSON, viewable
+ * in chrome://tracing or ui.perfetto.dev. Every thread records complete
+ * events (name, frame, begin, end) into its own ring buffer: no locks or
+ * atomics on the recording path, a mutex only when a thread registers its
+ * buffer on first use. When a buffer is full the oldest events are dropped.
+ * trace_close writes all buffers once the threads are done.
+ */
+
+/* Start tracing to `path` with room for `events_per_thread` events per thread
+   (0: default). Returns 0 on success. */
+int trace_open(const char *path, size_t events_per_thread);
+
+/* 1 if tracing is on */
+int trace_enabled(void);
+
+/* Monotonic clock in seconds (same clock as the event times) */
+double trace_now(void);
+
+/* Record [t0, t1] (trace_now seconds) as event `name` (a string literal or
+   other storage that outlives the trace); frame < 0 means no frame. */
+void trace_event(const char *name, long frame, double t0, double t1);
+
+/* Name the calling thread in the viewer (copied, up to 31 characters) */
+void trace_thread_name(const char *name);
+
+/* Write the JSON file and stop tracing. No thread may record concurrently.
+   Returns 0 on success (also when tracing was off). */
+int trace_close(void);
+
+#endif /* TRACE_H */
@@ -355,6 +355,7 @@
 #endif /* LINUX */
 #ifdef TRILIBRARY
 #include "triangle.h"
+#include <pthread.h>
 #endif /* TRILIBRARY */
 
 /* A few forward declarations.                                               */
@@ -648,9 +649,9 @@ REAL ccwerrboundA, ccwerrboundB, ccwerrboundC;
 REAL iccerrboundA, iccerrboundB, iccerrboundC;
 REAL o3derrboundA, o3derrboundB, o3derrboundC;
 
-/* Random number seed is not constant, but I've made it global anyway.       */
-
-unsigned long randomseed;                     /* Current random number seed. */
+/* The constants above are computed once (see exactinit()) and are read-only */
+/*   afterwards.  The random number seed lives in the mesh structure, so      */
+/*   concurrent calls to triangulate() share no mutable state.                */
 
 
 /* Mesh data structure.  Triangle operates on only one mesh, but the mesh    */
@@ -709,6 +710,7 @@ struct mesh {
   int readnodefile;                           /* Has a .node file been read? */
   long samples;              /* Number of random samples for point location. */
 
+  unsigned long randomseed;                   /* Current random number seed. */
   long incirclecount;                 /* Number of incircle tests performed. */
   long counterclockcount;     /* Number of counterclockwise tests performed. */
   long orient3dcount;           /* Number of 3D orientation tests performed. */
@@ -4881,34 +4883,19 @@ struct osub *newsubseg;
 /*                                                                           */
 /*  Don't change this routine unless you fully understand it.                */
 /*                                                                           */
+/*  The constants are the same on every call, so they are computed only     */
+/*  once per process (exactconstants()); in the library build this is done   */
+/*  under pthread_once() so that concurrent calls to triangulate() never     */
+/*  write them.  The FPU control word is per-thread state and is still set   */
+/*  on every call.                                                           */
+/*                                                                           */
 /*****************************************************************************/
 
-void exactinit()
+void exactconstants()
 {
   REAL half;
   REAL check, lastcheck;
   int every_other;
-#ifdef LINUX
-  int cword;
-#endif /* LINUX */
-
-#ifdef CPU86
-#ifdef SINGLE
-  _control87(_PC_24, _MCW_PC); /* Set FPU control word for single precision. */
-#else /* not SINGLE */
-  _control87(_PC_53, _MCW_PC); /* Set FPU control word for double precision. */
-#endif /* not SINGLE */
-#endif /* CPU86 */
-#ifdef LINUX
-#ifdef SINGLE
-  /*  cword = 4223; */
-  cword = 4210;                 /* set FPU control word for single precision */
-#else /* not SINGLE */
-  /*  cword = 4735; */
-  cword = 4722;                 /* set FPU control word for double precision */
-#endif /* not SINGLE */
-  _FPU_SETCW(cword);
-#endif /* LINUX */
 
   every_other = 1;
   half = 0.5;
@@ -4942,6 +4929,41 @@ void exactinit()
   o3derrboundC = (26.0 + 288.0 * epsilon) * epsilon * epsilon;
 }
 
+#ifdef TRILIBRARY
+static pthread_once_t exactconstants_once = PTHREAD_ONCE_INIT;
+#endif /* TRILIBRARY */
+
+void exactinit()
+{
+#ifdef LINUX
+  int cword;
+#endif /* LINUX */
+
+#ifdef CPU86
+#ifdef SINGLE
+  _control87(_PC_24, _MCW_PC); /* Set FPU control word for single precision. */
+#else /* not SINGLE */
+  _control87(_PC_53, _MCW_PC); /* Set FPU control word for double precision. */
+#endif /* not SINGLE */
+#endif /* CPU86 */
+#ifdef LINUX
+#ifdef SINGLE
+  /*  cword = 4223; */
+  cword = 4210;                 /* set FPU control word for single precision */
+#else /* not SINGLE */
+  /*  cword = 4735; */
+  cword = 4722;                 /* set FPU control word for double precision */
+#endif /* not SINGLE */
+  _FPU_SETCW(cword);
+#endif /* LINUX */
+
+#ifdef TRILIBRARY
+  pthread_once(&exactconstants_once, exactconstants);
+#else /* not TRILIBRARY */
+  exactconstants();
+#endif /* not TRILIBRARY */
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  fast_expansion_sum_zeroelim()   Sum two expansions, eliminating zero     */
@@ -6651,7 +6673,7 @@ struct mesh *m;
   m->checkquality = 0;     /* The quality triangulation stage has not begun. */
   m->incirclecount = m->counterclockcount = m->orient3dcount = 0;
   m->hyperbolacount = m->circletopcount = m->circumcentercount = 0;
-  randomseed = 1;
+  m->randomseed = 1;
 
   exactinit();                     /* Initialize exact arithmetic constants. */
 }
@@ -6667,15 +6689,16 @@ struct mesh *m;
 /*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-unsigned long randomnation(unsigned int choices)
+unsigned long randomnation(unsigned long *seed, unsigned int choices)
 #else /* not ANSI_DECLARATORS */
-unsigned long randomnation(choices)
+unsigned long randomnation(seed, choices)
+unsigned long *seed;
 unsigned int choices;
 #endif /* not ANSI_DECLARATORS */
 
 {
-  randomseed = (randomseed * 1366l + 150889l) % 714025l;
-  return randomseed / (714025l / choices + 1);
+  *seed = (*seed * 1366l + 150889l) % 714025l;
+  return *seed / (714025l / choices + 1);
 }
 
 /********* Mesh quality testing routines begin here                  *********/
@@ -7730,7 +7753,7 @@ struct otri *searchtri;
     /* Choose `samplesleft' randomly sampled triangles in this block. */
     do {
       sampletri.tri = (triangle *) (firsttri +
-                                    (randomnation((unsigned int) population) *
+                                    (randomnation(&m->randomseed, (unsigned int) population) *
                                      m->triangles.itembytes));
       if (!deadtri(sampletri.tri)) {
         org(sampletri, torg);
@@ -9199,9 +9222,10 @@ struct behavior *b;
 /*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-void vertexsort(vertex *sortarray, int arraysize)
+void vertexsort(unsigned long *seed, vertex *sortarray, int arraysize)
 #else /* not ANSI_DECLARATORS */
-void vertexsort(sortarray, arraysize)
+void vertexsort(seed, sortarray, arraysize)
+unsigned long *seed;
 vertex *sortarray;
 int arraysize;
 #endif /* not ANSI_DECLARATORS */
@@ -9224,7 +9248,7 @@ int arraysize;
     return;
   }
   /* Choose a random pivot to split the array. */
-  pivot = (int) randomnation((unsigned int) arraysize);
+  pivot = (int) randomnation(seed, (unsigned int) arraysize);
   pivotx = sortarray[pivot][0];
   pivoty = sortarray[pivot][1];
   /* Split the array. */
@@ -9252,11 +9276,11 @@ int arraysize;
   }
   if (left > 1) {
     /* Recursively sort the left subset. */
-    vertexsort(sortarray, left);
+    vertexsort(seed, sortarray, left);
   }
   if (right < arraysize - 2) {
     /* Recursively sort the right subset. */
-    vertexsort(&sortarray[right + 1], arraysize - right - 1);
+    vertexsort(seed, &sortarray[right + 1], arraysize - right - 1);
   }
 }
 
@@ -9273,9 +9297,11 @@ int arraysize;
 /*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-void vertexmedian(vertex *sortarray, int arraysize, int median, int axis)
+void vertexmedian(unsigned long *seed, vertex *sortarray, int arraysize,
+                  int median, int axis)
 #else /* not ANSI_DECLARATORS */
-void vertexmedian(sortarray, arraysize, median, axis)
+void vertexmedian(seed, sortarray, arraysize, median, axis)
+unsigned long *seed;
 vertex *sortarray;
 int arraysize;
 int median;
@@ -9300,7 +9326,7 @@ int axis;
     return;
   }
   /* Choose a random pivot to split the array. */
-  pivot = (int) randomnation((unsigned int) arraysize);
+  pivot = (int) randomnation(seed, (unsigned int) arraysize);
   pivot1 = sortarray[pivot][axis];
   pivot2 = sortarray[pivot][1 - axis];
   /* Split the array. */
@@ -9330,11 +9356,11 @@ int axis;
   /*   conditionals is true.                             */
   if (left > median) {
     /* Recursively shuffle the left subset. */
-    vertexmedian(sortarray, left, median, axis);
+    vertexmedian(seed, sortarray, left, median, axis);
   }
   if (right < median - 1) {
     /* Recursively shuffle the right subset. */
-    vertexmedian(&sortarray[right + 1], arraysize - right - 1,
+    vertexmedian(seed, &sortarray[right + 1], arraysize - right - 1,
                  median - right - 1, axis);
   }
 }
@@ -9351,9 +9377,11 @@ int axis;
 /*****************************************************************************/
 
 #ifdef ANSI_DECLARATORS
-void alternateaxes(vertex *sortarray, int arraysize, int axis)
+void alternateaxes(unsigned long *seed, vertex *sortarray, int arraysize,
+                   int axis)
 #else /* not ANSI_DECLARATORS */
-void alternateaxes(sortarray, arraysize, axis)
+void alternateaxes(seed, sortarray, arraysize, axis)
+unsigned long *seed;
 vertex *sortarray;
 int arraysize;
 int axis;
@@ -9369,13 +9397,13 @@ int axis;
     axis = 0;
   }
   /* Partition with a horizontal or vertical cut. */
-  vertexmedian(sortarray, arraysize, divider, axis);
+  vertexmedian(seed, sortarray, arraysize, divider, axis);
   /* Recursively partition the subsets with a cross cut. */
   if (arraysize - divider >= 2) {
     if (divider >= 2) {
-      alternateaxes(sortarray, divider, 1 - axis);
+      alternateaxes(seed, sortarray, divider, 1 - axis);
     }
-    alternateaxes(&sortarray[divider], arraysize - divider, 1 - axis);
+    alternateaxes(seed, &sortarray[divider], arraysize - divider, 1 - axis);
   }
 }
 
@@ -9993,7 +10021,7 @@ struct behavior *b;
     sortarray[i] = vertextraverse(m);
   }
   /* Sort the vertices. */
-  vertexsort(sortarray, m->invertices);
+  vertexsort(&m->randomseed, sortarray, m->invertices);
   /* Discard duplicate vertices, which can really mess up the algorithm. */
   i = 0;
   for (j = 1; j < m->invertices; j++) {
@@ -10017,9 +10045,9 @@ struct behavior *b;
     divider = i >> 1;
     if (i - divider >= 2) {
       if (divider >= 2) {
-        alternateaxes(sortarray, divider, 1);
+        alternateaxes(&m->randomseed, sortarray, divider, 1);
       }
-      alternateaxes(&sortarray[divider], i - divider, 1);
+      alternateaxes(&m->randomseed, &sortarray[divider], i - divider, 1);
     }
   }
 
@@ -10889,7 +10917,7 @@ struct behavior *b;
       lnext(fliptri, righttri);
       sym(lefttri, farlefttri);
 
-      if (randomnation(SAMPLERATE) == 0) {
+      if (randomnation(&m->randomseed, SAMPLERATE) == 0) {
         symself(fliptri);
         dest(fliptri, leftvertex);
         apex(fliptri, midvertex);
@@ -10946,9 +10974,9 @@ struct behavior *b;
           otricopy(lefttri, bottommost);
         }
 
-        if (randomnation(SAMPLERATE) == 0) {
+        if (randomnation(&m->randomseed, SAMPLERATE) == 0) {
           splayroot = splayinsert(m, splayroot, &lefttri, nextvertex);
-        } else if (randomnation(SAMPLERATE) == 0) {
+        } else if (randomnation(&m->randomseed, SAMPLERATE) == 0) {
           lnext(righttri, inserttri);
           splayroot = splayinsert(m, splayroot, &inserttri, nextvertex);
         }
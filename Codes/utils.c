@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "memacct.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
@@ -19,7 +20,7 @@ int v2a_push(Vec2Array *v, Vec2 p){
             /* overflow detected */
             return -1;
         }
-        Vec2 *tmp = (Vec2*)realloc(v->data, newcap * sizeof(Vec2));
+        Vec2 *tmp = (Vec2*)mem_realloc(v->data, newcap * sizeof(Vec2));
         if(!tmp){
             return -1; /* OOM */
         }
@@ -31,7 +32,7 @@ int v2a_push(Vec2Array *v, Vec2 p){
 }
 
 void v2a_free(Vec2Array *v){
-    free(v->data);
+    mem_free(v->data);
     v->data = NULL;
     v->n = v->cap = 0;
 }
@@ -50,7 +51,7 @@ int ia_push(IntArray *v, int x){
         if(newcap <= v->cap || newcap > (SIZE_MAX / sizeof(int))){
             return -1;
         }
-        int *tmp = (int*)realloc(v->data, newcap * sizeof(int));
+        int *tmp = (int*)mem_realloc(v->data, newcap * sizeof(int));
         if(!tmp) return -1;
         v->data = tmp;
         v->cap = newcap;
@@ -60,7 +61,7 @@ int ia_push(IntArray *v, int x){
 }
 
 void ia_free(IntArray *v){
-    free(v->data);
+    mem_free(v->data);
     v->data = NULL;
     v->n = v->cap = 0;
 }
@@ -78,3 +79,57 @@ double wrap_pos(double x, double L){
     if(y < 0) y += L;
     return y;
 }
+
+/* Hilbert ordering */
+typedef struct { uint64_t key; int idx; } HKey;
+
+static uint64_t hilbert_index(uint32_t x, uint32_t y){
+    const uint32_t n = 1u << 16;
+    uint64_t d = 0;
+    for(uint32_t s = n >> 1; s > 0; s >>= 1){
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3u * rx) ^ ry);
+        if(ry == 0){
+            if(rx == 1){ x = n - 1 - x; y = n - 1 - y; }
+            uint32_t tmp = x; x = y; y = tmp;
+        }
+    }
+    return d;
+}
+
+static int cmp_hkey(const void *a, const void *b){
+    const HKey *ka = (const HKey*)a, *kb = (const HKey*)b;
+    if(ka->key < kb->key) return -1;
+    if(ka->key > kb->key) return 1;
+    return (ka->idx > kb->idx) - (ka->idx < kb->idx);
+}
+
+int *hilbert_order(const double *xy, int n){
+    if(!xy || n <= 0) return NULL;
+    HKey *keys = (HKey*)mem_malloc((size_t)n * sizeof(HKey));
+    int *ord = (int*)mem_malloc((size_t)n * sizeof(int));
+    if(!keys || !ord){ mem_free(keys); mem_free(ord); return NULL; }
+
+    double xmin = xy[0], xmax = xy[0], ymin = xy[1], ymax = xy[1];
+    for(int i = 1; i < n; i++){
+        double x = xy[2*i], y = xy[2*i + 1];
+        if(x < xmin) xmin = x;
+        if(x > xmax) xmax = x;
+        if(y < ymin) ymin = y;
+        if(y > ymax) ymax = y;
+    }
+    double span = xmax - xmin;
+    if(ymax - ymin > span) span = ymax - ymin;
+    double scale = span > 0.0 ? 65535.0 / span : 0.0;
+    for(int i = 0; i < n; i++){
+        uint32_t hx = (uint32_t)((xy[2*i]     - xmin) * scale);
+        uint32_t hy = (uint32_t)((xy[2*i + 1] - ymin) * scale);
+        keys[i].key = hilbert_index(hx, hy);
+        keys[i].idx = i;
+    }
+    qsort(keys, (size_t)n, sizeof(HKey), cmp_hkey);
+    for(int i = 0; i < n; i++) ord[i] = keys[i].idx;
+    mem_free(keys);
+    return ord;
+}
@@ -30,6 +30,14 @@ void ia_free(IntArray *v);
 double mic_delta(double d, double L);
 double wrap_pos(double x, double L);
 
+/* --------- Spatial ordering -------------- */
+/* Permutation of the n points (interleaved x0 y0 x1 y1 ...) along a Hilbert
+ * curve over their bounding box: consecutive indices are close in space.
+ * Used as dt2d's insertion order and for the g6 kernel's SoA packing.
+ * Returns a mem_malloc'd int array of length n (caller mem_free()s), or NULL
+ * on error. */
+int *hilbert_order(const double *xy, int n);
+
 /* --------- Misc helpers ------------------ */
 static inline double sq(double x){ return x*x; }
 